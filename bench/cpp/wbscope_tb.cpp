@@ -39,14 +39,22 @@
 
 #include <verilated.h>
 #include <verilated_vcd_c.h>
+#ifdef	OPT_SEEK
+#include "Vwbscope_seek_tb.h"
+typedef	Vwbscope_seek_tb	VWBSCOPE_TB;
+#define	VCD_FILE	"wbscope_seek_tb.vcd"
+#else
 #include "Vwbscope_tb.h"
+typedef	Vwbscope_tb	VWBSCOPE_TB;
+#define	VCD_FILE	"wbscope_tb.vcd"
+#endif
 #include "testb.h"
 #define	INTERRUPTWIRE	o_interrupt
 #include "wb_tb.h"
 
 const int	LGMEMSIZE = 15;
 
-class	WBSCOPE_TB : public WB_TB<Vwbscope_tb> {
+class	WBSCOPE_TB : public WB_TB<VWBSCOPE_TB> {
 	bool		m_bomb, m_debug;
 public:
 	// {{{
@@ -57,7 +65,7 @@ public:
 	void	tick(void) {
 		// {{{
 
-		WB_TB<Vwbscope_tb>::tick();
+		WB_TB<VWBSCOPE_TB>::tick();
 
 		bool	writeout = true;
 		if ((m_debug)&&(writeout)) {}
@@ -95,8 +103,9 @@ int main(int  argc, char **argv) {
 	unsigned *buf;
 	int	trigpt;
 	unsigned	trigger_time, expected_first_value;
+	unsigned	seek_addr, seekbuf[8];
 
-	tb->opentrace("wbscope_tb.vcd");
+	tb->opentrace(VCD_FILE);
 	printf("Giving the core 2 cycles to start up\n");
 	// Before testing, let's give the unit time enough to warm up
 	tb->reset();
@@ -111,6 +120,9 @@ int main(int  argc, char **argv) {
 #define	WBSCOPE_TRIGGERED 0x20000000
 #define	WBSCOPE_STOPPED 0x40000000
 #define	WBSCOPE_DISABLED  0x04000000
+#define	WBSCOPE_ZERO	0x02000000
+#define	WBSCOPE_QUERY	0x80000000
+#define	WBSCOPE_CAN_SEEK	0x00000001
 #define	WBSCOPE_LGLEN(A)	((A>>20)&0x01f)
 #define	WBSCOPE_LENGTH(A)	(1<<(LGLEN(A)))
 
@@ -180,6 +192,90 @@ int main(int  argc, char **argv) {
 		goto test_failure;
 	}
 
+	// Seek check
+	// {{{
+	// Ask the scope what it can do, by writing bit 31 to the data
+	// register.  A scope with OPT_SEEK answers the next control register
+	// read with its capabilities, whose LGMEM field is zero.  Any other
+	// scope answers with its control word, as usual.
+	tb->writeio(WBSCOPE_DATA, WBSCOPE_QUERY);
+	v = tb->readio(WBSCOPE_STATUS);
+#ifdef	OPT_SEEK
+	if (v != WBSCOPE_CAN_SEEK) {
+		printf("ERR: CAPABILITIES ARE %08x, NOT %08x\n", v,
+			WBSCOPE_CAN_SEEK);
+		goto test_failure;
+	}
+
+	// The query is only answered once, and leaves the read address alone
+	v = tb->readio(WBSCOPE_STATUS);
+	if ((WBSCOPE_LGLEN(v) != (unsigned)ln)||(!(v & WBSCOPE_ZERO))) {
+		printf("ERR: CONTROL WORD %08x AFTER THE QUERY\n", v);
+		goto test_failure;
+	}
+
+	// Writing to the data register should set the read address, and so
+	// clear the ZERO bit of the control register.  Reads should then
+	// pick up from that address.
+	tb->writeio(WBSCOPE_DATA, 1);
+	v = tb->readio(WBSCOPE_STATUS);
+	if (v & WBSCOPE_ZERO) {
+		printf("ERR: SEEK DIDN\'T MOVE THE READ ADDRESS\n");
+		goto test_failure;
+	}
+
+	seek_addr = (1<<ln) / 2 - 3;
+	tb->writeio(WBSCOPE_DATA, seek_addr);
+	tb->readz(WBSCOPE_DATA, 8, seekbuf);
+	for(int i=0; i<8; i++) {
+		if (seekbuf[i] != buf[seek_addr+i]) {
+			printf("ERR: SEEK READ %08x FROM %5d, NOT %08x\n",
+				seekbuf[i], seek_addr+i, buf[seek_addr+i]);
+			goto test_failure;
+		}
+	}
+
+	tb->writeio(WBSCOPE_DATA, 0);
+	v = tb->readio(WBSCOPE_STATUS);
+	if (!(v & WBSCOPE_ZERO)) {
+		printf("ERR: SEEK TO ZERO FAILED\n");
+		goto test_failure;
+	}
+#else
+	if (WBSCOPE_LGLEN(v) != (unsigned)ln) {
+		printf("ERR: SCOPE W/O OPT_SEEK ANSWERED THE QUERY WITH %08x\n",
+			v);
+		goto test_failure;
+	}
+
+	// Without OPT_SEEK, writing to the data register returns the read
+	// address to the beginning of the buffer, wherever it was
+	seek_addr = (1<<ln) / 2 - 3;
+	tb->readz(WBSCOPE_DATA, 8, seekbuf);
+	v = tb->readio(WBSCOPE_STATUS);
+	if (v & WBSCOPE_ZERO) {
+		printf("ERR: READS DIDN\'T MOVE THE READ ADDRESS\n");
+		goto test_failure;
+	}
+
+	tb->writeio(WBSCOPE_DATA, seek_addr);
+	v = tb->readio(WBSCOPE_STATUS);
+	if (!(v & WBSCOPE_ZERO)) {
+		printf("ERR: WRITE DIDN\'T RESET THE READ ADDRESS\n");
+		goto test_failure;
+	}
+
+	tb->readz(WBSCOPE_DATA, 8, seekbuf);
+	for(int i=0; i<8; i++) {
+		if (seekbuf[i] != buf[i]) {
+			printf("ERR: READ %08x FROM %5d AFTER RESET, NOT %08x\n",
+				seekbuf[i], i, buf[i]);
+			goto test_failure;
+		}
+	}
+#endif
+	// }}}
+
 	printf("SUCCESS!!\n");
 	delete tb;
 	exit(0);
@@ -41,7 +41,12 @@
 //
 `default_nettype none
 // }}}
-module	wbscopc_tb (
+module	wbscopc_tb #(
+		// {{{
+		// The test bench is built both with and without OPT_SEEK
+		parameter [0:0]	OPT_SEEK = 1'b0
+		// }}}
+	) (
 		// {{{
 		input	wire		i_clk,
 		// i_reset is required by test infrastructure, yet unused here
@@ -94,7 +99,7 @@ module	wbscopc_tb (
 	assign	o_counter = counter;
 
 	wbscopc	#(.LGMEM(5'd14), .BUSW(32), .SYNCHRONOUS(1), .MAX_STEP(768),
-			.DEFAULT_HOLDOFF(36))
+			.DEFAULT_HOLDOFF(36), .OPT_SEEK(OPT_SEEK))
 		scope(i_clk, 1'b1, i_trigger, o_data,
 			i_clk, i_wb_cyc, i_wb_stb, i_wb_we,
 					i_wb_addr, i_wb_data, i_wb_sel,
@@ -42,7 +42,12 @@
 //
 `default_nettype	none
 // }}}
-module	wbscope_tb (
+module	wbscope_tb #(
+		// {{{
+		// The test bench is built both with and without OPT_SEEK
+		parameter [0:0]	OPT_SEEK = 1'b0
+		// }}}
+	) (
 		// {{{
 		input	wire		i_clk,
 		// i_reset is required by test infrastructure, yet unused here
@@ -83,7 +88,7 @@ module	wbscope_tb (
 	assign	o_data = { i_trigger, counter };
 
 	wbscope	#(.LGMEM(5'd6), .BUSW(32), .SYNCHRONOUS(1),
-			.DEFAULT_HOLDOFF(1))
+			.DEFAULT_HOLDOFF(1), .OPT_SEEK(OPT_SEEK))
 		scope(i_clk, 1'b1, i_trigger, o_data,
 			i_clk, i_wb_cyc, i_wb_stb, i_wb_we,
 					i_wb_addr, i_wb_data, i_wb_sel,
@@ -0,0 +1,165 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	cfgscope_tb.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Checks that the CFGSCOPE example's decode_batch() writes exactly
+//		what its decode() would've printed, for every kind of word.  Both
+//	are run on the same words--the decode() path through the default
+//	SCOPE::decode_batch()--with their output captured and compared.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "simbus.h"
+#include "outbuf.h"
+
+// cfgscope.cpp is an example program, written for a bus we don't have here.
+// Give it stand-ins for that bus, and rename its main(), so that its CFGSCOPE
+// may be tested.
+class	NETCOMMS {
+public:
+	NETCOMMS(const char *, int) {}
+};
+
+class	FPGA : public SIMBUS {
+public:
+	FPGA(NETCOMMS *comms) : SIMBUS(10, 0) { delete comms; }
+};
+
+#define	PORT	0
+#define	WBSCOPE	0
+#define	main	cfgscope_main
+#include "cfgscope.cpp"
+#undef	main
+
+// Decode n words, through either the scope's decode_batch() or the default
+// SCOPE::decode_batch() calling decode(), and return whatever was written.
+// Since decode() writes to stdout, stdout is sent to a temporary file while
+// we do this.
+std::string	capture(CFGSCOPE &scope, const DEVBUS::BUSW *v, size_t n,
+			bool batch) {
+	std::string	result;
+	FILE		*tmp = tmpfile();
+	int		saved;
+	char		buf[4096];
+	size_t		ln;
+
+	fflush(stdout);
+	saved = dup(STDOUT_FILENO);
+	dup2(fileno(tmp), STDOUT_FILENO);
+	{
+		OUTBUF	out(stdout);
+
+		if (batch)
+			scope.decode_batch(v, n, out);
+		else
+			scope.SCOPE::decode_batch(v, n, out);
+	}
+	fflush(stdout);
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+
+	rewind(tmp);
+	while((ln = fread(buf, 1, sizeof(buf), tmp)) > 0)
+		result.append(buf, ln);
+	fclose(tmp);
+
+	return result;
+}
+
+int main(void) {
+	CFGSCOPE	scope(NULL, 0);
+	std::vector<DEVBUS::BUSW>	words;
+	size_t		pos;
+
+	srand(9);
+
+	// Every combination of the top two bits and the six bit code, with
+	// values at either end of the 24-bit field
+	for(unsigned top=0; top<4; top++)
+	for(unsigned code=0; code<64; code++) {
+		const unsigned	values[] = { 0, 0x0f, 0x10, 0xff, 0x100,
+					0x0fffff, 0x100000, 0xffffff };
+
+		for(unsigned k=0; k<sizeof(values)/sizeof(values[0]); k++)
+			words.push_back((top << 30) | (code << 24) | values[k]);
+	}
+
+	// ... and a great many random words
+	for(unsigned k=0; k<20000; k++)
+		words.push_back(((unsigned)rand() << 16) ^ (unsigned)rand());
+
+	// Decode them in batches of all kinds of sizes, including none
+	pos = 0;
+	for(unsigned batch=0; pos < words.size(); batch++) {
+		size_t	n = (batch < 4) ? batch : (1 + rand() % 3000);
+		std::string	fast, slow;
+
+		if (n > words.size() - pos)
+			n = words.size() - pos;
+		fast = capture(scope, &words[pos], n, true);
+		slow = capture(scope, &words[pos], n, false);
+
+		if (fast != slow) {
+			size_t	k = 0;
+
+			while((k < fast.size())&&(k < slow.size())
+					&&(fast[k] == slow[k]))
+				k++;
+			printf("ERR: DECODE_BATCH DIFFERS FROM DECODE, AT CHARACTER %d OF WORDS %d-%d\n",
+				(int)k, (int)pos, (int)(pos+n-1));
+			printf("ERR: DECODE_BATCH: %.40s\n", fast.c_str()
+				+ ((k > 20) ? k-20 : 0));
+			printf("ERR: DECODE      : %.40s\n", slow.c_str()
+				+ ((k > 20) ? k-20 : 0));
+			goto test_failure;
+		}
+
+		if ((n > 0)&&(fast.empty())) {
+			printf("ERR: NOTHING DECODED\n");
+			goto test_failure;
+		}
+
+		pos += n;
+	}
+
+	printf("SUCCESS!!\n");
+	exit(0);
+test_failure:
+	printf("TEST FAILED\n");
+	exit(-1);
+}
@@ -0,0 +1,265 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	edgeidx_tb.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Checks EDGEIDX's queries against a linear scan of the capture,
+//		expanded into one value per clock: the next and previous edges,
+//	the next edge to a given value, the number of edges in a range, and
+//	the value at a given clock.  Queries are made from random clocks, and
+//	from clock zero, the last clock of the capture, and past its end.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+
+#include "edgeidx.h"
+
+// The traces to check: nbits, and then nshift
+static const unsigned	traces[][2] = {
+	{ 1, 0 }, { 1, 30 }, { 2, 4 }, { 7, 1 }, { 16, 8 }, { 31, 0 } };
+static const unsigned	NTRACES = sizeof(traces)/sizeof(traces[0]);
+
+// The value of a trace on every clock.  A run word repeats the value before
+// it for (word&0x7fffffff)+1 clocks, save at the very start, where it's one
+// clock of zero.
+void	expand(const std::vector<uint32_t> &data, bool compressed,
+		unsigned nbits, unsigned nshift, std::vector<uint32_t> &v) {
+	uint32_t	mask = (nbits >= 32) ? 0xffffffff : ((1u << nbits)-1),
+			last = 0;
+
+	v.clear();
+	for(unsigned i=0; i<data.size(); i++) {
+		unsigned	nclks = 1;
+
+		if ((compressed)&&(data[i] & 0x80000000)) {
+			if (i > 0)
+				nclks = (data[i] & 0x7fffffff) + 1;
+		} else
+			last = (data[i] >> nshift) & mask;
+		v.insert(v.end(), nclks, last);
+	}
+}
+
+// Is there an edge, a change of value, at clock c?
+bool	edge(const std::vector<uint32_t> &v, uint64_t c) {
+	return (c > 0)&&(c < v.size())&&(v[c] != v[c-1]);
+}
+
+bool	check_query(const EDGEIDX &idx, unsigned t,
+		const std::vector<uint32_t> &v, uint64_t clk) {
+	const uint64_t	nclks = v.size();
+	uint64_t	at, want;
+	uint32_t	value;
+	bool		found;
+
+	// next_edge()
+	// {{{
+	for(want=clk; (want<nclks)&&(!edge(v, want)); want++)
+		;
+	value = 0xdeadbeef;
+	found = idx.next_edge(t, clk, at, &value);
+	if ((found != (want < nclks))
+			||((found)&&((at != want)||(value != v[want])))) {
+		printf("ERR: TRACE %d, NEXT EDGE FROM %ld: ", t, (long)clk);
+		if (found)
+			printf("%ld (TO %x), ", (long)at, value);
+		else
+			printf("NONE, ");
+		if (want < nclks)
+			printf("NOT %ld (TO %x)\n", (long)want, v[want]);
+		else
+			printf("NOT NONE\n");
+		return false;
+	}
+	// }}}
+
+	// prev_edge()
+	// {{{
+	want = (clk < nclks) ? clk : nclks-1;
+	while((want > 0)&&(!edge(v, want)))
+		want--;
+	value = 0xdeadbeef;
+	found = idx.prev_edge(t, clk, at, &value);
+	if ((found != (want > 0))
+			||((found)&&((at != want)||(value != v[want])))) {
+		printf("ERR: TRACE %d, PREVIOUS EDGE FROM %ld: ", t, (long)clk);
+		if (found)
+			printf("%ld (TO %x), ", (long)at, value);
+		else
+			printf("NONE, ");
+		if (want > 0)
+			printf("NOT %ld (TO %x)\n", (long)want, v[want]);
+		else
+			printf("NOT NONE\n");
+		return false;
+	}
+	// }}}
+
+	// next_value(), to the value of a random clock
+	// {{{
+	uint32_t	target = v[rand() % nclks];
+
+	for(want=clk; want<nclks; want++)
+		if ((edge(v, want))&&(v[want] == target))
+			break;
+	found = idx.next_value(t, clk, target, at);
+	if ((found != (want < nclks))||((found)&&(at != want))) {
+		printf("ERR: TRACE %d, NEXT EDGE TO %x FROM %ld: %ld, NOT %ld\n",
+			t, target, (long)clk, (found) ? (long)at : -1l,
+			(want < nclks) ? (long)want : -1l);
+		return false;
+	}
+	// }}}
+
+	// count(), from clk to a random clock after it
+	// {{{
+	uint64_t	last = clk + rand() % (nclks + 2), n = 0, got;
+
+	for(uint64_t c=clk; (c<last)&&(c<nclks); c++)
+		if (edge(v, c))
+			n++;
+	got = idx.count(t, clk, last);
+	if (got != n) {
+		printf("ERR: TRACE %d, %ld EDGES IN CLOCKS %ld TO %ld, NOT %ld\n",
+			t, (long)got, (long)clk, (long)last-1, (long)n);
+		return false;
+	}
+	// }}}
+
+	// value_at()
+	// {{{
+	value = idx.value_at(t, clk);
+	if (value != v[(clk < nclks) ? clk : nclks-1]) {
+		printf("ERR: TRACE %d, VALUE AT %ld IS %x, NOT %x\n",
+			t, (long)clk, value, v[(clk < nclks) ? clk : nclks-1]);
+		return false;
+	}
+	// }}}
+
+	return true;
+}
+
+bool	check(const std::vector<uint32_t> &data, bool compressed,
+		bool pieces) {
+	EDGEIDX		idx;
+
+	for(unsigned k=0; k<NTRACES; k++)
+		idx.add_trace(traces[k][0], traces[k][1]);
+	idx.setup(data.size(), compressed);
+
+	if (pieces) {
+		while(!idx.complete())
+			idx.extend(data.data(), idx.valid() + 1 + rand() % 300);
+	} else
+		idx.extend(data.data(), data.size());
+
+	for(unsigned t=0; t<NTRACES; t++) {
+		std::vector<uint32_t>	v;
+		uint64_t		nedges = 0;
+
+		expand(data, compressed, traces[t][0], traces[t][1], v);
+		if (idx.nclocks() != v.size()) {
+			printf("ERR: INDEX COVERS %ld CLOCKS, NOT %ld\n",
+				(long)idx.nclocks(), (long)v.size());
+			return false;
+		}
+
+		for(uint64_t c=0; c<v.size(); c++)
+			if (edge(v, c))
+				nedges++;
+		if (idx.nedges(t) != nedges) {
+			printf("ERR: TRACE %d HAS %ld EDGES, NOT %ld\n", t,
+				(long)idx.nedges(t), (long)nedges);
+			return false;
+		}
+
+		// The first clock, the last, one past it and well past it,
+		// and then anywhere
+		const uint64_t	ends[] = { 0, 1, v.size()-1, v.size(),
+					v.size()+1, v.size()+1000 };
+		for(unsigned k=0; k<sizeof(ends)/sizeof(ends[0]); k++)
+			if (!check_query(idx, t, v, ends[k]))
+				return false;
+		for(int q=0; q<300; q++)
+			if (!check_query(idx, t, v, rand() % v.size()))
+				return false;
+	}
+
+	return true;
+}
+
+int main(void) {
+	std::vector<uint32_t>	data;
+
+	srand(22);
+
+	for(int trial=0; trial<60; trial++) {
+		bool	compressed = (trial & 1), pieces = (trial & 2);
+
+		data.resize(1 + rand() % 3000);
+		for(unsigned i=0; i<data.size(); i++) {
+			// Runs--including the odd long one--and words from
+			// only a few values, so that some traces stay quiet
+			// for a while
+			if ((compressed)&&(rand() % 3 == 0)) {
+				data[i] = 0x80000000 | (rand() % 10);
+				if (rand() % 50 == 0)
+					data[i] += 5000;
+				continue;
+			} else if (rand() & 1)
+				data[i] = (rand() % 3) * 0x12492492;
+			else
+				data[i] = rand() ^ (rand() << 16);
+			if (compressed)
+				data[i] &= 0x7fffffff;
+		}
+
+		if ((compressed)&&(trial & 4))
+			data[0] = 0x80000000 | rand();
+
+		if (!check(data, compressed, pieces)) {
+			printf("ERR: ... IN A %s CAPTURE OF %d WORDS\n",
+				(compressed) ? "COMPRESSED":"UNCOMPRESSED",
+				(int)data.size());
+			goto test_failure;
+		}
+	}
+
+	printf("SUCCESS!!\n");
+	exit(0);
+test_failure:
+	printf("TEST FAILED\n");
+	exit(-1);
+}
@@ -0,0 +1,228 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	latency_tb.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Checks LATENCY::measure() against a naive pairing of request and
+//		response events, made one clock at a time over the capture
+//	expanded into one value per clock.  Requests overlap, with several
+//	outstanding at once, and some go unanswered while some responses have
+//	no request.  Captures are both uncompressed and run-length compressed,
+//	and some are long enough to span several of measure()'s blocks.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+#include "search.h"
+#include "latency.h"
+
+static const char	*pairing_name[] = { "FIRST", "LAST", "FIFO" };
+
+// A random capture: requests on bit 0 and responses on bit 1, with a few
+// other bits besides.  A compressed capture has run words mixed in.  vals
+// gets the value of every clock.
+struct	CAPTURE {
+	bool			m_compressed;
+	std::vector<uint32_t>	m_data, m_vals;
+	std::vector<uint64_t>	m_tindex;
+
+	void	generate(bool compressed, unsigned nwords, unsigned maxrun) {
+		uint32_t	last = 0;
+
+		m_compressed = compressed;
+		m_data.clear();
+		m_vals.clear();
+		m_tindex.clear();
+
+		for(unsigned k=0; k<nwords; k++) {
+			uint32_t	w = rand() & 0x0f;
+
+			if ((compressed)&&(k > 0)&&(rand() % 3 == 0)) {
+				unsigned ln = rand() % maxrun;
+
+				if (rand() % 100 == 0)
+					ln += 2000;
+				w = 0x80000000 | ln;
+				m_tindex.push_back(m_vals.size());
+				m_vals.insert(m_vals.end(), ln+1, last);
+			} else {
+				m_tindex.push_back(m_vals.size());
+				m_vals.push_back(w);
+				last = w;
+			}
+			m_data.push_back(w);
+		}
+
+		if (compressed)
+			m_tindex.push_back(m_vals.size());
+	}
+
+	SEARCH	search(void) const {
+		return SEARCH(m_data.data(), m_data.size(), m_compressed,
+			(m_compressed) ? m_tindex.data() : NULL);
+	}
+};
+
+// The clocks a term matches, from one clock to the next
+bool	matches(const CAPTURE &cap, const SEARCH::TERM &t, uint64_t c) {
+	if ((cap.m_vals[c] & t.m_mask) != t.m_value)
+		return false;
+	if ((t.m_pmask != 0)&&((c == 0)
+			||((cap.m_vals[c-1] & t.m_pmask) != t.m_pvalue)))
+		return false;
+	return true;
+}
+
+// An event is the first clock of each run of clocks a term matches
+bool	event(const CAPTURE &cap, const SEARCH::TERM &t, uint64_t c) {
+	return (matches(cap, t, c))&&((c == 0)||(!matches(cap, t, c-1)));
+}
+
+// Pair the events one clock at a time, ends before starts, adding each
+// latency to ref
+void	naive(const CAPTURE &cap, const SEARCH::TERM &start,
+		const SEARCH::TERM &end, LATENCY::PAIRING pairing,
+		LATENCY &ref, uint64_t &orphans, uint64_t &unfinished) {
+	std::deque<uint64_t>	pending;
+
+	orphans = 0;
+	for(uint64_t c=0; c<cap.m_vals.size(); c++) {
+		if (event(cap, end, c)) {
+			if (pending.empty())
+				orphans++;
+			else if (pairing == LATENCY::FIFO) {
+				ref.add(c - pending.front());
+				pending.pop_front();
+			} else {
+				ref.add(c - pending.front());
+				pending.clear();
+			}
+		}
+
+		if (event(cap, start, c)) {
+			if ((pairing == LATENCY::FIFO)||(pending.empty()))
+				pending.push_back(c);
+			else if (pairing == LATENCY::LAST)
+				pending.front() = c;
+			// else FIRST ignores any start after the first
+		}
+	}
+
+	unfinished = pending.size();
+}
+
+bool	check(const CAPTURE &cap, const SEARCH::TERM &start,
+		const SEARCH::TERM &end, LATENCY::PAIRING pairing) {
+	SEARCH		search = cap.search();
+	LATENCY		lat, ref;
+	uint64_t	orphans, unfinished;
+	std::vector<LATENCY::BIN>	bins, rbins;
+	const double	pct[] = { 0.01, 0.25, 0.5, 0.9, 0.999 };
+	bool		ok = true;
+
+	lat.measure(search, start, end, pairing);
+	naive(cap, start, end, pairing, ref, orphans, unfinished);
+
+	lat.histogram(bins);
+	ref.histogram(rbins);
+	ok = (lat.count() == ref.count())&&(lat.min() == ref.min())
+		&&(lat.max() == ref.max())&&(lat.mean() == ref.mean())
+		&&(lat.orphans() == orphans)
+		&&(lat.unfinished() == unfinished)
+		&&(bins.size() == rbins.size());
+	for(unsigned k=0; (ok)&&(k<bins.size()); k++)
+		ok = (bins[k].m_lo == rbins[k].m_lo)
+			&&(bins[k].m_hi == rbins[k].m_hi)
+			&&(bins[k].m_count == rbins[k].m_count);
+	for(unsigned k=0; (ok)&&(k<sizeof(pct)/sizeof(pct[0])); k++)
+		ok = (lat.percentile(pct[k]) == ref.percentile(pct[k]));
+
+	if (!ok) {
+		printf("ERR: %s PAIRING OF %s CAPTURE, %d WORDS\n",
+			pairing_name[pairing],
+			(cap.m_compressed) ? "A COMPRESSED" : "AN UNCOMPRESSED",
+			(int)cap.m_data.size());
+		printf("\tCOUNT %ld, MIN %ld, MAX %ld, MEAN %.3f, ORPHANS %ld, UNFINISHED %ld\n",
+			(long)lat.count(), (long)lat.min(), (long)lat.max(),
+			lat.mean(), (long)lat.orphans(),
+			(long)lat.unfinished());
+		printf("\tNOT   %ld, MIN %ld, MAX %ld, MEAN %.3f, ORPHANS %ld, UNFINISHED %ld\n",
+			(long)ref.count(), (long)ref.min(), (long)ref.max(),
+			ref.mean(), (long)orphans, (long)unfinished);
+	}
+
+	return ok;
+}
+
+int main(void) {
+	CAPTURE		cap;
+	SEARCH::TERM	req_rise, req_high, ack_rise, ack_high, clk_rise;
+
+	// A request is bit 0 rising, or high.  A response is bit 1 rising,
+	// or high.
+	req_rise.is(1, 1).was(1, 0);
+	req_high.is(1, 1);
+	ack_rise.is(2, 2).was(2, 0);
+	ack_high.is(2, 2);
+	// Both start and end: from one rising edge of bit 2 to the next
+	clk_rise.is(4, 4).was(4, 0);
+
+	srand(25);
+
+	for(int trial=0; trial<48; trial++) {
+		bool		compressed = (trial & 1);
+		unsigned	nwords = (trial % 8 == 0) ? 40000
+					: 1 + rand() % 3000;
+
+		cap.generate(compressed, nwords, (trial & 2) ? 4 : 30);
+
+		for(int p=LATENCY::FIRST; p<=LATENCY::FIFO; p++) {
+			LATENCY::PAIRING pairing = (LATENCY::PAIRING)p;
+
+			if ((!check(cap, req_rise, ack_rise, pairing))
+				||(!check(cap, req_high, ack_high, pairing))
+				||(!check(cap, req_rise, ack_high, pairing))
+				||(!check(cap, clk_rise, clk_rise, pairing)))
+				goto test_failure;
+		}
+	}
+
+	printf("SUCCESS!!\n");
+	exit(0);
+test_failure:
+	printf("TEST FAILED\n");
+	exit(-1);
+}
@@ -0,0 +1,189 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	memscope_tb.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Checks MEMSCOPE against a simulated memscope, whose capture wraps
+//	around its memory.  Reading that memory directly, in bursts, must give
+//	the same words as reading them through the data register, without
+//	touching the data register or reading past the memory's end.  Then
+//	checks the memscope's status bits, and that benchmark() finds the two
+//	readouts the same.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "simbus.h"
+#include "memscope.h"
+
+#define	MEMBASE	0x40000000
+
+class	TSCOPE : public MEMSCOPE {
+public:
+	TSCOPE(DEVBUS *fpga) : MEMSCOPE(fpga, 0, MEMBASE) {}
+
+	virtual	void	define_traces(void) {
+		register_trace("data", 32, 0);
+	}
+
+	virtual	void	decode(DEVBUS::BUSW v) const {
+		printf("%08x", v);
+	}
+};
+
+bool	check_data(const char *what, TSCOPE &scope, MEMSIMBUS &sim) {
+	if (scope.load() != sim.m_mem.size()) {
+		printf("ERR: %s READ %d WORDS, NOT %d\n", what, scope.load(),
+			(int)sim.m_mem.size());
+		return false;
+	}
+
+	for(unsigned i=0; i<sim.m_mem.size(); i++)
+		if (scope[i] != sim.capture(i)) {
+			printf("ERR: %s WORD %d IS %08x, NOT %08x\n", what, i,
+				scope[i], sim.capture(i));
+			return false;
+		}
+
+	return true;
+}
+
+// Read the capture directly from memory, burst words at a time
+bool	check_direct(unsigned oldest, unsigned burst) {
+	const unsigned	LGMEM = 12;
+	MEMSIMBUS	sim(LGMEM, 100, MEMBASE, oldest);
+	TSCOPE		scope(&sim);
+	unsigned	nbursts;
+
+	for(unsigned i=0; i<sim.m_mem.size(); i++)
+		sim.m_mem[i] = rand();
+
+	scope.set_burst(burst);
+	if (!check_data("DIRECT READ", scope, sim))
+		return false;
+
+	if (sim.m_nread != 0) {
+		printf("ERR: DIRECT READ USED THE DATA REGISTER %ld TIMES\n",
+			sim.m_nread);
+		return false;
+	}
+
+	if (sim.m_overrun) {
+		printf("ERR: DIRECT READ WENT PAST THE END OF MEMORY\n");
+		return false;
+	}
+
+	if (sim.m_maxburst > (int)burst) {
+		printf("ERR: BURST OF %d WORDS, LONGER THAN %d\n",
+			sim.m_maxburst, burst);
+		return false;
+	}
+
+	// One burst more than needed, at most, where the capture wraps
+	nbursts = ((1u<<LGMEM) + burst-1) / burst + 1;
+	if (sim.m_nburst > nbursts) {
+		printf("ERR: %ld BURSTS, NOT %d OR FEWER\n", sim.m_nburst,
+			nbursts);
+		return false;
+	}
+
+	return true;
+}
+
+int main(void) {
+	const unsigned	oldest[] = { 0, 1, 1000, 4095 },
+			bursts[] = { 1, 300, 1024, 4096, 1<<16 };
+
+	srand(13);
+	for(unsigned i=0; i<sizeof(oldest)/sizeof(oldest[0]); i++)
+	for(unsigned b=0; b<sizeof(bursts)/sizeof(bursts[0]); b++)
+		if (!check_direct(oldest[i], bursts[b])) {
+			printf("ERR: OLDEST WORD %d, BURSTS OF %d\n",
+				oldest[i], bursts[b]);
+			goto test_failure;
+		}
+
+	{
+		// Through the data register, as any other scope
+		MEMSIMBUS	sim(10, 20, MEMBASE, 700);
+		TSCOPE		scope(&sim);
+
+		for(unsigned i=0; i<sim.m_mem.size(); i++)
+			sim.m_mem[i] = rand();
+
+		scope.set_direct(false);
+		if (!check_data("DATA REGISTER READ", scope, sim))
+			goto test_failure;
+		if ((sim.m_nburst != 0)||(sim.m_nread != sim.m_mem.size())) {
+			printf("ERR: DATA REGISTER READ: %ld WORDS READ, "
+				"%ld BURSTS FROM MEMORY\n", sim.m_nread,
+				sim.m_nburst);
+			goto test_failure;
+		}
+
+		if (!scope.benchmark(stdout)) {
+			printf("ERR: BENCHMARK READOUTS DIFFER\n");
+			goto test_failure;
+		}
+
+		// Stopped, triggered and primed is 3.  A set top bit marks an
+		// overflow, or a bus error, and the scope isn't ready.
+		if (!scope.ready(0x30000000)) {
+			printf("ERR: A STOPPED MEMSCOPE ISN\'T READY\n");
+			goto test_failure;
+		}
+
+		if ((scope.ready(0x50000000))||(!scope.bus_error())
+				||(scope.overflow())) {
+			printf("ERR: A BUS ERROR WASN\'T REPORTED\n");
+			goto test_failure;
+		}
+
+		if ((scope.ready(0x60000000))||(!scope.overflow())
+				||(scope.bus_error())) {
+			printf("ERR: AN OVERFLOW WASN\'T REPORTED\n");
+			goto test_failure;
+		}
+
+		if ((scope.ready(0x10000000))||(scope.overflow())) {
+			printf("ERR: A PRIMED MEMSCOPE IS READY\n");
+			goto test_failure;
+		}
+	}
+
+	printf("SUCCESS!!\n");
+	exit(0);
+test_failure:
+	printf("TEST FAILED\n");
+	exit(-1);
+}
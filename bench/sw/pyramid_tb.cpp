@@ -0,0 +1,239 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	pyramid_tb.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Checks the PYRAMID's summaries against a naive scan of the
+//		words they summarize: every block of every level, and queries of
+//	random ranges--most of which start and end part way through a block.
+//	Captures are both uncompressed and compressed, built both all at once
+//	and a piece at a time, with blocks of several sizes.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+
+#include "pyramid.h"
+
+typedef	PYRAMID::NODE	NODE;
+
+// The traces to check: nbits, and then nshift
+static const unsigned	traces[][2] = {
+	{ 1, 0 }, { 1, 30 }, { 3, 2 }, { 8, 4 }, { 13, 17 }, { 31, 0 } };
+static const unsigned	NTRACES = sizeof(traces)/sizeof(traces[0]);
+
+// The value of a trace at every word.  A run word takes the value of the data
+// word it repeats, or zero if there's none before it.
+void	values(const std::vector<uint32_t> &data, bool compressed,
+		unsigned nbits, unsigned nshift, std::vector<uint32_t> &v) {
+	uint32_t	mask = (nbits >= 32) ? 0xffffffff : ((1u << nbits)-1),
+			last = 0;
+
+	v.resize(data.size());
+	for(unsigned i=0; i<data.size(); i++) {
+		if ((!compressed)||((data[i] & 0x80000000)==0))
+			last = (data[i] >> nshift) & mask;
+		v[i] = last;
+	}
+}
+
+// Summarize words start to end-1, one at a time.  The first word counts as a
+// change if first is set, and it differs from the word before it.
+NODE	naive(const std::vector<uint32_t> &v, unsigned start, unsigned end,
+		bool first) {
+	NODE	n;
+
+	if (start >= end) {
+		n.m_min = n.m_max = n.m_or = n.m_and = n.m_changes = 0;
+		return n;
+	}
+
+	n.m_min = n.m_and = 0xffffffff;
+	n.m_max = n.m_or = n.m_changes = 0;
+	for(unsigned i=start; i<end; i++) {
+		if (v[i] < n.m_min)
+			n.m_min = v[i];
+		if (v[i] > n.m_max)
+			n.m_max = v[i];
+		n.m_or  |= v[i];
+		n.m_and &= v[i];
+		if ((i > 0)&&((i > start)||(first))&&(v[i] != v[i-1]))
+			n.m_changes++;
+	}
+
+	return n;
+}
+
+bool	same(const NODE &got, const NODE &want) {
+	return (got.m_min == want.m_min)&&(got.m_max == want.m_max)
+		&&(got.m_or == want.m_or)&&(got.m_and == want.m_and)
+		&&(got.m_changes == want.m_changes);
+}
+
+void	report(const char *what, const NODE &got, const NODE &want) {
+	printf("ERR: %s\n", what);
+	printf("\tMIN %08x MAX %08x OR %08x AND %08x CHANGES %d\n",
+		got.m_min, got.m_max, got.m_or, got.m_and, got.m_changes);
+	printf("\tNOT %08x     %08x    %08x     %08x         %d\n",
+		want.m_min, want.m_max, want.m_or, want.m_and,
+		want.m_changes);
+}
+
+bool	check(const std::vector<uint32_t> &data, bool compressed,
+		unsigned lgbase, bool pieces) {
+	PYRAMID		pyr;
+	char		what[128];
+
+	for(unsigned k=0; k<NTRACES; k++)
+		pyr.add_trace(traces[k][0], traces[k][1]);
+	pyr.setup(data.size(), compressed, lgbase);
+
+	if (pieces) {
+		while(!pyr.complete())
+			pyr.extend(data.data(), pyr.valid() + 1 + rand() % 300);
+	} else
+		pyr.extend(data.data(), data.size());
+
+	for(unsigned t=0; t<NTRACES; t++) {
+		std::vector<uint32_t>	v;
+
+		values(data, compressed, traces[t][0], traces[t][1], v);
+
+		// Every block of every level, up to a single block at the top
+		for(unsigned l=0; l<pyr.nlevels(t); l++) {
+			const std::vector<NODE>	&lvl = pyr.level(t, l);
+			unsigned	bs = pyr.block_size(l),
+					nblocks = (data.size() + bs - 1) / bs;
+
+			if (lvl.size() != nblocks) {
+				printf("ERR: LEVEL %d OF TRACE %d HAS %d BLOCKS, NOT %d\n",
+					l, t, (int)lvl.size(), nblocks);
+				return false;
+			}
+
+			for(unsigned b=0; b<nblocks; b++) {
+				unsigned	end = (b+1)*bs;
+
+				if (end > data.size())
+					end = data.size();
+				NODE	want = naive(v, b*bs, end, true);
+				if (!same(lvl[b], want)) {
+					sprintf(what, "TRACE %d, LEVEL %d, BLOCK %d",
+						t, l, b);
+					report(what, lvl[b], want);
+					return false;
+				}
+			}
+
+			if ((l+1 == pyr.nlevels(t))&&(nblocks != 1)) {
+				printf("ERR: TOP LEVEL OF TRACE %d HAS %d BLOCKS\n",
+					t, nblocks);
+				return false;
+			}
+		}
+
+		// Random ranges, including empty ones and ones which run to
+		// either end of the capture
+		for(int q=0; q<200; q++) {
+			unsigned	start = rand() % (data.size()+1),
+					end = rand() % (data.size()+1);
+
+			if (q == 0)
+				start = 0;
+			else if (q == 1)
+				end = data.size();
+			else if (q == 2)
+				end = start;
+			if (start > end) {
+				unsigned tmp = start;
+				start = end;
+				end = tmp;
+			}
+
+			NODE	got  = pyr.query(t, data.data(), start, end),
+				want = naive(v, start, end, false);
+			if (!same(got, want)) {
+				sprintf(what, "TRACE %d, WORDS %d TO %d", t,
+					start, end-1);
+				report(what, got, want);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+int main(void) {
+	std::vector<uint32_t>	data;
+
+	srand(21);
+
+	for(int trial=0; trial<60; trial++) {
+		bool		compressed = (trial & 1), pieces = (trial & 2);
+		unsigned	lgbase = rand() % 7;
+
+		data.resize(1 + rand() % 3000);
+		for(unsigned i=0; i<data.size(); i++) {
+			// Runs, and words from only a few values so that
+			// the summaries see the same value now and then
+			if ((compressed)&&(rand() % 3 == 0)) {
+				data[i] = 0x80000000 | (rand() % 20);
+				continue;
+			} else if (rand() & 1)
+				data[i] = (rand() % 4) * 0x15555555;
+			else
+				data[i] = rand() ^ (rand() << 16);
+			if (compressed)
+				data[i] &= 0x7fffffff;
+		}
+
+		if ((compressed)&&(trial & 4))
+			data[0] = 0x80000000;
+
+		if (!check(data, compressed, lgbase, pieces)) {
+			printf("ERR: ... IN A %s CAPTURE OF %d WORDS, "
+				"BLOCKS OF %d\n",
+				(compressed) ? "COMPRESSED":"UNCOMPRESSED",
+				(int)data.size(), 1 << lgbase);
+			goto test_failure;
+		}
+	}
+
+	printf("SUCCESS!!\n");
+	exit(0);
+test_failure:
+	printf("TEST FAILED\n");
+	exit(-1);
+}
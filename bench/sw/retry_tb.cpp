@@ -0,0 +1,174 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	retry_tb.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Injects bus errors into the readout of a (simulated) scope, both
+//		from a DEVBUS that throws them and from one that only reports them
+//	through bus_err(), and checks the readout recovers: by retrying, if
+//	the scope can seek, or otherwise by keeping the words read before the
+//	error--rather than letting the error escape from rawread().  Also
+//	checks that, with retries left off as they are by default, the scope
+//	is read in one go, without any writes to it.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "simbus.h"
+#include "scopecls.h"
+
+class	TSCOPE : public SCOPE {
+public:
+	TSCOPE(DEVBUS *fpga) : SCOPE(fpga, 0) {}
+
+	virtual	void	define_traces(void) {
+		register_trace("data", 32, 0);
+	}
+
+	virtual	void	decode(DEVBUS::BUSW v) const {
+		printf("%08x", v);
+	}
+};
+
+// Read a 4k word scope, failing on the 1000th data word, in checkpoints of
+// 256 words.  A scope that can seek retries the fourth checkpoint and reads
+// everything.  One that can't stops after the third.
+bool	check_readout(bool seek, bool throws, bool chunked) {
+	const unsigned	LGMEM = 12, CHECKPOINT = 256, ERR_WORD = 1000;
+	SIMBUS		bus(LGMEM, 100, seek);
+	TSCOPE		scope(&bus);
+	unsigned	nvalid, expected;
+
+	for(unsigned k=0; k<bus.m_mem.size(); k++)
+		bus.m_mem[k] = rand();
+	bus.m_err_after = ERR_WORD;
+	bus.m_throw = throws;
+
+	scope.set_retries(3, 1);
+	scope.set_checkpoint(CHECKPOINT);
+	if (chunked)
+		scope.set_readout_chunk(CHECKPOINT);
+
+	try {
+		scope.rawread();
+		nvalid = scope.load();
+	} catch(BUSERR &e) {
+		printf("ERR: BUS ERROR AT 0x%08x ESCAPED FROM THE READOUT\n",
+			e.addr);
+		return false;
+	}
+
+	expected = (seek) ? bus.m_mem.size()
+			: ((ERR_WORD-1) / CHECKPOINT) * CHECKPOINT;
+	if (nvalid != expected) {
+		printf("ERR: %d WORDS READ, NOT %d\n", nvalid, expected);
+		return false;
+	}
+
+	if (scope.readout_failed() == seek) {
+		printf("ERR: READOUT %s, AND SHOULDN\'T HAVE\n",
+			(seek) ? "FAILED" : "SUCCEEDED");
+		return false;
+	}
+
+	if ((seek)&&(scope.retried_chunks() != 1)) {
+		printf("ERR: %ld CHUNKS RETRIED, NOT ONE\n",
+			scope.retried_chunks());
+		return false;
+	}
+
+	for(unsigned k=0; k<nvalid; k++)
+		if (scope[k] != bus.m_mem[k]) {
+			printf("ERR: WORD %d IS %08x, NOT %08x\n", k,
+				scope[k], bus.m_mem[k]);
+			return false;
+		}
+
+	return true;
+}
+
+// With retries left off, as they are by default, the scope should be read in
+// one go, without writing to it at all
+bool	check_default(bool seek) {
+	SIMBUS		bus(12, 100, seek);
+	TSCOPE		scope(&bus);
+
+	for(unsigned k=0; k<bus.m_mem.size(); k++)
+		bus.m_mem[k] = rand();
+
+	scope.rawread();
+	if (scope.load() != bus.m_mem.size()) {
+		printf("ERR: %d WORDS READ, NOT %d\n", scope.load(),
+			(int)bus.m_mem.size());
+		return false;
+	}
+
+	if ((bus.m_ndatawr != 0)||(bus.m_nreadz != 1)) {
+		printf("ERR: DEFAULT READOUT TOOK %ld READS, AND %ld WRITES\n",
+			bus.m_nreadz, bus.m_ndatawr);
+		return false;
+	}
+
+	for(unsigned k=0; k<bus.m_mem.size(); k++)
+		if (scope[k] != bus.m_mem[k]) {
+			printf("ERR: WORD %d IS %08x, NOT %08x\n", k,
+				scope[k], bus.m_mem[k]);
+			return false;
+		}
+
+	return true;
+}
+
+int main(void) {
+	srand(19);
+
+	if ((!check_default(false))||(!check_default(true)))
+		goto test_failure;
+
+	for(int k=0; k<8; k++) {
+		bool	seek = (k&1), throws = (k&2), chunked = (k&4);
+
+		if (!check_readout(seek, throws, chunked)) {
+			printf("ERR: ... WITH%s SEEK, WITH%s THROW, %s\n",
+				(seek) ? "":"OUT", (throws) ? "":"OUT",
+				(chunked) ? "CHUNKED" : "IN ONE CALL");
+			goto test_failure;
+		}
+	}
+
+	printf("SUCCESS!!\n");
+	exit(0);
+test_failure:
+	printf("TEST FAILED\n");
+	exit(-1);
+}
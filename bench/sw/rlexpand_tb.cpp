@@ -0,0 +1,198 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	rlexpand_tb.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Checks rle_expand(), and whatever SIMD kernel it uses on this CPU,
+//		against rle_expand_scalar(), the plain C++ reference it must
+//	match.  Both are run on the same random and edge-case streams of data
+//	and run words--cut short at every kind of place--and must agree on
+//	every value written, the number of values and words used, and the
+//	last value.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "rlexpand.h"
+
+// A random stream of nwords words.  runpct percent of them are runs, of up
+// to maxrun clocks each--with the occasional huge one.
+void	random_stream(std::vector<uint32_t> &data, unsigned nwords,
+		unsigned runpct, unsigned maxrun) {
+	data.resize(nwords);
+	for(unsigned k=0; k<nwords; k++) {
+		if ((unsigned)(rand() % 100) < runpct) {
+			uint32_t	ln = rand() % maxrun;
+
+			if (rand() % 1000 == 0)
+				ln = 0x7fffffff - (rand() & 0x0ff);
+			data[k] = 0x80000000 | ln;
+		} else
+			data[k] = rand() & 0x7fffffff;
+	}
+}
+
+// Expand data both ways, into at most nout values, and compare everything
+bool	compare(const std::vector<uint32_t> &data, uint64_t nout,
+		uint32_t last) {
+	std::vector<uint32_t>	simd(nout+1), ref(nout+1);
+	uint32_t	simd_last = last, ref_last = last;
+	unsigned	simd_used = 0, ref_used = 0;
+	uint64_t	simd_n, ref_n;
+
+	simd_n = rle_expand(simd.data(), nout, data.data(), data.size(),
+			simd_last, simd_used);
+	ref_n = rle_expand_scalar(ref.data(), nout, data.data(), data.size(),
+			ref_last, ref_used);
+
+	if ((simd_n != ref_n)||(simd_used != ref_used)
+			||(simd_last != ref_last)) {
+		printf("ERR: %d WORDS, NOUT=%ld: RLE_EXPAND WROTE %ld, USED %d, LAST %08x\n",
+			(int)data.size(), (long)nout, (long)simd_n,
+			simd_used, simd_last);
+		printf("ERR: ... BUT RLE_EXPAND_SCALAR WROTE %ld, USED %d, LAST %08x\n",
+			(long)ref_n, ref_used, ref_last);
+		return false;
+	}
+
+	if (memcmp(simd.data(), ref.data(), ref_n * sizeof(uint32_t)) != 0) {
+		for(uint64_t k=0; k<ref_n; k++)
+			if (simd[k] != ref[k]) {
+				printf("ERR: %d WORDS, NOUT=%ld: VALUE %ld IS %08x, NOT %08x\n",
+					(int)data.size(), (long)nout, (long)k,
+					simd[k], ref[k]);
+				break;
+			}
+		return false;
+	}
+
+	return true;
+}
+
+// The total number of clocks in a stream, so it may be cut short anywhere
+uint64_t	stream_clocks(const std::vector<uint32_t> &data) {
+	uint64_t	n = 0;
+
+	for(unsigned k=0; k<data.size(); k++) {
+		if (data[k] & 0x80000000)
+			n += (uint64_t)(data[k] & 0x7fffffff) + 1;
+		else
+			n++;
+	}
+
+	return n;
+}
+
+int main(void) {
+	const uint64_t	MAXOUT = 1<<20;
+	std::vector<uint32_t>	data;
+
+	srand(20);
+
+	// Edge cases
+	// {{{
+	// Nothing at all
+	data.clear();
+	if (!compare(data, 16, 0x1234))
+		goto test_failure;
+
+	// Room for nothing
+	random_stream(data, 64, 30, 8);
+	if (!compare(data, 0, 0x1234))
+		goto test_failure;
+
+	// A run at the very beginning, repeating last
+	data.assign(1, 0x80000005);
+	data.push_back(7);
+	if (!compare(data, 16, 0x1234))
+		goto test_failure;
+
+	// Runs only, of every length from 0 to 70, cut short at each clock
+	data.clear();
+	for(uint32_t ln=0; ln<=70; ln++)
+		data.push_back(0x80000000 | ln);
+	for(uint64_t nout=0; nout<=stream_clocks(data); nout += 37)
+		if (!compare(data, nout, 0x1234))
+			goto test_failure;
+
+	// Data words only, at every length around the SIMD widths
+	for(unsigned n=0; n<=80; n++) {
+		random_stream(data, n, 0, 1);
+		for(uint64_t nout=(n>9)?n-9:0; nout<=n+1; nout++)
+			if (!compare(data, nout, 0))
+				goto test_failure;
+	}
+
+	// Zero length runs between data words
+	data.clear();
+	for(unsigned k=0; k<100; k++) {
+		data.push_back(k);
+		data.push_back(0x80000000);
+	}
+	if (!compare(data, 1000, 0))
+		goto test_failure;
+	// }}}
+
+	// Random streams
+	// {{{
+	for(int trial=0; trial<400; trial++) {
+		unsigned	nwords = rand() % 3000,
+				runpct = rand() % 101,
+				maxrun = 1 + (rand() % ((trial & 1) ? 8 : 300));
+		uint64_t	nclocks, nout;
+
+		random_stream(data, nwords, runpct, maxrun);
+		nclocks = stream_clocks(data);
+
+		// Cut it short at a random place, or at the end, or not at all
+		switch(trial % 3) {
+		case 0: nout = (nclocks > 0) ? rand() % nclocks : 0; break;
+		case 1: nout = nclocks; break;
+		default: nout = nclocks + 5; break;
+		}
+		if (nout > MAXOUT)
+			nout = MAXOUT;
+
+		if (!compare(data, nout, rand() & 0x7fffffff))
+			goto test_failure;
+	}
+	// }}}
+
+	printf("SUCCESS!!\n");
+	exit(0);
+test_failure:
+	printf("TEST FAILED\n");
+	exit(-1);
+}
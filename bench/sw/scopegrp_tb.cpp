@@ -0,0 +1,196 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	scopegrp_tb.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Checks SCOPE_GROUP against two (simulated) scopes, packed one
+//		after the other on the same bus.  While one scope waits on its
+//	trigger, the other stops and is read out.  Polling must only ever
+//	read the scopes' control registers, so that the readout of each
+//	starts from its oldest word, and both must be read out in full.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "simbus.h"
+#include "scopecls.h"
+#include "scopegrp.h"
+
+class	TSCOPE : public SCOPE {
+public:
+	TSCOPE(DEVBUS *fpga, unsigned addr) : SCOPE(fpga, addr) {}
+
+	virtual	void	define_traces(void) {
+		register_trace("data", 32, 0);
+	}
+
+	virtual	void	decode(DEVBUS::BUSW v) const {
+		printf("%08x", v);
+	}
+};
+
+// Several SIMBUS scopes, each taking eight bytes of the address space: a
+// control register, and then a data register
+class	GROUPBUS : public DEVBUS {
+public:
+	std::vector<SIMBUS *>	m_scopes;
+
+	SIMBUS	&scope(BUSW a) { return *m_scopes[a / 8]; }
+
+	void	kill(void) {}
+	void	close(void) {}
+
+	void	writeio(const BUSW a, const BUSW v) {
+		scope(a).writeio(a & 7, v);
+	}
+
+	BUSW	readio(const BUSW a) { return scope(a).readio(a & 7); }
+
+	void	readi(const BUSW a, const int len, BUSW *buf) {
+		for(int i=0; i<len; i++)
+			buf[i] = readio(a+4*i);
+	}
+
+	void	readz(const BUSW a, const int len, BUSW *buf) {
+		scope(a).readz(a & 7, len, buf);
+	}
+
+	void	writei(const BUSW a, const int len, const BUSW *buf) {
+		for(int i=0; i<len; i++)
+			writeio(a+4*i, buf[i]);
+	}
+
+	void	writez(const BUSW a, const int len, const BUSW *buf) {
+		for(int i=0; i<len; i++)
+			writeio(a, buf[i]);
+	}
+
+	bool	poll(void) { return false; }
+	void	usleep(unsigned) {}
+	void	wait(void) {}
+	bool	bus_err(void) const { return false; }
+	void	reset_err(void) {}
+	void	clear(void) {}
+};
+
+bool	check_data(TSCOPE &scope, SIMBUS &sim, unsigned k) {
+	if (scope.load() != sim.m_mem.size()) {
+		printf("ERR: SCOPE %d READ %d WORDS, NOT %d\n", k, scope.load(),
+			(int)sim.m_mem.size());
+		return false;
+	}
+
+	for(unsigned i=0; i<sim.m_mem.size(); i++)
+		if (scope[i] != sim.m_mem[i]) {
+			printf("ERR: SCOPE %d WORD %d IS %08x, NOT %08x\n", k, i,
+				scope[i], sim.m_mem[i]);
+			return false;
+		}
+
+	return true;
+}
+
+int main(void) {
+	SIMBUS		sim0(8, 20), sim1(9, 100);
+	GROUPBUS	bus;
+	TSCOPE		scope0(&bus, 0), scope1(&bus, 8);
+	SCOPE_GROUP	group(&bus);
+
+	srand(7);
+	for(unsigned i=0; i<sim0.m_mem.size(); i++)
+		sim0.m_mem[i] = rand();
+	for(unsigned i=0; i<sim1.m_mem.size(); i++)
+		sim1.m_mem[i] = rand();
+
+	bus.m_scopes.push_back(&sim0);
+	bus.m_scopes.push_back(&sim1);
+	group.add(&scope0);
+	group.add(&scope1);
+
+	// The first scope has stopped, the second is still waiting
+	sim1.m_running = true;
+	for(int k=0; k<5; k++) {
+		if (group.poll() != 1) {
+			printf("ERR: POLL FOUND OTHER THAN ONE SCOPE STOPPED\n");
+			goto test_failure;
+		}
+	}
+
+	if ((sim0.m_nread != 0)||(sim1.m_nread != 0)) {
+		printf("ERR: POLLING READ THE DATA REGISTERS\n");
+		goto test_failure;
+	}
+
+	// Reading out should then read the first only, leaving the second
+	// waiting for its trigger
+	if (group.acquire(0)) {
+		printf("ERR: ACQUIRED A SCOPE THAT HASN\'T STOPPED\n");
+		goto test_failure;
+	}
+
+	if ((!group.done(0))||(group.done(1))) {
+		printf("ERR: SCOPE 0 %s READ, SCOPE 1 %s\n",
+			(group.done(0)) ? "WAS" : "WASN\'T",
+			(group.done(1)) ? "WAS" : "WASN\'T");
+		goto test_failure;
+	}
+
+	if ((!check_data(scope0, sim0, 0))||(sim1.m_nread != 0))
+		goto test_failure;
+
+	// Once the second stops, polling finds it, and it's read out as well
+	sim1.m_running = false;
+	if (!group.acquire(0)) {
+		printf("ERR: SCOPE 1 WASN\'T ACQUIRED ONCE STOPPED\n");
+		goto test_failure;
+	}
+
+	if (!check_data(scope1, sim1, 1))
+		goto test_failure;
+
+	// Nothing more may be read from the first scope's data register
+	if (sim0.m_nread != sim0.m_mem.size()) {
+		printf("ERR: %ld WORDS READ FROM SCOPE 0, NOT %d\n",
+			sim0.m_nread, (int)sim0.m_mem.size());
+		goto test_failure;
+	}
+
+	group.report(stdout);
+
+	printf("SUCCESS!!\n");
+	exit(0);
+test_failure:
+	printf("TEST FAILED\n");
+	exit(-1);
+}
@@ -0,0 +1,353 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	search_tb.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Checks the SEARCH engine against a naive search, one clock at a
+//		time, over random captures--both compressed and not.  Checked are
+//	the match_bits() kernels against match_bits_scalar(), SEARCH::find()
+//	for single patterns and for sequences, and SCANNER, scanning the same
+//	captures a random number of words at a time.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+
+#include "search.h"
+
+typedef	SEARCH::MATCH	MATCH;
+typedef	std::vector<MATCH>	MATCHES;
+
+// A random capture
+// {{{
+// Words are drawn from a small alphabet in bits 0-2 and 8-9, so that the
+// patterns below match often, with random bits elsewhere.  A compressed
+// capture has run words mixed in, of up to maxrun clocks, and its time
+// index is built alongside.  vals gets the value of every clock.
+struct	CAPTURE {
+	bool			m_compressed;
+	std::vector<uint32_t>	m_data, m_vals;
+	std::vector<uint64_t>	m_tindex;
+
+	void	generate(bool compressed, unsigned nwords, unsigned maxrun) {
+		uint32_t	last = 0;
+
+		m_compressed = compressed;
+		m_data.clear();
+		m_vals.clear();
+		m_tindex.clear();
+
+		for(unsigned k=0; k<nwords; k++) {
+			uint32_t	w = (rand() & 0x07) | ((rand() & 3) << 8);
+
+			if (rand() & 1)
+				w |= (rand() & 0x7fff) << 12;
+			if (!compressed) {
+				if (rand() & 1)
+					w |= 0x80000000;
+				m_vals.push_back(w);
+			} else if ((k > 0)&&(rand() % 3 == 0)) {
+				unsigned ln = rand() % maxrun;
+
+				w = 0x80000000 | ln;
+				m_tindex.push_back(m_vals.size());
+				for(unsigned j=0; j<=ln; j++)
+					m_vals.push_back(last);
+			} else {
+				m_tindex.push_back(m_vals.size());
+				m_vals.push_back(w);
+				last = w;
+			}
+			m_data.push_back(w);
+		}
+
+		if (compressed)
+			m_tindex.push_back(m_vals.size());
+	}
+
+	SEARCH	search(void) const {
+		return SEARCH(m_data.data(), m_data.size(), m_compressed,
+			(m_compressed) ? m_tindex.data() : NULL);
+	}
+};
+// }}}
+
+// A random pattern, over the same bits the captures use
+// {{{
+uint32_t	random_field(void) {
+	static const uint32_t	fields[] = { 0x001, 0x002, 0x004, 0x007,
+			0x100, 0x300, 0x301, 0x204, 0x3ff };
+
+	return fields[rand() % (sizeof(fields)/sizeof(fields[0]))];
+}
+
+SEARCH::TERM	random_term(void) {
+	SEARCH::TERM	t;
+
+	t.is(random_field(), rand());
+	if (rand() % 3 == 0)
+		t.was(random_field(), rand());
+	return t;
+}
+// }}}
+
+// The naive search
+// {{{
+// Mark every clock the term matches
+void	naive_match(const CAPTURE &cap, const SEARCH::TERM &t,
+		std::vector<bool> &hit) {
+	hit.assign(cap.m_vals.size(), false);
+	for(size_t c=0; c<cap.m_vals.size(); c++) {
+		if ((cap.m_vals[c] & t.m_mask) != t.m_value)
+			continue;
+		if ((t.m_pmask != 0)&&((c == 0)
+			||((cap.m_vals[c-1] & t.m_pmask) != t.m_pvalue)))
+			continue;
+		hit[c] = true;
+	}
+}
+
+// Turn marked clocks into maximal intervals
+void	intervals(const std::vector<bool> &hit, MATCHES &out) {
+	for(size_t c=0; c<hit.size(); c++) {
+		if (!hit[c])
+			continue;
+		if ((out.size() > 0)&&(out.back().m_clk + out.back().m_nclks == c))
+			out.back().m_nclks++;
+		else {
+			MATCH	m;
+
+			m.m_clk   = c;
+			m.m_nclks = 1;
+			out.push_back(m);
+		}
+	}
+}
+
+// Find a sequence: reach[s][c] is set if step s can complete on clock c.
+// Each interval of the last step's clocks is then reported from the latest
+// clock the first step could have matched at, working back one step at a
+// time, to the first clock of the interval.
+void	naive_sequence(const CAPTURE &cap,
+		const std::vector<SEARCH::STEP> &seq, MATCHES &out) {
+	const size_t	nclks = cap.m_vals.size();
+	std::vector<std::vector<bool> >	reach(seq.size());
+
+	naive_match(cap, seq[0].m_term, reach[0]);
+	for(size_t s=1; s<seq.size(); s++) {
+		std::vector<bool>	hit;
+		int64_t			latest = -1;
+
+		naive_match(cap, seq[s].m_term, hit);
+		reach[s].assign(nclks, false);
+		for(size_t c=0; c<nclks; c++) {
+			// The latest clock the step before completed, no
+			// later than m_min clocks ago
+			if (c >= seq[s].m_min) {
+				size_t	p = c - seq[s].m_min;
+
+				if (reach[s-1][p])
+					latest = p;
+			}
+			if ((hit[c])&&(latest >= 0)
+				&&(c - (uint64_t)latest <= seq[s].m_max))
+				reach[s][c] = true;
+		}
+	}
+
+	MATCHES	done;
+
+	intervals(reach.back(), done);
+	for(size_t k=0; k<done.size(); k++) {
+		uint64_t	clk = done[k].m_clk;
+
+		for(size_t s=seq.size()-1; s>0; s--) {
+			int64_t	p = (int64_t)clk - (int64_t)seq[s].m_min;
+
+			while(!reach[s-1][p])
+				p--;
+			clk = p;
+		}
+
+		MATCH	m;
+
+		m.m_clk   = clk;
+		m.m_nclks = done[k].m_clk - clk + 1;
+		out.push_back(m);
+	}
+}
+// }}}
+
+bool	same(const char *what, const MATCHES &got, const MATCHES &want) {
+	for(size_t k=0; (k<got.size())||(k<want.size()); k++) {
+		if ((k >= got.size())||(k >= want.size())
+				||(got[k].m_clk != want[k].m_clk)
+				||(got[k].m_nclks != want[k].m_nclks)) {
+			printf("ERR: %s MATCH %d ", what, (int)k);
+			if (k < got.size())
+				printf("IS %ld+%ld, ", (long)got[k].m_clk,
+					(long)got[k].m_nclks);
+			else
+				printf("IS MISSING, ");
+			if (k < want.size())
+				printf("NOT %ld+%ld\n", (long)want[k].m_clk,
+					(long)want[k].m_nclks);
+			else
+				printf("AND SHOULDN\'T BE THERE\n");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// match_bits() against match_bits_scalar()
+// {{{
+bool	check_kernels(void) {
+	std::vector<uint32_t>	data(300);
+
+	for(unsigned trial=0; trial<2000; trial++) {
+		unsigned	n = rand() % data.size(),
+				nb = (data.size() + 31) / 32;
+		uint32_t	mask = random_field() | ((rand()&1) ? 0x80000000:0),
+				value = rand() | ((rand()&1) ? 0x80000000:0),
+				pmask = random_field(), pvalue = rand();
+		bool		runs = (trial & 1), prev = (trial & 2);
+		std::vector<uint32_t>	m(nb, 0xdeadbeef), r(nb, 0xdeadbeef),
+					p(nb, 0xdeadbeef),
+					sm(nb, 0xdeadbeef), sr(nb, 0xdeadbeef),
+					sp(nb, 0xdeadbeef);
+
+		for(unsigned k=0; k<data.size(); k++)
+			data[k] = rand() ^ ((rand() & 1) ? 0x80000000 : 0);
+
+		match_bits(data.data(), n, mask, value, m.data(),
+			(runs) ? r.data() : NULL,
+			pmask, pvalue, (prev) ? p.data() : NULL);
+		match_bits_scalar(data.data(), n, mask, value, sm.data(),
+			(runs) ? sr.data() : NULL,
+			pmask, pvalue, (prev) ? sp.data() : NULL);
+
+		for(unsigned k=0; k<(n+31)/32; k++)
+			if ((m[k] != sm[k])||(r[k] != sr[k])||(p[k] != sp[k])) {
+				printf("ERR: MATCH_BITS DIFFERS IN WORD %d OF %d WORDS\n",
+					k, n);
+				return false;
+			}
+	}
+
+	return true;
+}
+// }}}
+
+int main(void) {
+	CAPTURE	cap;
+
+	srand(23);
+
+	if (!check_kernels())
+		goto test_failure;
+
+	for(int trial=0; trial<600; trial++) {
+		bool		compressed = (trial & 1);
+		unsigned	nwords = rand() % ((trial & 2) ? 3000 : 100);
+		MATCHES		got, want;
+
+		cap.generate(compressed, nwords, (trial & 4) ? 4 : 200);
+		SEARCH		search = cap.search();
+
+		// A single pattern
+		// {{{
+		SEARCH::TERM	term = random_term();
+		std::vector<bool>	hit;
+
+		naive_match(cap, term, hit);
+		intervals(hit, want);
+		search.find(term, got);
+		if (!same("FIND", got, want))
+			goto test_failure;
+		// }}}
+
+		// ... scanned a piece at a time, both reporting whole matches
+		// and only where they start
+		// {{{
+		for(int starts=0; starts<2; starts++) {
+			SEARCH::SCANNER	scanner(search, term, starts);
+			MATCHES		scanned, expect = want;
+			unsigned	n, step = 1 + rand() % 200;
+
+			if (starts)
+				for(size_t k=0; k<expect.size(); k++)
+					expect[k].m_nclks = 0;
+
+			while((n = scanner.scan(step, scanned)) > 0)
+				step = 1 + rand() % 200;
+			if (scanner.position() != nwords) {
+				printf("ERR: SCANNER STOPPED AT %d OF %d WORDS\n",
+					scanner.position(), nwords);
+				goto test_failure;
+			}
+			if (!same((starts) ? "SCANNER (STARTS)" : "SCANNER",
+					scanned, expect))
+				goto test_failure;
+		}
+		// }}}
+
+		// A sequence of two to four steps
+		// {{{
+		std::vector<SEARCH::STEP>	seq(2 + rand() % 3);
+
+		for(size_t s=0; s<seq.size(); s++) {
+			seq[s].m_term = random_term();
+			seq[s].m_min  = rand() % 4;
+			seq[s].m_max  = seq[s].m_min + rand() % 20;
+			if (rand() % 8 == 0)
+				seq[s].m_max = UINT64_MAX;
+		}
+
+		got.clear();
+		want.clear();
+		naive_sequence(cap, seq, want);
+		search.find(seq, got);
+		if (!same("SEQUENCE", got, want))
+			goto test_failure;
+		// }}}
+	}
+
+	printf("SUCCESS!!\n");
+	exit(0);
+test_failure:
+	printf("TEST FAILED\n");
+	exit(-1);
+}
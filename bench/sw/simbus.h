@@ -0,0 +1,229 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	simbus.h
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	A DEVBUS standing in for a wbscope, so the host software can be
+//		tested without any hardware.  The scope's memory is filled in by
+//	the test, and the scope is then stopped, primed and triggered, as it
+//	would be after a capture.  Reads of its data register walk through
+//	that memory, oldest value first, as the wbscope's would.  Writes to
+//	the data register seek, and answer a capabilities query, if the scope
+//	is set up with OPT_SEEK, and otherwise return to the beginning of the
+//	buffer.  A bus error may be injected after a given number of data
+//	words, to test how the software recovers.
+//
+//	MEMSIMBUS stands in for a memscope instead: a scope recording into a
+//	memory that the host can also read directly.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	SIMBUS_H
+#define	SIMBUS_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "devbus.h"
+
+class	SIMBUS : public DEVBUS {
+public:
+	std::vector<BUSW>	m_mem;
+	unsigned	m_lgmem, m_holdoff, m_raddr;
+	// Set if writes to the data register set the read address (OPT_SEEK),
+	// and m_query if a capabilities query has just been made
+	bool		m_seek, m_query;
+	// If m_err_after is nonzero, the read of that many'th data word
+	// fails, and the bus reports an error.  If m_throw is set, the
+	// error is thrown as a BUSERR.  Otherwise, the read returns and
+	// bus_err() is set.
+	unsigned long	m_err_after, m_nread;
+	bool		m_throw, m_err;
+	// The number of writes to the data register, and of readz() calls
+	unsigned long	m_ndatawr, m_nreadz;
+	// Set while the scope is still waiting on its trigger, rather than
+	// stopped
+	bool		m_running;
+
+	SIMBUS(unsigned lgmem, unsigned holdoff, bool seek = false)
+		: m_lgmem(lgmem), m_holdoff(holdoff), m_raddr(0),
+			m_seek(seek), m_query(false),
+			m_err_after(0), m_nread(0),
+			m_throw(false), m_err(false),
+			m_ndatawr(0), m_nreadz(0), m_running(false) {
+		m_mem.assign(1u<<lgmem, 0);
+	}
+
+	// The control word of a scope that has stopped, or that is primed
+	// and waiting on its trigger
+	BUSW	control(void) const {
+		return ((m_running) ? 0x10000000 : 0x70000000)
+			| ((m_raddr == 0) ? 0x02000000 : 0)
+			| (m_lgmem << 20) | m_holdoff;
+	}
+
+	void	kill(void) {}
+	void	close(void) {}
+
+	void	writeio(const BUSW a, const BUSW v) {
+		m_query = false;
+		if (a == 4)
+			m_ndatawr++;
+		if ((a == 0)||((a == 4)&&(!m_seek)))
+			m_raddr = 0;
+		else if ((a == 4)&&(v & 0x80000000))
+			m_query = true;
+		else if (a == 4)
+			m_raddr = v & (m_mem.size()-1);
+	}
+
+	BUSW	readio(const BUSW a) {
+		if ((a == 0)&&(m_query)) {
+			// The capabilities word: OPT_SEEK is set
+			m_query = false;
+			return 1;
+		} if (a == 0)
+			return control();
+		if (a != 4)
+			return 0;
+		m_nread++;
+		if ((m_err_after != 0)&&(m_nread == m_err_after)) {
+			if (m_throw)
+				throw BUSERR(a);
+			m_err = true;
+			return 0;
+		}
+
+		BUSW	v = m_mem[m_raddr];
+		m_raddr = (m_raddr + 1) & (m_mem.size()-1);
+		return v;
+	}
+
+	void	readi(const BUSW a, const int len, BUSW *buf) {
+		for(int i=0; i<len; i++)
+			buf[i] = readio(a+4*i);
+	}
+
+	void	readz(const BUSW a, const int len, BUSW *buf) {
+		m_nreadz++;
+		for(int i=0; i<len; i++)
+			buf[i] = readio(a);
+	}
+
+	void	writei(const BUSW a, const int len, const BUSW *buf) {
+		for(int i=0; i<len; i++)
+			writeio(a+4*i, buf[i]);
+	}
+
+	void	writez(const BUSW a, const int len, const BUSW *buf) {
+		for(int i=0; i<len; i++)
+			writeio(a, buf[i]);
+	}
+
+	bool	poll(void) { return false; }
+	void	usleep(unsigned) {}
+	void	wait(void) {}
+	bool	bus_err(void) const { return m_err; }
+	void	reset_err(void) { m_err = false; }
+	void	clear(void) {}
+};
+
+// A memscope.  The scope's memory, m_mem, also sits on the bus at m_membase,
+// and the capture wraps around it, starting at word m_oldest.  Writing to
+// the data register rewinds it to that oldest word, whose byte address can
+// then be read from ADDRLO (+8) and ADDRHI (+12).  Stopped is 3, not 7.
+class	MEMSIMBUS : public SIMBUS {
+public:
+	BUSW		m_membase;
+	unsigned	m_oldest;
+	// The number of direct readi()s of the memory, the most words read
+	// by any one of them, and whether any read past the memory's end
+	unsigned long	m_nburst;
+	int		m_maxburst;
+	bool		m_overrun;
+
+	MEMSIMBUS(unsigned lgmem, unsigned holdoff, BUSW membase,
+			unsigned oldest)
+		: SIMBUS(lgmem, holdoff), m_membase(membase),
+			m_oldest(oldest & ((1u<<lgmem)-1)),
+			m_nburst(0), m_maxburst(0), m_overrun(false) {
+		m_raddr = m_oldest;
+	}
+
+	// The word'th oldest word of the capture
+	BUSW	&capture(unsigned word) {
+		return m_mem[(m_oldest + word) & (m_mem.size()-1)];
+	}
+
+	void	writeio(const BUSW a, const BUSW /* v */) {
+		if (a == 4) {
+			m_ndatawr++;
+			m_raddr = m_oldest;
+		}
+	}
+
+	BUSW	readio(const BUSW a) {
+		if (a == 0)
+			return ((m_running) ? 0x10000000 : 0x30000000)
+				| (m_lgmem << 20) | m_holdoff;
+		if (a == 8)
+			return m_oldest << 2;
+		if (a != 4)
+			return 0;
+		m_nread++;
+
+		BUSW	v = m_mem[m_raddr];
+		m_raddr = (m_raddr + 1) & (m_mem.size()-1);
+		return v;
+	}
+
+	void	readi(const BUSW a, const int len, BUSW *buf) {
+		if (a < m_membase) {
+			SIMBUS::readi(a, len, buf);
+			return;
+		}
+
+		unsigned	addr = (a - m_membase) >> 2;
+
+		m_nburst++;
+		if (len > m_maxburst)
+			m_maxburst = len;
+		for(int i=0; i<len; i++, addr++) {
+			if (addr >= m_mem.size()) {
+				m_overrun = true;
+				buf[i] = 0;
+			} else
+				buf[i] = m_mem[addr];
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,214 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	tracecol_tb.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Checks TRACECOL::fill(), with every SIMD kernel this CPU has,
+//		against fill_scalar(), the plain C++ reference it must match.
+//	Every width and shift of trace is extracted from random words, over
+//	ranges of every length and alignment, and in pieces filled in any
+//	order.  The columns of a compressed capture, whose run words must
+//	carry the value of the data word before them, are then checked
+//	against the capture itself.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+#include "simbus.h"
+#include "scopecls.h"
+#include "tracecol.h"
+
+static const char	*simd_name[] = { "SCALAR", "SSE2", "AVX2" };
+
+class	TSCOPE : public SCOPE {
+public:
+	TSCOPE(DEVBUS *fpga) : SCOPE(fpga, 0, true) {}
+
+	virtual	void	define_traces(void) {
+		register_trace("flag",   1,  0);
+		register_trace("top",    1, 30);
+		register_trace("state",  5,  3);
+		register_trace("word",  12, 19);
+		register_trace("wide",  20,  8);
+		register_trace("all",   31,  0);
+	}
+
+	virtual	void	decode(DEVBUS::BUSW v) const {
+		printf("%08x", v);
+	}
+};
+
+// Every bit of storage of a column filled by a kernel should match the same
+// column filled by fill_scalar(), and every value from start on should match
+// the data
+bool	same(const TRACECOL &got, const TRACECOL &ref,
+		const std::vector<uint32_t> &data, unsigned start,
+		const char *what) {
+	if ((got.m_plane != ref.m_plane)||(got.m_u8 != ref.m_u8)
+			||(got.m_u16 != ref.m_u16)||(got.m_u32 != ref.m_u32)) {
+		printf("ERR: %s %d-BIT TRACE, SHIFTED BY %d, OF %d WORDS, DIFFERS\n",
+			what, got.m_nbits, got.m_nshift, got.m_len);
+		return false;
+	}
+
+	uint32_t	mask = (got.m_nbits >= 32) ? 0xffffffff
+				: ((1u << got.m_nbits)-1);
+	for(unsigned i=start; i<got.size(); i++)
+		if (got[i] != ((data[i] >> got.m_nshift) & mask)) {
+			printf("ERR: %s %d-BIT TRACE, SHIFTED BY %d: WORD %d IS %x, NOT %x\n",
+				what, got.m_nbits, got.m_nshift, i, got[i],
+				(data[i] >> got.m_nshift) & mask);
+			return false;
+		}
+
+	return true;
+}
+
+// Fill columns of every width and shift from len words, starting at start,
+// both with the given kernels and with fill_scalar(), and then again in
+// random pieces, filled in a random order
+bool	check_kernels(TRACECOL::SIMD simd, const std::vector<uint32_t> &data,
+		unsigned start, unsigned len) {
+	for(unsigned nbits=1; nbits<=32; nbits++)
+	for(unsigned nshift=0; nbits+nshift<=32; nshift++) {
+		TRACECOL	col, ref;
+
+		ref.setup(len, nbits, nshift);
+		ref.fill_scalar(data.data(), start, len);
+		col.setup(len, nbits, nshift);
+		col.fill_with(simd, data.data(), start, len);
+		if (!same(col, ref, data, start, simd_name[simd]))
+			return false;
+
+		// In pieces
+		std::vector<unsigned>	cuts;
+
+		cuts.push_back(start);
+		cuts.push_back(len);
+		for(int k=rand()%6; k>0; k--)
+			cuts.push_back(start + rand() % (len - start + 1));
+		std::sort(cuts.begin(), cuts.end());
+		std::random_shuffle(cuts.begin(), cuts.end()-1);
+
+		col.setup(len, nbits, nshift);
+		for(unsigned k=0; k+1<cuts.size(); k++) {
+			unsigned	end = len;
+
+			// The end of this piece is the next cut after it
+			for(unsigned j=0; j<cuts.size(); j++)
+				if ((cuts[j] > cuts[k])&&(cuts[j] < end))
+					end = cuts[j];
+			col.fill_with(simd, data.data(), cuts[k], end);
+		}
+		if (!same(col, ref, data, start, simd_name[simd]))
+			return false;
+	}
+
+	return true;
+}
+
+// Build the columns of a compressed capture through the SCOPE, and check each
+// against the capture.  The capture starts with a run, which repeats zero.
+bool	check_compressed(void) {
+	const unsigned	LGMEM = 11;
+	SIMBUS		bus(LGMEM, 100);
+	TSCOPE		scope(&bus);
+	std::vector<uint32_t>	eff(bus.m_mem.size());
+	uint32_t	last = 0;
+
+	for(unsigned k=0; k<bus.m_mem.size(); k++) {
+		if ((k == 0)||(rand() % 3 == 0))
+			bus.m_mem[k] = 0x80000000 | (rand() % 100);
+		else {
+			bus.m_mem[k] = rand() & 0x7fffffff;
+			last = bus.m_mem[k];
+		}
+		eff[k] = last;
+	}
+
+	scope.rawread();
+	for(unsigned t=0; t<scope.ntraces(); t++) {
+		const TRACECOL	&col = scope.column(t);
+		TRACECOL	ref;
+
+		if (col.size() != eff.size()) {
+			printf("ERR: COMPRESSED COLUMN %d HAS %d WORDS, NOT %d\n",
+				t, col.size(), (int)eff.size());
+			return false;
+		}
+
+		ref.setup(eff.size(), col.m_nbits, col.m_nshift);
+		ref.fill_scalar(eff.data(), 0, eff.size());
+		if (!same(col, ref, eff, 0, "COMPRESSED"))
+			return false;
+	}
+
+	return true;
+}
+
+int main(void) {
+	std::vector<uint32_t>	data(300);
+	TRACECOL::SIMD		best = TRACECOL::best_simd();
+
+	srand(8);
+	for(unsigned k=0; k<data.size(); k++)
+		data[k] = rand() ^ (rand() << 16);
+
+	printf("Checking the %s kernels, and those before them\n",
+		simd_name[best]);
+
+	for(int simd=TRACECOL::SIMD_NONE; simd<=best; simd++) {
+		// Every length up to 80 words, and a few longer ones, from
+		// every alignment within the first eight words
+		for(unsigned len=0; len<300; len += (len < 80) ? 1 : 37)
+		for(unsigned start=0; start<8; start++) {
+			if (start > len)
+				break;
+			if (!check_kernels((TRACECOL::SIMD)simd, data,
+					start, len))
+				goto test_failure;
+		}
+	}
+
+	if (!check_compressed())
+		goto test_failure;
+
+	printf("SUCCESS!!\n");
+	exit(0);
+test_failure:
+	printf("TEST FAILED\n");
+	exit(-1);
+}
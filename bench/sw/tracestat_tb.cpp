@@ -0,0 +1,230 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	tracestat_tb.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Checks TRACESTATS, and the AVX2 kernel it uses where the CPU
+//		has one, against a naive reference that expands every word into
+//	the clocks it stands for.  Captures are both uncompressed and
+//	compressed, including compressed captures that start with a run and
+//	that are full of full-length runs, and are counted both all at once
+//	and a piece at a time.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <vector>
+
+#include "tracestat.h"
+
+// The traces to check: nbits, and then nshift
+static const unsigned	traces[][2] = {
+	{ 1, 0 }, { 1, 30 }, { 3, 2 }, { 8, 0 }, { 9, 5 }, { 12, 19 },
+	{ 16, 8 }, { 20, 11 }, { 31, 0 }, { 32, 0 } };
+static const unsigned	NTRACES = sizeof(traces)/sizeof(traces[0]);
+
+// The statistics of one trace, found the slow way
+struct	REFSTAT {
+	uint64_t	m_clocks, m_changes, m_active;
+	uint32_t	m_min, m_max;
+	unsigned __int128	m_sum;
+	std::vector<uint64_t>	m_hist;
+};
+
+// Expand each word into the clocks it stands for: a data word is one clock,
+// and a run word repeats the value before it for (word&0x7fffffff)+1 clocks.
+// A run at the very start stands for one clock of zero.  Then count each
+// trace over those clocks.
+void	reference(const std::vector<uint32_t> &data, unsigned nwords,
+		bool compressed, unsigned nbits, unsigned nshift,
+		REFSTAT &r) {
+	uint32_t	mask = (nbits >= 32) ? 0xffffffff : ((1u << nbits)-1),
+			value = 0, last = 0;
+	unsigned	binshift = (nbits > 8) ? nbits - 8 : 0;
+
+	r.m_clocks = r.m_changes = r.m_active = 0;
+	r.m_min = 0xffffffff;
+	r.m_max = 0;
+	r.m_sum = 0;
+	r.m_hist.assign(1u << (nbits - binshift), 0);
+
+	for(unsigned i=0; i<nwords; i++) {
+		uint64_t	nclks = 1;
+
+		if ((compressed)&&(data[i] & 0x80000000)) {
+			if (i > 0)
+				nclks = (data[i] & 0x7fffffff) + 1;
+		} else
+			value = data[i];
+
+		uint32_t	v = (value >> nshift) & mask;
+
+		// Every clock after the first that differs from the one
+		// before it is a change.  Within a run, none do.
+		if ((r.m_clocks > 0)&&(v != last))
+			r.m_changes++;
+		last = v;
+
+		r.m_clocks += nclks;
+		if (v != 0)
+			r.m_active += nclks;
+		if (v < r.m_min)
+			r.m_min = v;
+		if (v > r.m_max)
+			r.m_max = v;
+		r.m_sum += (unsigned __int128)v * nclks;
+		r.m_hist[v >> binshift] += nclks;
+	}
+}
+
+bool	check(const char *what, const std::vector<uint32_t> &data,
+		bool compressed, bool pieces) {
+	TRACESTATS	stats;
+	unsigned	valid = 0;
+
+	for(unsigned k=0; k<NTRACES; k++) {
+		if ((compressed)&&(traces[k][0] + traces[k][1] > 31))
+			continue;
+		stats.add_trace(traces[k][0], traces[k][1]);
+	}
+	stats.setup(data.size(), compressed);
+
+	while(valid < data.size()) {
+		unsigned	n = data.size();
+
+		if (pieces)
+			n = valid + 1 + rand() % 1500;
+		stats.extend(data.data(), n);
+		valid = stats.valid();
+
+		for(unsigned t=0; t<stats.ntraces(); t++) {
+			const TRACESTATS::STAT	&st = stats.stat(t);
+			REFSTAT	r;
+			double	mean;
+
+			reference(data, valid, compressed, st.m_nbits,
+				st.m_nshift, r);
+			mean = (r.m_clocks > 0)
+				? (double)r.m_sum / (double)r.m_clocks : 0.0;
+
+			if ((st.m_clocks != r.m_clocks)
+					||(st.m_changes != r.m_changes)
+					||(st.m_active != r.m_active)
+					||(st.m_min != r.m_min)
+					||(st.m_max != r.m_max)
+					||(fabs(st.m_mean - mean)
+						> 1e-9 * (mean + 1.0))
+					||(st.m_hist != r.m_hist)) {
+				printf("ERR: %s, %d-BIT TRACE SHIFTED BY %d, AFTER %d WORDS:\n",
+					what, st.m_nbits, st.m_nshift, valid);
+				printf("\tCLOCKS  %12lu, NOT %12lu\n",
+					(unsigned long)st.m_clocks,
+					(unsigned long)r.m_clocks);
+				printf("\tCHANGES %12lu, NOT %12lu\n",
+					(unsigned long)st.m_changes,
+					(unsigned long)r.m_changes);
+				printf("\tACTIVE  %12lu, NOT %12lu\n",
+					(unsigned long)st.m_active,
+					(unsigned long)r.m_active);
+				printf("\tMIN     %12u, NOT %12u\n",
+					st.m_min, r.m_min);
+				printf("\tMAX     %12u, NOT %12u\n",
+					st.m_max, r.m_max);
+				printf("\tMEAN    %12.3f, NOT %12.3f\n",
+					st.m_mean, mean);
+				printf("\tHISTOGRAM %s\n",
+					(st.m_hist == r.m_hist) ? "MATCHES"
+					: "DIFFERS");
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+// A random word, either from anywhere or from just a few values
+uint32_t	random_word(bool few) {
+	if (few)
+		return (rand() % 5) * 0x11111111;
+	return rand() ^ (rand() << 16);
+}
+
+int main(void) {
+	std::vector<uint32_t>	data;
+
+	srand(24);
+
+	for(int trial=0; trial<40; trial++) {
+		unsigned	nwords = 1 + rand() % 5000;
+		bool		few = (trial & 1), pieces = (trial & 2);
+
+		// Uncompressed
+		data.resize(nwords);
+		for(unsigned i=0; i<nwords; i++)
+			data[i] = random_word(few);
+		if (!check("UNCOMPRESSED", data, false, pieces))
+			goto test_failure;
+
+		// Compressed, with runs of all lengths--sometimes starting
+		// with one
+		for(unsigned i=0; i<nwords; i++) {
+			if (rand() % 3 == 0)
+				data[i] = 0x80000000 | (rand() % 50);
+			else
+				data[i] = random_word(few) & 0x7fffffff;
+		}
+		if (trial & 4)
+			data[0] = 0x80000000 | rand();
+		if (!check("COMPRESSED", data, true, pieces))
+			goto test_failure;
+
+		// Compressed, with full-length runs between most words, and
+		// one at the start
+		for(unsigned i=0; i<nwords; i++) {
+			if ((i == 0)||(rand() % 4 != 0))
+				data[i] = 0xffffffff;
+			else
+				data[i] = random_word(few) & 0x7fffffff;
+		}
+		if (!check("FULL-LENGTH RUNS", data, true, pieces))
+			goto test_failure;
+	}
+
+	printf("SUCCESS!!\n");
+	exit(0);
+test_failure:
+	printf("TEST FAILED\n");
+	exit(-1);
+}
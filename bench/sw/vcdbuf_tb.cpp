@@ -0,0 +1,296 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	vcdbuf_tb.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Checks the buffered VCDBUF and OUTBUF formatters against the
+//		printf()s they replaced: binary values against
+//	SCOPE::write_binary_trace(FILE *,...), and timestamps, hex and decimal
+//	values against printf() itself.  Then checks that whole VCD files
+//	describe the same waveforms whether every value is written or only
+//	those that change, and that a VCD file formatted across several
+//	threads is the same as one formatted in one.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "simbus.h"
+#include "scopecls.h"
+#include "vcdbuf.h"
+
+class	TSCOPE : public SCOPE {
+public:
+	TSCOPE(DEVBUS *fpga, bool compressed = false)
+		: SCOPE(fpga, 0, compressed) {}
+
+	virtual	void	define_traces(void) {
+		register_trace("flag",  1,  0);
+		register_trace("state", 3,  1);
+		register_trace("byte",  8,  4);
+		register_trace("addr", 19, 12);
+	}
+
+	virtual	void	decode(DEVBUS::BUSW v) const {
+		printf("%08x", v);
+	}
+};
+
+// Everything written to fp, from start to finish
+std::string	contents(FILE *fp) {
+	std::string	s;
+	char		buf[4096];
+	size_t		n;
+
+	rewind(fp);
+	while((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+		s.append(buf, n);
+	return s;
+}
+
+bool	same(const char *what, const std::string &got,
+		const std::string &want) {
+	if (got == want)
+		return true;
+
+	size_t	k = 0;
+	while((k < got.size())&&(k < want.size())&&(got[k] == want[k]))
+		k++;
+	printf("ERR: %s DIFFERS AT CHARACTER %d\n\tIS   \"%s\"\n\tNOT  \"%s\"\n",
+		what, (int)k, got.substr(k, 40).c_str(),
+		want.substr(k, 40).c_str());
+	return false;
+}
+
+// The formatters, one value at a time
+// {{{
+bool	check_formatters(void) {
+	SIMBUS	bus(4, 0);
+	TSCOPE	scope(&bus);
+	FILE	*fp = tmpfile();
+	char	tmp[128];
+	bool	ok = true;
+
+	for(int trial=0; (ok)&&(trial<20000); trial++) {
+		unsigned	val = rand() ^ (rand() << 16);
+		int		nbits = 1 + (trial % 32);
+		char		key[4];
+		VCDBUF		out(NULL);
+		std::string	want;
+
+		// A VCD identifier, of one to three printable characters
+		key[0] = '!' + rand() % 94;
+		key[1] = (rand()&1) ? ('!' + rand() % 94) : '\0';
+		key[2] = (key[1]) ? ('!' + rand() % 94) : '\0';
+		key[3] = '\0';
+
+		// Binary values
+		fp = freopen(NULL, "w+", fp);
+		scope.write_binary_trace(fp, nbits, val, key);
+		fflush(fp);
+		out.binary(nbits, val, key);
+		want = contents(fp);
+
+		// Timestamps
+		uint64_t	t = ((uint64_t)rand() << 31 | rand())
+					>> (rand() % 62);
+		sprintf(tmp, "#%" PRIu64 "\n", t);
+		out.timestamp(t);
+		want += tmp;
+
+		// Hexadecimal, with from zero to eight digits
+		int	nd = rand() % 9;
+
+		val >>= (rand() % 32);
+		sprintf(tmp, "%0*x", nd, val);
+		out.hex(val, nd);
+		want += tmp;
+
+		// Decimal, positive and negative, in fields up to 24 wide
+		int64_t	v = ((int64_t)rand() << 32) ^ rand();
+		int	width = rand() % 25;
+
+		v >>= (rand() % 64);
+		if (trial == 1)
+			v = INT64_MIN;
+		else if (trial == 2)
+			v = 0;
+		sprintf(tmp, "%*" PRId64, width, v);
+		out.dec(v, width);
+		want += tmp;
+
+		ok = same("FORMATTED OUTPUT",
+			std::string(out.data(), out.size()), want);
+	}
+
+	fclose(fp);
+	return ok;
+}
+// }}}
+
+// Whole VCD files
+// {{{
+typedef	std::vector<std::pair<uint64_t, std::string> >	WAVE;
+
+// Turn the body of a VCD file into a waveform for each identifier: the times
+// its value changed, and what it changed to.  Values written again, without
+// change, are ignored.
+void	waveforms(const std::string &vcd, std::map<std::string, WAVE> &waves) {
+	size_t		pos = vcd.find("$enddefinitions");
+	uint64_t	now = 0;
+
+	pos = vcd.find('\n', pos) + 1;
+	while(pos < vcd.size()) {
+		size_t		eol = vcd.find('\n', pos);
+		std::string	line = vcd.substr(pos, eol - pos), key, value;
+
+		pos = eol + 1;
+		if (line.empty())
+			continue;
+		if (line[0] == '#') {
+			now = strtoull(line.c_str()+1, NULL, 10);
+			continue;
+		} else if (line[0] == 'b') {
+			size_t	sp = line.find(' ');
+
+			value = line.substr(1, sp-1);
+			key   = line.substr(sp+1);
+		} else if (line[0] == '$') {
+			continue;
+		} else {
+			value = line.substr(0, 1);
+			key   = line.substr(1);
+		}
+
+		WAVE	&w = waves[key];
+		if ((!w.empty())&&(w.back().second == value))
+			continue;
+		if ((!w.empty())&&(w.back().first == now))
+			w.back().second = value;
+		else
+			w.push_back(std::make_pair(now, value));
+	}
+}
+
+std::string	vcdfile(TSCOPE &scope, bool clockless, bool changes,
+		unsigned nthreads) {
+	FILE		*fp = tmpfile();
+	std::string	s;
+
+	scope.set_vcd_changes_only(changes);
+	scope.set_vcd_threads(nthreads);
+	scope.writevcd(fp, clockless);
+	fflush(fp);
+	s = contents(fp);
+	fclose(fp);
+	return s;
+}
+
+bool	check_vcd(bool compressed, bool clockless) {
+	const unsigned	LGMEM = 12;
+	SIMBUS		bus(LGMEM, 1000);
+	TSCOPE		scope(&bus, compressed);
+	uint32_t	w = rand() & 0x7fffffff;
+
+	// Random words, changing a bit or two at a time so that values stay
+	// the same for a while, with runs for the compressed scope
+	for(unsigned k=0; k<bus.m_mem.size(); k++) {
+		if (rand() & 1)
+			w ^= 1u << (rand() % 31);
+		if (rand() & 1)
+			w ^= 1u << (rand() % 31);
+		if ((compressed)&&(k > 0)&&(rand() % 4 == 0))
+			bus.m_mem[k] = 0x80000000 | (rand() % 40);
+		else
+			bus.m_mem[k] = w;
+	}
+
+	scope.rawread();
+
+	std::string	all = vcdfile(scope, clockless, false, 1),
+			changes = vcdfile(scope, clockless, true, 1);
+	std::map<std::string, WAVE>	aw, cw;
+	const char	*mode = (compressed) ? "COMPRESSED"
+				: (clockless) ? "CLOCKLESS" : "CLOCKED";
+
+	// Both should describe the same waveforms, with fewer values written
+	// when only changes are written
+	waveforms(all, aw);
+	waveforms(changes, cw);
+	if (aw != cw) {
+		printf("ERR: %s CHANGES-ONLY WAVEFORMS DIFFER\n", mode);
+		return false;
+	} else if (changes.size() >= all.size()) {
+		printf("ERR: %s CHANGES-ONLY VCD IS %d BYTES, NOT LESS THAN %d\n",
+			mode, (int)changes.size(), (int)all.size());
+		return false;
+	} else if (aw.size() < 4) {
+		printf("ERR: %s VCD HAS ONLY %d WAVEFORMS\n", mode,
+			(int)aw.size());
+		return false;
+	}
+
+	// Formatting across threads should give the same file
+	if (!same("MULTI-THREADED VCD", vcdfile(scope, clockless, false, 4), all))
+		return false;
+	if (!same("MULTI-THREADED CHANGES-ONLY VCD",
+			vcdfile(scope, clockless, true, 3), changes))
+		return false;
+
+	return true;
+}
+// }}}
+
+int main(void) {
+	srand(3);
+
+	if (!check_formatters())
+		goto test_failure;
+	if (!check_vcd(false, false))
+		goto test_failure;
+	if (!check_vcd(false, true))
+		goto test_failure;
+	if (!check_vcd(true, false))
+		goto test_failure;
+
+	printf("SUCCESS!!\n");
+	exit(0);
+test_failure:
+	printf("TEST FAILED\n");
+	exit(-1);
+}
@@ -0,0 +1,374 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	vcdmerge_tb.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Checks VCDMERGE, merging the captures of several scopes into one
+//	VCD file.  Two scopes run on the same clock, and trigger at the same
+//	time, so every one of their samples falls at the same time as one of
+//	the other's.  A third, compressed, scope runs at half that rate.  The
+//	merged file must write each time once, in order, give every signal of
+//	every scope its own identifier, and describe each scope's waveforms
+//	exactly as its own data does.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "simbus.h"
+#include "scopecls.h"
+#include "vcdmerge.h"
+
+class	TSCOPE : public SCOPE {
+public:
+	TSCOPE(DEVBUS *fpga, bool compressed = false)
+		: SCOPE(fpga, 0, compressed) {}
+
+	virtual	void	define_traces(void) {
+		register_trace("flag",  1,  0);
+		register_trace("state", 3,  1);
+		register_trace("byte",  8, 20);
+	}
+
+	virtual	void	decode(DEVBUS::BUSW v) const {
+		printf("%08x", v);
+	}
+};
+
+typedef	std::vector<std::pair<uint64_t, std::string> >	WAVE;
+
+// A signal declared in the merged file: the scope it belongs to, its name,
+// and every value written to it, in order
+class	SIGNAL {
+public:
+	std::string	m_scope, m_name;
+	WAVE		m_wave;
+};
+
+// Everything written to fp, from start to finish
+std::string	contents(FILE *fp) {
+	std::string	s;
+	char		buf[4096];
+	size_t		n;
+
+	rewind(fp);
+	while((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+		s.append(buf, n);
+	return s;
+}
+
+// Read the merged file back: its signal declarations, and then the values
+// written to each.  Fails if an identifier is declared twice, if a value is
+// written to one that isn't declared, or if a time is written twice or out
+// of order.  The identifiers are returned in the order they were declared.
+bool	parse(const std::string &vcd, std::map<std::string, SIGNAL> &sigs,
+		std::vector<std::string> &order) {
+	size_t		pos = 0;
+	uint64_t	now = 0;
+	bool		body = false, timed = false;
+	std::string	scope;
+
+	while(pos < vcd.size()) {
+		size_t		eol = vcd.find('\n', pos);
+		std::string	line = vcd.substr(pos, eol - pos), key, value;
+		char		name[64], id[8];
+		int		nbits;
+
+		pos = eol + 1;
+		while((!line.empty())&&(line[0] == ' '))
+			line.erase(0, 1);
+		if (line.empty())
+			continue;
+
+		if (!body) {
+			if (1 == sscanf(line.c_str(), "$scope module %63s", name))
+				scope = name;
+			else if (3 == sscanf(line.c_str(),
+					"$var wire %d %7s %63[^[ ]",
+					&nbits, id, name)) {
+				if (sigs.count(id) != 0) {
+					printf("ERR: IDENTIFIER %s DECLARED "
+						"TWICE\n", id);
+					return false;
+				}
+				sigs[id].m_scope = scope;
+				sigs[id].m_name  = name;
+				order.push_back(id);
+			} else if (0 == line.compare(0, 15, "$enddefinitions"))
+				body = true;
+			continue;
+		}
+
+		if (line[0] == '#') {
+			uint64_t t = strtoull(line.c_str()+1, NULL, 10);
+			if ((timed)&&(t <= now)) {
+				printf("ERR: TIME #%lu WRITTEN AFTER #%lu\n",
+					(unsigned long)t, (unsigned long)now);
+				return false;
+			}
+			now = t;
+			timed = true;
+			continue;
+		} else if (line[0] == 'b') {
+			size_t	sp = line.find(' ');
+
+			value = line.substr(1, sp-1);
+			key   = line.substr(sp+1);
+		} else {
+			value = line.substr(0, 1);
+			key   = line.substr(1);
+		}
+
+		if (sigs.count(key) == 0) {
+			printf("ERR: VALUE WRITTEN TO UNDECLARED SIGNAL %s\n",
+				key.c_str());
+			return false;
+		}
+		sigs[key].m_wave.push_back(std::make_pair(now, value));
+	}
+
+	return true;
+}
+
+std::string	binary(int nbits, unsigned v) {
+	std::string	s;
+
+	for(int i=nbits-1; i>=0; i--)
+		s += (char)('0' + ((v >> i)&1));
+	return s;
+}
+
+// What the merged file should hold for one scope, in clocks: every value of
+// every signal, written when the scope starts and then whenever it changes.
+// Clocks are counted naively, word by word.
+void	expected(TSCOPE &scope, std::map<std::string, WAVE> &want) {
+	const int	nbits = (scope.compressed()) ? 31 : 32;
+	int64_t		trigger = scope.trigger_clock();
+	uint64_t	clk = 0, first = 0;
+	bool		started = false;
+	unsigned	last = 0;
+
+	for(unsigned i=0; i<scope.load(); i++) {
+		unsigned	w = scope[i];
+
+		if ((scope.compressed())&&(w & 0x80000000)) {
+			// A run word, or a single clock if it comes first
+			clk += (i == 0) ? 1 : (w & 0x7fffffff) + 1;
+			continue;
+		}
+
+		w &= (nbits < 32) ? 0x7fffffff : 0xffffffff;
+		if (!started) {
+			first = clk;
+			started = true;
+		}
+
+		if ((clk == first)||(w != last)) {
+			want["_raw_data"].push_back(
+				std::make_pair(clk, binary(nbits, w)));
+			for(unsigned k=0; k<scope.ntraces(); k++) {
+				const TRACEINFO	*info = scope.trace(k);
+				unsigned	v, p;
+
+				v = (w >> info->m_nshift) & info->m_mask;
+				p = (last >> info->m_nshift) & info->m_mask;
+				if ((clk == first)||(v != p))
+					want[info->m_name].push_back(
+						std::make_pair(clk,
+							binary(info->m_nbits, v)));
+			}
+		}
+		last = w;
+		clk++;
+	}
+
+	if ((uint64_t)trigger > first)
+		want["_trigger"].push_back(std::make_pair(first, "0"));
+	want["_trigger"].push_back(std::make_pair(trigger, "1"));
+	want["_trigger"].push_back(std::make_pair(trigger+1, "0"));
+}
+
+int main(void) {
+	const unsigned	NSCOPES = 3;
+	SIMBUS		sim0(9, 100), sim1(8, 30), sim2(9, 200);
+	TSCOPE		scope0(&sim0), scope1(&sim1), scope2(&sim2, true);
+	TSCOPE		*scopes[NSCOPES] = { &scope0, &scope1, &scope2 };
+	const char	*names[NSCOPES] = { "first", "second", "slow" };
+	// Clock periods, in the 10ns units the merge should choose
+	const uint64_t	period[NSCOPES] = { 1, 1, 2 };
+	VCDMERGE	merge;
+	FILE		*fp = tmpfile();
+	std::string	vcd;
+	std::map<std::string, SIGNAL>	sigs;
+	std::vector<std::string>	order;
+	uint64_t	timezero = 0;
+	unsigned	nsigs = 0;
+
+	srand(11);
+	// Slowly changing data, so that only some traces change at a time
+	for(unsigned i=0; i<sim0.m_mem.size(); i++)
+		sim0.m_mem[i] = (i/3) * 0x00100003;
+	for(unsigned i=0; i<sim1.m_mem.size(); i++)
+		sim1.m_mem[i] = (rand() % 4 == 0) ? rand()
+				: ((i > 0) ? sim1.m_mem[i-1] : 0);
+	for(unsigned i=0; i<sim2.m_mem.size(); i++)
+		sim2.m_mem[i] = ((i > 0)&&(rand() % 4 == 0))
+				? (0x80000000 | (rand() % 5))
+				: (rand() & 0x7fffffff);
+
+	scope0.set_clkfreq_hz(100000000);
+	scope1.set_clkfreq_hz(100000000);
+	scope2.set_clkfreq_hz( 50000000);
+	for(unsigned s=0; s<NSCOPES; s++)
+		merge.add(scopes[s], names[s]);
+
+	merge.writevcd(fp);
+	fflush(fp);
+	vcd = contents(fp);
+	fclose(fp);
+
+	if (vcd.find("$timescale 10ns $end") == std::string::npos) {
+		printf("ERR: THE MERGE DIDN\'T CHOOSE A 10ns TIMESCALE\n");
+		goto test_failure;
+	}
+
+	if (!parse(vcd, sigs, order))
+		goto test_failure;
+
+	// Every scope's signals, each with its own identifier, numbered in
+	// the order the scopes were added: each scope's trigger, its raw
+	// data, and then its traces
+	for(unsigned s=0; s<NSCOPES; s++)
+		nsigs += 2 + scopes[s]->ntraces();
+	if (sigs.size() != nsigs) {
+		printf("ERR: %d SIGNALS DECLARED, NOT %d\n",
+			(int)sigs.size(), nsigs);
+		goto test_failure;
+	}
+
+	for(unsigned s=0, id=0; s<NSCOPES; s++) {
+		for(unsigned k=0; k<2+scopes[s]->ntraces(); k++, id++) {
+			const SIGNAL	&sg = sigs[order[id]];
+			const char	*name = (k == 0) ? "_trigger"
+					: (k == 1) ? "_raw_data"
+					: scopes[s]->trace(k-2)->m_name;
+			char		key[8];
+
+			SCOPE::vcd_identifier(id, key);
+			if ((order[id] != key)||(sg.m_scope != names[s])
+					||(sg.m_name != name)) {
+				printf("ERR: SIGNAL %d IS %s.%s, %s, NOT "
+					"%s.%s, %s\n", id,
+					sg.m_scope.c_str(), sg.m_name.c_str(),
+					order[id].c_str(), names[s], name, key);
+				goto test_failure;
+			}
+		}
+	}
+
+	// Every trigger should fall at the same time
+	for(std::map<std::string, SIGNAL>::iterator it = sigs.begin();
+			it != sigs.end(); it++) {
+		const SIGNAL	&sg = it->second;
+
+		if (sg.m_name != "_trigger")
+			continue;
+		for(unsigned k=0; k<sg.m_wave.size(); k++) {
+			if (sg.m_wave[k].second != "1")
+				continue;
+			if ((timezero != 0)&&(sg.m_wave[k].first != timezero)) {
+				printf("ERR: %s TRIGGERED AT #%lu, NOT #%lu\n",
+					sg.m_scope.c_str(),
+					(unsigned long)sg.m_wave[k].first,
+					(unsigned long)timezero);
+				goto test_failure;
+			}
+			timezero = sg.m_wave[k].first;
+		}
+	}
+
+	// Each scope's waveforms, placed about the trigger
+	for(unsigned s=0; s<NSCOPES; s++) {
+		std::map<std::string, WAVE>	want;
+		int64_t	trigger = scopes[s]->trigger_clock();
+
+		expected(*scopes[s], want);
+		for(std::map<std::string, SIGNAL>::iterator it = sigs.begin();
+				it != sigs.end(); it++) {
+			const SIGNAL	&sg = it->second;
+
+			if (sg.m_scope != names[s])
+				continue;
+
+			WAVE	&w = want[sg.m_name];
+			for(unsigned k=0; k<w.size(); k++)
+				w[k].first = timezero
+					+ (w[k].first - trigger) * period[s];
+
+			if (sg.m_wave != w) {
+				unsigned k = 0;
+				while((k < w.size())&&(k < sg.m_wave.size())
+						&&(w[k] == sg.m_wave[k]))
+					k++;
+				printf("ERR: %s.%s DIFFERS AT CHANGE %d\n",
+					names[s], sg.m_name.c_str(), k);
+				if (k < sg.m_wave.size())
+					printf("\tIS   #%lu %s\n",
+					(unsigned long)sg.m_wave[k].first,
+					sg.m_wave[k].second.c_str());
+				if (k < w.size())
+					printf("\tNOT  #%lu %s\n",
+					(unsigned long)w[k].first,
+					w[k].second.c_str());
+				goto test_failure;
+			}
+			want.erase(sg.m_name);
+		}
+
+		if (!want.empty()) {
+			printf("ERR: %s.%s NOT DECLARED\n", names[s],
+				want.begin()->first.c_str());
+			goto test_failure;
+		}
+	}
+
+	printf("SUCCESS!!\n");
+	exit(0);
+test_failure:
+	printf("TEST FAILED\n");
+	exit(-1);
+}
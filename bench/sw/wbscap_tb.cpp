@@ -0,0 +1,190 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	wbscap_tb.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Saves a capture from a (simulated) scope with write_capture(), and
+//		reads it back with open_capture(), checking that everything--the
+//	data, the holdoff, and the control word the scope stopped with--makes
+//	it through the round trip.  Then checks that a file whose traces don't
+//	fit within a 32-bit word is refused.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+
+#include "simbus.h"
+#include "scopecls.h"
+#include "wbscap.h"
+
+class	TSCOPE : public SCOPE {
+public:
+	TSCOPE(DEVBUS *fpga) : SCOPE(fpga, 0) {}
+
+	virtual	void	define_traces(void) {
+		register_trace("lo", 16,  0);
+		register_trace("hi", 16, 16);
+	}
+
+	virtual	void	decode(DEVBUS::BUSW v) const {
+		printf("%08x", v);
+	}
+};
+
+// Copy the capture file src to dst, changing its last trace to nbits wide
+// shifted by nshift, and return whether open_capture() accepts the copy
+bool	opens_with_trace(const char *src, const char *dst,
+		uint32_t nbits, uint32_t nshift) {
+	std::vector<char>	buf;
+	FILE		*fp;
+	TSCOPE		scope(NULL);
+	WBSCAP_HEADER	*hdr;
+	WBSCAP_TRACE	*tr;
+	char		tmp[4096];
+	size_t		n;
+
+	if (NULL == (fp = fopen(src, "rb")))
+		return false;
+	while((n = fread(tmp, 1, sizeof(tmp), fp)) > 0)
+		buf.insert(buf.end(), tmp, tmp+n);
+	fclose(fp);
+
+	hdr = (WBSCAP_HEADER *)buf.data();
+	tr  = (WBSCAP_TRACE *)(buf.data() + hdr->m_trace_offset);
+	tr[hdr->m_ntraces-1].m_nbits  = nbits;
+	tr[hdr->m_ntraces-1].m_nshift = nshift;
+
+	if (NULL == (fp = fopen(dst, "wb")))
+		return false;
+	fwrite(buf.data(), 1, buf.size(), fp);
+	fclose(fp);
+
+	return scope.open_capture(dst);
+}
+
+int main(void) {
+	const unsigned	LGMEM = 10, HOLDOFF = 0x123;
+	const char	*fname = "wbscap_tb.wbscap",
+			*bad = "wbscap_tb_bad.wbscap";
+	// Trace widths and shifts that don't fit in a word
+	const uint32_t	badtraces[][2] = { { 0, 0 }, { 33, 0 }, { 16, 17 },
+				{ 1, 32 }, { 2, 0xffffffff } };
+	SIMBUS		bus(LGMEM, HOLDOFF);
+	TSCOPE		*scope = new TSCOPE(&bus), *copy = new TSCOPE(NULL);
+	DEVBUS::BUSW	ctrl;
+
+	srand(15);
+	for(unsigned k=0; k<bus.m_mem.size(); k++)
+		bus.m_mem[k] = rand();
+	ctrl = bus.control();
+
+	// The scope is checked with ready(), as a capture program would,
+	// rather than scoplen()--so it's ready() that must keep the
+	// control word
+	if (!scope->ready()) {
+		printf("ERR: SCOPE ISN\'T READY\n");
+		goto test_failure;
+	}
+
+	if (!scope->write_capture(fname)) {
+		printf("ERR: WRITE_CAPTURE FAILED\n");
+		goto test_failure;
+	}
+
+	if (!copy->open_capture(fname)) {
+		printf("ERR: OPEN_CAPTURE FAILED\n");
+		goto test_failure;
+	}
+
+	if (copy->control() != ctrl) {
+		printf("ERR: CONTROL WORD %08x, NOT %08x\n",
+			copy->control(), ctrl);
+		goto test_failure;
+	}
+
+	if (copy->scoplen() != bus.m_mem.size()) {
+		printf("ERR: LENGTH %d, NOT %d\n", copy->scoplen(),
+			(int)bus.m_mem.size());
+		goto test_failure;
+	}
+
+	if (copy->trigger_clock() != scope->trigger_clock()) {
+		printf("ERR: TRIGGER AT %ld, NOT %ld\n",
+			(long)copy->trigger_clock(),
+			(long)scope->trigger_clock());
+		goto test_failure;
+	}
+
+	for(unsigned k=0; k<bus.m_mem.size(); k++)
+		if ((*copy)[k] != bus.m_mem[k]) {
+			printf("ERR: WORD %d IS %08x, NOT %08x\n", k,
+				(*copy)[k], bus.m_mem[k]);
+			goto test_failure;
+		}
+
+	if (copy->ntraces() != 2) {
+		printf("ERR: %d TRACES, NOT 2\n", copy->ntraces());
+		goto test_failure;
+	}
+
+	// Traces filling the word, up to its top bit, are fine
+	if ((!opens_with_trace(fname, bad, 32, 0))
+			||(!opens_with_trace(fname, bad, 1, 31))) {
+		printf("ERR: A TRACE WITHIN THE WORD WAS REFUSED\n");
+		goto test_failure;
+	}
+
+	for(unsigned k=0; k<sizeof(badtraces)/sizeof(badtraces[0]); k++)
+		if (opens_with_trace(fname, bad, badtraces[k][0],
+				badtraces[k][1])) {
+			printf("ERR: A %u-BIT TRACE SHIFTED BY %u WAS "
+				"ACCEPTED\n", badtraces[k][0],
+				badtraces[k][1]);
+			goto test_failure;
+		}
+
+	delete copy;
+	delete scope;
+	unlink(fname);
+	unlink(bad);
+	printf("SUCCESS!!\n");
+	exit(0);
+test_failure:
+	delete copy;
+	delete scope;
+	unlink(fname);
+	unlink(bad);
+	printf("TEST FAILED\n");
+	exit(-1);
+}
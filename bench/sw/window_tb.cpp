@@ -0,0 +1,159 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	window_tb.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Reads only the part of a (simulated) scope's buffer around the
+//		trigger with read_window(), both from a scope that can seek and
+//	from one that can't, and checks that every word of the window is
+//	then found through SCOPE::operator[]--even though the window isn't a
+//	power of two in length--and again once the window has been saved to
+//	a capture file and read back.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "simbus.h"
+#include "scopecls.h"
+
+class	TSCOPE : public SCOPE {
+public:
+	TSCOPE(DEVBUS *fpga) : SCOPE(fpga, 0) {}
+
+	virtual	void	define_traces(void) {
+		register_trace("data", 32, 0);
+	}
+
+	virtual	void	decode(DEVBUS::BUSW v) const {
+		printf("%08x", v);
+	}
+};
+
+// Read a window of before+after+1 words around the trigger, and check it
+// word by word against the scope's memory
+bool	check_window(bool seek, unsigned before, unsigned after) {
+	const unsigned	LGMEM = 10, HOLDOFF = 200;
+	SIMBUS		bus(LGMEM, HOLDOFF, seek);
+	TSCOPE		scope(&bus);
+	unsigned	trig, start, nw;
+
+	for(unsigned k=0; k<bus.m_mem.size(); k++)
+		bus.m_mem[k] = rand();
+
+	trig  = (1u<<LGMEM) - HOLDOFF - 1;
+	start = trig - before;
+	nw = scope.read_window(before, after);
+	if (nw != before + after + 1) {
+		printf("ERR: WINDOW OF %d WORDS, NOT %d\n", nw,
+			before+after+1);
+		return false;
+	}
+
+	if (scope.seekable() != seek) {
+		printf("ERR: SCOPE %s SEEK, BUT SEEKABLE() SAYS OTHERWISE\n",
+			(seek) ? "CAN":"CAN'T");
+		return false;
+	}
+
+	if (scope.scoplen() != nw) {
+		printf("ERR: SCOPLEN IS %d, NOT %d\n", scope.scoplen(), nw);
+		return false;
+	}
+
+	if (scope.trigger_clock() != (int64_t)before) {
+		printf("ERR: TRIGGER AT %ld, NOT %d\n",
+			(long)scope.trigger_clock(), before);
+		return false;
+	}
+
+	for(unsigned k=0; k<nw; k++) {
+		if (scope[k] != bus.m_mem[start+k]) {
+			printf("ERR: %s WORD %d IS %08x, NOT %08x\n",
+				(seek) ? "SEEK":"NO-SEEK",
+				k, scope[k], bus.m_mem[start+k]);
+			return false;
+		}
+
+		// Addresses past the end wrap around to the beginning
+		if (scope[k+nw] != scope[k]) {
+			printf("ERR: WORD %d DOESN\'T WRAP TO WORD %d\n",
+				k+nw, k);
+			return false;
+		}
+	}
+
+	// The window should come back the same from a capture file
+	const char	*fname = "window_tb.wbscap";
+	TSCOPE		copy(NULL);
+	bool		ok = true;
+
+	if ((!scope.write_capture(fname))||(!copy.open_capture(fname))) {
+		printf("ERR: CAPTURE FILE ROUND TRIP FAILED\n");
+		ok = false;
+	} else if (copy.scoplen() != nw) {
+		printf("ERR: CAPTURE FILE HOLDS %d WORDS, NOT %d\n",
+			copy.scoplen(), nw);
+		ok = false;
+	} else for(unsigned k=0; k<nw; k++)
+		if (copy[k] != scope[k]) {
+			printf("ERR: CAPTURE FILE WORD %d IS %08x, NOT %08x\n",
+				k, copy[k], scope[k]);
+			ok = false;
+			break;
+		}
+
+	unlink(fname);
+	return ok;
+}
+
+int main(void) {
+	srand(18);
+
+	// Windows of 100 and 37 words, and then one of 64 words--a power of
+	// two--to check that case still works
+	for(int seek=0; seek<2; seek++) {
+		if (!check_window(seek, 37, 62))
+			goto test_failure;
+		if (!check_window(seek, 0, 36))
+			goto test_failure;
+		if (!check_window(seek, 32, 31))
+			goto test_failure;
+	}
+
+	printf("SUCCESS!!\n");
+	exit(0);
+test_failure:
+	printf("TEST FAILED\n");
+	exit(-1);
+}
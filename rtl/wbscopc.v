@@ -77,7 +77,13 @@ module wbscopc #(
 		parameter [(HOLDOFFBITS-1):0]	DEFAULT_HOLDOFF
 						= ((1<<(LGMEM-1))-4),
 		parameter			STEP_BITS=BUSW-1,
-		parameter [(STEP_BITS-1):0]	MAX_STEP= {(STEP_BITS){1'b1}}
+		parameter [(STEP_BITS-1):0]	MAX_STEP= {(STEP_BITS){1'b1}},
+		//
+		// OPT_SEEK allows the read address to be set by writing to
+		// the data register, and the scope's capabilities to be
+		// queried, as in the wbscope.  It's off by default, in which
+		// case writes to the data register reset the address.
+		parameter [0:0]			OPT_SEEK = 1'b0
 		// }}}
 	) (
 		// {{{
@@ -105,10 +111,13 @@ module wbscopc #(
 	// {{{
 	// Pseudo bus signals
 	// {{{
-	wire		write_stb, read_from_data, write_to_control;
+	wire		write_stb, read_from_data, write_to_control,
+			write_to_data;
 	reg	[31:0]	o_bus_data;
 	wire		bus_clock;
 	reg		read_address;
+	reg		br_read_control, br_query;
+	localparam [31:0] CAPABILITIES = { 31'h0, OPT_SEEK };
 	wire [BUSW-1:0]	i_bus_data;
 	// }}}
 
@@ -168,6 +177,7 @@ module wbscopc #(
 	assign	read_from_data=i_wb_stb && !i_wb_we && i_wb_addr && (&i_wb_sel);
 	assign	write_stb = (i_wb_stb)&&(i_wb_we);
 	assign	write_to_control = write_stb && !i_wb_addr && (&i_wb_sel);
+	assign	write_to_data    = write_stb &&  i_wb_addr && (&i_wb_sel);
 
 	always @(posedge bus_clock)
 		read_address <= i_wb_addr;
@@ -577,6 +587,13 @@ module wbscopc #(
 	begin
 		if ((bw_reset_request)||(write_to_control))
 			raddr <= 0;
+		else if ((!OPT_SEEK)&&(write_to_data))
+			// Return to the beginning of the buffer
+			raddr <= 0;
+		else if ((write_to_data)&&(!i_bus_data[31]))
+			// Seek: set the read address, relative to the oldest
+			// value in the buffer
+			raddr <= i_bus_data[(LGMEM-1):0];
 		else if ((read_from_data)&&(bw_stopped))
 			raddr <= raddr + 1'b1; // Data read, when stopped
 
@@ -587,7 +604,11 @@ module wbscopc #(
 	assign	o_wb_ack = br_wb_ack;
 
 	always @(posedge bus_clock)
-	if (read_from_data)
+	if ((!OPT_SEEK)&&(write_to_data))
+		this_addr <= waddr;
+	else if ((write_to_data)&&(!i_bus_data[31]))
+		this_addr <= i_bus_data[(LGMEM-1):0] + waddr;
+	else if (read_from_data)
 		this_addr <= raddr + waddr + 1'b1;
 	else
 		this_addr <= raddr + waddr;
@@ -606,11 +627,33 @@ module wbscopc #(
 
 	assign		bw_lgmem = LGMEM;
 
+	// Capabilities query
+	// {{{
+	// As with the wbscope, a write of bit 31 to the data register asks
+	// for the CAPABILITIES word, which is then returned by the next
+	// control register read in place of the control word.  Any other
+	// write cancels the query.
+	initial	br_read_control = 1'b0;
+	always @(posedge bus_clock)
+		br_read_control <= (i_wb_stb)&&(!i_wb_we)&&(!i_wb_addr);
+
+	initial	br_query = 1'b0;
+	always @(posedge bus_clock)
+	if (!OPT_SEEK)
+		br_query <= 1'b0;
+	else if (write_stb)
+		br_query <= (write_to_data)&&(i_bus_data[31]);
+	else if (br_read_control)
+		br_query <= 1'b0;
+	// }}}
+
 	// Bus read
 	// {{{
 	always @(posedge bus_clock)
 	begin
-		if (!read_address) // Control register read
+		if ((!read_address)&&(br_query))
+			o_bus_data <= CAPABILITIES;
+		else if (!read_address) // Control register read
 			o_bus_data <= { bw_reset_request,
 					bw_stopped,
 					bw_triggered,
@@ -30,6 +30,16 @@
 //		8. -- one value per i_rd&i_data_clk
 //		9. Writes to the data register reset the address to the
 //			beginning of the buffer
+//		10. If OPT_SEEK is set, writes to the data register set the
+//			address instead, relative to the oldest value, so
+//			the CPU may read just the part of the buffer it wants.
+//			A write with bit 31 set leaves the address alone, and
+//			asks the scope what it can do instead: the next read
+//			of the control register returns a capabilities word.
+//			Its LGMEM field (bits 24:20) is zero, as no control
+//			word's ever is, and its bit 0 is set if the scope
+//			can seek.  Without OPT_SEEK, the control word is read
+//			as usual, so a CPU can ask any scope.
 //
 //	Although the data width DW is parameterized, it is not very changable,
 //	since the width is tied to the width of the data bus, as is the
@@ -90,7 +100,13 @@ module wbscope #(
 		parameter			BUSW = 32,
 		parameter [0:0]			SYNCHRONOUS=1,
 		parameter		 	HOLDOFFBITS = 20,
-		parameter [(HOLDOFFBITS-1):0]	DEFAULT_HOLDOFF = ((1<<(LGMEM-1))-4)
+		parameter [(HOLDOFFBITS-1):0]	DEFAULT_HOLDOFF = ((1<<(LGMEM-1))-4),
+		//
+		// OPT_SEEK allows the read address to be set by writing to
+		// the data register, so that a host may read only that part
+		// of the buffer it's interested in.  It's off by default, in
+		// which case writes to the data register reset the address.
+		parameter [0:0]			OPT_SEEK = 1'b0
 		// }}}
 	) (
 		// {{{
@@ -119,7 +135,7 @@ module wbscope #(
 	wire			bus_clock;
 	wire			read_from_data;
 	wire			write_stb;
-	wire			write_to_control;
+	wire			write_to_control, write_to_data;
 	reg			read_address;
 	wire	[31:0]		i_bus_data;
 	reg	[(LGMEM-1):0]	raddr;
@@ -145,6 +161,8 @@ module wbscope #(
 	wire	[19:0]		full_holdoff;
 	reg	[31:0]		o_bus_data;
 	wire	[4:0]		bw_lgmem;
+	reg			br_read_control, br_query;
+	localparam [31:0]	CAPABILITIES = { 31'h0, OPT_SEEK };
 	reg			br_level_interrupt;
 	// }}}
 
@@ -165,6 +183,7 @@ module wbscope #(
 	assign	read_from_data = i_wb_stb && !i_wb_we && i_wb_addr && (&i_wb_sel);
 	assign	write_stb = (i_wb_stb)&&(i_wb_we);
 	assign	write_to_control = write_stb && !i_wb_addr && (&i_wb_sel);
+	assign	write_to_data    = write_stb &&  i_wb_addr && (&i_wb_sel);
 
 	always @(posedge bus_clock)
 		read_address <= i_wb_addr;
@@ -509,6 +528,13 @@ module wbscope #(
 	begin
 		if ((bw_reset_request)||(write_to_control))
 			raddr <= 0;
+		else if ((!OPT_SEEK)&&(write_to_data))
+			// Return to the beginning of the buffer
+			raddr <= 0;
+		else if ((write_to_data)&&(!i_bus_data[31]))
+			// Seek: set the read address, relative to the oldest
+			// value in the buffer
+			raddr <= i_bus_data[(LGMEM-1):0];
 		else if ((read_from_data)&&(bw_stopped))
 			raddr <= raddr + 1'b1; // Data read, when stopped
 
@@ -519,7 +545,11 @@ module wbscope #(
 	assign	o_wb_ack = (i_wb_cyc)&&(br_wb_ack);
 
 	always @(posedge bus_clock)
-	if (read_from_data)
+	if ((!OPT_SEEK)&&(write_to_data))
+		this_addr <= waddr;
+	else if ((write_to_data)&&(!i_bus_data[31]))
+		this_addr <= i_bus_data[(LGMEM-1):0] + waddr;
+	else if (read_from_data)
 		this_addr <= raddr + waddr + 1'b1;
 	else
 		this_addr <= raddr + waddr;
@@ -538,11 +568,32 @@ module wbscope #(
 
 	assign		bw_lgmem = LGMEM;
 
+	// Capabilities query
+	// {{{
+	// A write of bit 31 to the data register asks for the CAPABILITIES
+	// word, which is then returned by the next control register read in
+	// place of the control word.  Any other write cancels the query.
+	initial	br_read_control = 1'b0;
+	always @(posedge bus_clock)
+		br_read_control <= (i_wb_stb)&&(!i_wb_we)&&(!i_wb_addr);
+
+	initial	br_query = 1'b0;
+	always @(posedge bus_clock)
+	if (!OPT_SEEK)
+		br_query <= 1'b0;
+	else if (write_stb)
+		br_query <= (write_to_data)&&(i_bus_data[31]);
+	else if (br_read_control)
+		br_query <= 1'b0;
+	// }}}
+
 	// Bus read
 	// {{{
 	always @(posedge bus_clock)
 	begin
-		if (!read_address) // Control register read
+		if ((!read_address)&&(br_query))
+			o_bus_data <= CAPABILITIES;
+		else if (!read_address) // Control register read
 			o_bus_data <= { bw_reset_request,
 					bw_stopped,
 					bw_triggered,
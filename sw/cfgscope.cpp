@@ -62,6 +62,8 @@
 // approaches.  As a result, it provides for a more flexible (textual) output.
 //
 class	CFGSCOPE : public SCOPE {
+public:
+	CFGSCOPE(DEVBUS *fpga, unsigned addr) : SCOPE(fpga, addr) {}
 
 	virtual	void	define_traces(void) {
 		// Heres the interface for VCD files: We need to tell the VCD
@@ -104,6 +106,38 @@ class	CFGSCOPE : public SCOPE {
 		}
 		printf(" -> %02x", v & 0x0ffffff);
 	}
+
+	//
+	// decode_batch
+	//
+	// This is optional.  It does the same thing as decode() above, only
+	// for many words at once, and writing to the given output buffer
+	// rather than calling printf().  For deep captures, this is much
+	// faster.  Every word decoded must be followed by a call to
+	// out.endl().
+	//
+	virtual	void	decode_batch(const DEVBUS::BUSW *v, size_t n,
+				OUTBUF &out) {
+		for(size_t k=0; k<n; k++) {
+			DEVBUS::BUSW	w = v[k];
+
+			out.put((w&0x80000000) ? "   " : "CS ", 3);
+			out.put((w&0x40000000) ? "RD " : "WR ", 3);
+
+			switch((w>>24)&0x03f) {
+				case	0x20: out.put("DUMMY", 5); break;
+				case	0x10: out.put("NOOP ", 5); break;
+				case	0x08: out.put("SYNC ", 5); break;
+				case	0x04: out.put("CMD  ", 5); break;
+				case	0x02: out.put("IPROG", 5); break;
+				case	0x01: out.put("DSYNC", 5); break;
+				default:      out.put("OTHER", 5); break;
+			}
+			out.put(" -> ", 4);
+			out.hex(w & 0x0ffffff, 2);
+			out.endl();
+		}
+	}
 };
 
 int main(int argc, char **argv) {
@@ -125,6 +159,10 @@ int main(int argc, char **argv) {
 	// 
 	CFGSCOPE *scope = new CFGSCOPE(m_fpga, WBSCOPE);
 
+	// Read the scope in 4k word chunks.  This allows print() to start
+	// decoding the first chunk while the next one is crossing the link.
+	scope->set_readout_chunk(4096);
+
 	// Check to see whether or not the scope has captured the data we need
 	// yet or not.
 	if (scope->ready()) {
@@ -137,6 +175,13 @@ int main(int argc, char **argv) {
 		// this, just call writevcd and pass it the name you wish your
 		// VCD file to have.
 		scope->writevcd("cfgtrace.vcd");
+
+		// Or save the capture itself, to come back to later.  The
+		// wbscap2vcd program can turn this into a VCD file as well.
+		scope->write_capture("cfgtrace.wbscap");
+
+		// Let the user know how long all of this took
+		scope->report_timing(stderr);
 	} else {
 		// If the scope isnt yet ready, print a message, decode its
 		// current state, and exit kindly.
@@ -146,4 +191,5 @@ int main(int argc, char **argv) {
 
 	// Clean up our interface, now, and we're done.
 	delete	m_fpga;
+	return 0;
 }
@@ -0,0 +1,316 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	edgeidx.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Builds and queries the EDGEIDX transition index.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+
+#include "edgeidx.h"
+
+// One entry of the skip table for every (1<<LGSKIP) edges
+#define	LGSKIP	6
+
+// Append v to a byte array, seven bits at a time, least significant first,
+// with the top bit of each byte set if more follow
+static inline	void	put_varint(std::vector<uint8_t> &b, uint64_t v) {
+	while(v >= 0x80) {
+		b.push_back((uint8_t)(v | 0x80));
+		v >>= 7;
+	} b.push_back((uint8_t)v);
+}
+
+// Read a varint back, moving off past it
+static inline	uint64_t	get_varint(const uint8_t *b, size_t &off) {
+	uint64_t	v = 0;
+	unsigned	shift = 0;
+
+	while(b[off] & 0x80) {
+		v |= (uint64_t)(b[off++] & 0x7f) << shift;
+		shift += 7;
+	} v |= (uint64_t)b[off++] << shift;
+
+	return v;
+}
+
+// EDGEIDX::setup
+// {{{
+void	EDGEIDX::setup(unsigned len, bool compressed) {
+	m_len   = len;
+	m_valid = 0;
+	m_compressed = compressed;
+	m_clk   = 0;
+	m_eff   = 0;
+	for(unsigned k=0; k<m_traces.size(); k++) {
+		TRACE	&t = m_traces[k];
+
+		t.m_initial = t.m_last = 0;
+		t.m_lastclk = t.m_nedges = 0;
+		t.m_bytes.clear();
+		t.m_skip.clear();
+	}
+}
+// }}}
+
+// EDGEIDX::add_trace
+// {{{
+void	EDGEIDX::add_trace(unsigned nbits, unsigned nshift) {
+	TRACE	t;
+
+	t.m_nbits  = nbits;
+	t.m_nshift = nshift;
+	t.m_mask   = (nbits >= 32) ? 0xffffffff : ((1u << nbits)-1);
+	t.m_initial = t.m_last = 0;
+	t.m_lastclk = t.m_nedges = 0;
+	m_traces.push_back(t);
+}
+// }}}
+
+// EDGEIDX::append
+// {{{
+void	EDGEIDX::append(TRACE &t, uint64_t clk, uint32_t v) {
+	if ((t.m_nedges & ((1u<<LGSKIP)-1)) == 0) {
+		SKIP	s;
+
+		s.m_base   = t.m_lastclk;
+		s.m_offset = t.m_bytes.size();
+		s.m_value  = t.m_last;
+		t.m_skip.push_back(s);
+	}
+
+	// Edges are always at least a clock apart, so the difference less
+	// one is stored
+	put_varint(t.m_bytes, clk - t.m_lastclk - 1);
+	if (t.m_nbits > 1)
+		put_varint(t.m_bytes, v);
+
+	t.m_lastclk = clk;
+	t.m_last    = v;
+	t.m_nedges++;
+}
+// }}}
+
+// EDGEIDX::extend
+// {{{
+void	EDGEIDX::extend(const uint32_t *data, unsigned nwords) {
+	if (nwords > m_len)
+		nwords = m_len;
+	if (nwords <= m_valid)
+		return;
+
+	for(unsigned i=m_valid; i<nwords; i++) {
+		bool	run = (m_compressed)&&(data[i] & 0x80000000);
+
+		if (i == 0) {
+			// A run at the very start repeats a value we never
+			// saw, and so reads as zero--as in SCOPE::value_at()
+			if (!run)
+				m_eff = data[i];
+			for(unsigned k=0; k<m_traces.size(); k++) {
+				TRACE	&t = m_traces[k];
+
+				t.m_initial = t.m_last
+					= (m_eff >> t.m_nshift) & t.m_mask;
+			}
+		} else if ((!run)&&(data[i] != m_eff)) {
+			m_eff = data[i];
+			for(unsigned k=0; k<m_traces.size(); k++) {
+				TRACE		&t = m_traces[k];
+				uint32_t	v = (m_eff >> t.m_nshift) & t.m_mask;
+
+				if (v != t.m_last)
+					append(t, m_clk, v);
+			}
+		}
+
+		// As in SCOPE::build_index(), a run-length word represents the
+		// last value repeated for (m_data[i]&0x7fffffff) more clocks,
+		// save at the very beginning
+		m_clk++;
+		if ((run)&&(i != 0))
+			m_clk += data[i] & 0x7fffffff;
+	}
+
+	m_valid = nwords;
+}
+// }}}
+
+// EDGEIDX::decode
+// {{{
+void	EDGEIDX::decode(const TRACE &t, size_t &off, uint64_t &clk,
+		uint32_t &v) const {
+	clk += get_varint(t.m_bytes.data(), off) + 1;
+	if (t.m_nbits > 1)
+		v = (uint32_t)get_varint(t.m_bytes.data(), off);
+	else
+		v ^= 1;
+}
+// }}}
+
+// EDGEIDX::seek
+// {{{
+void	EDGEIDX::seek(const TRACE &t, uint64_t clk, CURSOR &c) const {
+	c.m_index  = 0;
+	c.m_clk    = 0;
+	c.m_value  = t.m_initial;
+	c.m_offset = 0;
+
+	// There's never an edge at clock zero
+	if ((t.m_nedges == 0)||(clk == 0))
+		return;
+
+	// Find the last group of edges starting after an edge before clk.
+	// The first group always does, since its base is clock zero.
+	std::vector<SKIP>::const_iterator	s;
+	s = std::upper_bound(t.m_skip.begin(), t.m_skip.end(), clk-1,
+		[](uint64_t v, const SKIP &sk) { return v < sk.m_base; }) - 1;
+
+	c.m_index  = (uint64_t)(s - t.m_skip.begin()) << LGSKIP;
+	c.m_clk    = s->m_base;
+	c.m_value  = s->m_value;
+	c.m_offset = s->m_offset;
+
+	// Then walk forward through that group, which will end at or after
+	// clk
+	while(c.m_index < t.m_nedges) {
+		size_t		off = c.m_offset;
+		uint64_t	eclk = c.m_clk;
+		uint32_t	v = c.m_value;
+
+		decode(t, off, eclk, v);
+		if (eclk > clk)
+			break;
+		c.m_index++;
+		c.m_clk    = eclk;
+		c.m_value  = v;
+		c.m_offset = off;
+	}
+}
+// }}}
+
+// EDGEIDX::memory
+// {{{
+size_t	EDGEIDX::memory(unsigned trace) const {
+	const TRACE	&t = m_traces[trace];
+
+	return t.m_bytes.size() + t.m_skip.size() * sizeof(SKIP);
+}
+// }}}
+
+// EDGEIDX::next_edge
+// {{{
+bool	EDGEIDX::next_edge(unsigned trace, uint64_t from, uint64_t &at,
+		uint32_t *value) const {
+	const TRACE	&t = m_traces[trace];
+	CURSOR		c;
+
+	seek(t, (from > 0) ? from-1 : 0, c);
+	if (c.m_index >= t.m_nedges)
+		return false;
+
+	decode(t, c.m_offset, c.m_clk, c.m_value);
+	at = c.m_clk;
+	if (value)
+		*value = c.m_value;
+	return true;
+}
+// }}}
+
+// EDGEIDX::prev_edge
+// {{{
+bool	EDGEIDX::prev_edge(unsigned trace, uint64_t upto, uint64_t &at,
+		uint32_t *value) const {
+	CURSOR		c;
+
+	seek(m_traces[trace], upto, c);
+	if (c.m_index == 0)
+		return false;
+
+	at = c.m_clk;
+	if (value)
+		*value = c.m_value;
+	return true;
+}
+// }}}
+
+// EDGEIDX::next_value
+// {{{
+bool	EDGEIDX::next_value(unsigned trace, uint64_t from, uint32_t value,
+		uint64_t &at) const {
+	const TRACE	&t = m_traces[trace];
+	CURSOR		c;
+
+	seek(t, (from > 0) ? from-1 : 0, c);
+	for(; c.m_index < t.m_nedges; c.m_index++) {
+		decode(t, c.m_offset, c.m_clk, c.m_value);
+		if (c.m_value == value) {
+			at = c.m_clk;
+			return true;
+		}
+	}
+
+	return false;
+}
+// }}}
+
+// EDGEIDX::count
+// {{{
+uint64_t	EDGEIDX::count(unsigned trace, uint64_t first,
+		uint64_t last) const {
+	const TRACE	&t = m_traces[trace];
+	CURSOR		a, b;
+
+	if ((last <= first)||(last <= 1))
+		return 0;
+
+	// The edges at or before last-1, less those before first
+	seek(t, last-1, b);
+	if (first == 0)
+		return b.m_index;
+	seek(t, first-1, a);
+	return b.m_index - a.m_index;
+}
+// }}}
+
+// EDGEIDX::value_at
+// {{{
+uint32_t	EDGEIDX::value_at(unsigned trace, uint64_t clk) const {
+	CURSOR	c;
+
+	seek(m_traces[trace], clk, c);
+	return c.m_value;
+}
+// }}}
@@ -0,0 +1,172 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	edgeidx.h
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Declares EDGEIDX, an index of where each of a capture's traces
+//		changes value, answering next/previous edge, edge count and value
+//	queries without walking (or expanding) the capture itself.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	EDGEIDX_H
+#define	EDGEIDX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/*
+ * EDGEIDX
+ * {{{
+ * An index of the clocks at which each trace of a capture changes value.
+ * For every trace, the index holds the clock of each change (each edge),
+ * together with the value the trace changes to, in order.  Clocks are
+ * stored as the (varint encoded) difference from the clock of the edge
+ * before, and the values of one bit traces aren't stored at all, since each
+ * edge toggles them--so a quiet trace costs next to nothing, and a busy one
+ * a byte or two per edge.  Every 64th edge, a skip table records where that
+ * edge's encoding starts, so a query needs a binary search through the skip
+ * table and then decodes no more than 64 edges.
+ *
+ * Like the PYRAMID, the index is built in one pass over the raw words, for
+ * all traces at once, and may be built incrementally as the words arrive.
+ * For compressed scopes, the clocks are those of the expanded capture--as
+ * given by SCOPE::sample_time()--and a run-length word just moves the clock
+ * forward.  The capture is never expanded, and queries never look at it.
+ * }}}
+ */
+class	EDGEIDX {
+	// Where the encoding of each 64th edge starts, along with the clock
+	// and the value of the trace just before that edge
+	struct	SKIP {
+		uint64_t	m_base;
+		size_t		m_offset;
+		uint32_t	m_value;
+	};
+
+	struct	TRACE {
+		unsigned	m_nbits, m_nshift;
+		uint32_t	m_mask;
+		// The value at clock zero, and after the last edge so far
+		uint32_t	m_initial, m_last;
+		uint64_t	m_lastclk, m_nedges;
+		std::vector<uint8_t>	m_bytes;
+		std::vector<SKIP>	m_skip;
+	};
+
+	// Where a query lands: m_index edges are at or before the clock in
+	// question, the last of them at m_clk (zero if none), leaving the
+	// trace at m_value.  The next edge's encoding starts at m_offset.
+	struct	CURSOR {
+		uint64_t	m_index, m_clk;
+		uint32_t	m_value;
+		size_t		m_offset;
+	};
+
+	std::vector<TRACE>	m_traces;
+	unsigned	m_len, m_valid;
+	bool		m_compressed;
+	// The clock of the next word, and the last data word seen, which
+	// any run-length words repeat
+	uint64_t	m_clk;
+	uint32_t	m_eff;
+
+	// Add an edge to trace t
+	void	append(TRACE &t, uint64_t clk, uint32_t v);
+
+	// Decode the edge at offset off, following an edge at clock clk
+	// leaving the trace at value v.  Moves all three on past the edge.
+	void	decode(const TRACE &t, size_t &off, uint64_t &clk,
+			uint32_t &v) const;
+
+	// Find the last edge at or before clock clk
+	void	seek(const TRACE &t, uint64_t clk, CURSOR &c) const;
+public:
+	EDGEIDX(void) : m_len(0), m_valid(0), m_compressed(false),
+		m_clk(0), m_eff(0) {}
+
+	// Forget everything, and get ready to index len words
+	void	setup(unsigned len, bool compressed);
+
+	// Add a trace, ((word >> nshift) & ((1<<nbits)-1)).  All traces must
+	// be added before the first extend().
+	void	add_trace(unsigned nbits, unsigned nshift);
+
+	void	clear(void) { setup(0, false); m_traces.clear(); }
+
+	// Index data words up to (but not including) nwords.  Words before
+	// valid() have already been indexed and are skipped.
+	void	extend(const uint32_t *data, unsigned nwords);
+
+	// The number of words to be indexed, and that have been
+	unsigned	size(void) const { return m_len; }
+	unsigned	valid(void) const { return m_valid; }
+	bool		complete(void) const {
+		return (m_len > 0)&&(m_valid >= m_len);
+	}
+
+	// The number of clocks covered by the words indexed so far
+	uint64_t	nclocks(void) const { return m_clk; }
+
+	unsigned	ntraces(void) const { return m_traces.size(); }
+
+	// The number of edges of a trace, and the bytes its index takes up
+	uint64_t	nedges(unsigned trace) const {
+		return m_traces[trace].m_nedges;
+	}
+	size_t		memory(unsigned trace) const;
+
+	// The first edge of a trace at or after clock from.  Returns false if
+	// there isn't one.  Otherwise at is set to the clock of the edge,
+	// and value (if given) to the value the trace changes to.
+	bool	next_edge(unsigned trace, uint64_t from, uint64_t &at,
+			uint32_t *value = NULL) const;
+
+	// The last edge of a trace at or before clock upto, as above
+	bool	prev_edge(unsigned trace, uint64_t upto, uint64_t &at,
+			uint32_t *value = NULL) const;
+
+	// The first edge at or after clock from where the trace changes to
+	// the given value--such as a chip select going low
+	bool	next_value(unsigned trace, uint64_t from, uint32_t value,
+			uint64_t &at) const;
+
+	// The number of edges of a trace in clocks first through last-1
+	uint64_t	count(unsigned trace, uint64_t first,
+				uint64_t last) const;
+
+	// The value of a trace at clock clk.  Past the end of the capture,
+	// this is the trace's last value.
+	uint32_t	value_at(unsigned trace, uint64_t clk) const;
+};
+
+#endif	// EDGEIDX_H
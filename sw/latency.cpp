@@ -0,0 +1,279 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	latency.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Pairs the start and end events of a capture, and keeps the
+//		distribution of the times between them.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdint.h>
+#include <deque>
+
+#include "latency.h"
+
+// Latencies below (1<<LGEXACT) clocks get a bin of their own.  Above, each
+// power of two is split into (1<<LGSUB) bins.
+#define	LGEXACT	7
+#define	LGSUB	6
+#define	NBINS	((1u<<LGEXACT) + (64-LGEXACT) * (1u<<LGSUB))
+
+// The number of words to scan at a time, for both events--few enough that
+// the second scan finds them still in the cache
+#define	LATENCY_BLOCK	(1u<<14)
+
+// LATENCY::bin
+// {{{
+unsigned	LATENCY::bin(uint64_t clocks) {
+	unsigned	e, sub;
+
+	if (clocks < (1u << LGEXACT))
+		return (unsigned)clocks;
+
+	e   = 63 - __builtin_clzll(clocks);
+	sub = (unsigned)(clocks >> (e - LGSUB)) & ((1u << LGSUB)-1);
+	return (1u << LGEXACT) + (e - LGEXACT) * (1u << LGSUB) + sub;
+}
+// }}}
+
+// LATENCY::bin_range
+// {{{
+void	LATENCY::bin_range(unsigned b, uint64_t &lo, uint64_t &hi) {
+	unsigned	e, sub;
+
+	if (b < (1u << LGEXACT)) {
+		lo = hi = b;
+		return;
+	}
+
+	b  -= (1u << LGEXACT);
+	e   = LGEXACT + (b >> LGSUB);
+	sub = b & ((1u << LGSUB)-1);
+	lo  = (uint64_t)((1u << LGSUB) + sub) << (e - LGSUB);
+	hi  = lo + ((uint64_t)1 << (e - LGSUB)) - 1;
+}
+// }}}
+
+// LATENCY::clear
+// {{{
+void	LATENCY::clear(void) {
+	m_count = m_max = m_orphans = m_unfinished = 0;
+	m_min = UINT64_MAX;
+	m_sum = 0.0;
+	m_bins.assign(NBINS, 0);
+}
+// }}}
+
+// LATENCY::add
+// {{{
+void	LATENCY::add(uint64_t clocks) {
+	m_count++;
+	m_sum += clocks;
+	if (clocks < m_min)
+		m_min = clocks;
+	if (clocks > m_max)
+		m_max = clocks;
+	m_bins[bin(clocks)]++;
+}
+// }}}
+
+// LATENCY::measure
+// {{{
+void	LATENCY::measure(const SEARCH &search, const SEARCH::TERM &start,
+		const SEARCH::TERM &end, PAIRING pairing) {
+	SEARCH::SCANNER	sstart(search, start, true), send(search, end, true);
+	std::vector<SEARCH::MATCH>	starts, ends;
+	// The starts still waiting for an end.  Only FIFO pairing ever has
+	// more than one.
+	std::deque<uint64_t>	pending;
+
+	// Both scanners move through the capture in step, so the events of
+	// each block can be merged in order before moving on to the next
+	for(;;) {
+		unsigned	s = 0, e = 0;
+
+		starts.clear();
+		ends.clear();
+		if (sstart.scan(LATENCY_BLOCK, starts) == 0)
+			break;
+		send.scan(LATENCY_BLOCK, ends);
+
+		while((s < starts.size())||(e < ends.size())) {
+			if ((e < ends.size())&&((s >= starts.size())
+				||(ends[e].m_clk <= starts[s].m_clk))) {
+				// An end, taken before any start on the
+				// same clock
+				uint64_t	clk = ends[e++].m_clk;
+
+				if (pending.size() == 0) {
+					m_orphans++;
+					continue;
+				}
+
+				add(clk - pending.front());
+				if (pairing == FIFO)
+					pending.pop_front();
+				else
+					pending.clear();
+			} else {
+				uint64_t	clk = starts[s++].m_clk;
+
+				if ((pairing == FIFO)||(pending.size() == 0))
+					pending.push_back(clk);
+				else if (pairing == LAST)
+					pending.front() = clk;
+			}
+		}
+	}
+
+	m_unfinished += pending.size();
+}
+// }}}
+
+// LATENCY::percentile
+// {{{
+uint64_t	LATENCY::percentile(double p) const {
+	uint64_t	rank, seen = 0;
+
+	if (m_count == 0)
+		return 0;
+	if (p <= 0.0)
+		return m_min;
+	if (p >= 1.0)
+		return m_max;
+
+	// The rank of the latency we're after, counting from one
+	rank = (uint64_t)(p * m_count);
+	if ((double)rank < p * m_count)
+		rank++;
+	if (rank < 1)
+		rank = 1;
+
+	for(unsigned b=0; b<m_bins.size(); b++) {
+		seen += m_bins[b];
+		if (seen >= rank) {
+			uint64_t	lo, hi;
+
+			bin_range(b, lo, hi);
+			if (lo < m_min)
+				lo = m_min;
+			if (lo > m_max)
+				lo = m_max;
+			return lo;
+		}
+	}
+
+	return m_max;
+}
+// }}}
+
+// LATENCY::histogram
+// {{{
+void	LATENCY::histogram(std::vector<BIN> &bins) const {
+	for(unsigned b=0; b<m_bins.size(); b++) {
+		BIN	bn;
+
+		if (m_bins[b] == 0)
+			continue;
+		bin_range(b, bn.m_lo, bn.m_hi);
+		bn.m_count = m_bins[b];
+		bins.push_back(bn);
+	}
+}
+// }}}
+
+// LATENCY::report
+// {{{
+// The histogram is shown with a row for each power of two, to keep it short
+// no matter how widely the latencies are spread.
+void	LATENCY::report(FILE *fp) const {
+	const double	pct[] = { 0.5, 0.9, 0.99, 0.999 };
+	uint64_t	rows[65], most = 0;
+
+	fprintf(fp, "%lu latencies measured", (unsigned long)m_count);
+	if ((m_orphans > 0)||(m_unfinished > 0))
+		fprintf(fp, " (%lu ends without a start,"
+			" %lu starts without an end)",
+			(unsigned long)m_orphans,
+			(unsigned long)m_unfinished);
+	fprintf(fp, "\n");
+	if (m_count == 0)
+		return;
+
+	fprintf(fp, "  %-6s %12lu clocks %14.1f ns\n", "min",
+		(unsigned long)m_min, ns(m_min));
+	fprintf(fp, "  %-6s %12.1f clocks %14.1f ns\n", "mean",
+		mean(), ns(mean()));
+	for(unsigned k=0; k<sizeof(pct)/sizeof(pct[0]); k++) {
+		char	name[16];
+		uint64_t	v = percentile(pct[k]);
+
+		snprintf(name, sizeof(name), "p%g", pct[k]*100.0);
+		fprintf(fp, "  %-6s %12lu clocks %14.1f ns\n", name,
+			(unsigned long)v, ns(v));
+	}
+	fprintf(fp, "  %-6s %12lu clocks %14.1f ns\n", "max",
+		(unsigned long)m_max, ns(m_max));
+
+	// Gather the bins into rows, by their lowest latency
+	for(unsigned r=0; r<65; r++)
+		rows[r] = 0;
+	for(unsigned b=0; b<m_bins.size(); b++) {
+		uint64_t	lo, hi;
+		unsigned	r;
+
+		if (m_bins[b] == 0)
+			continue;
+		bin_range(b, lo, hi);
+		r = (lo == 0) ? 0 : 64 - __builtin_clzll(lo);
+		rows[r] += m_bins[b];
+		if (rows[r] > most)
+			most = rows[r];
+	}
+
+	for(unsigned r=0; r<65; r++) {
+		uint64_t	lo = (r == 0) ? 0 : (uint64_t)1 << (r-1),
+				hi = (r == 0) ? 0 : (lo << 1) - 1;
+		unsigned	nbar;
+
+		if (rows[r] == 0)
+			continue;
+		nbar = (unsigned)((rows[r] * 40 + most - 1) / most);
+		fprintf(fp, "  %10lu - %-10lu %10lu |", (unsigned long)lo,
+			(unsigned long)hi, (unsigned long)rows[r]);
+		for(unsigned k=0; k<nbar; k++)
+			fputc('#', fp);
+		fputc('\n', fp);
+	}
+}
+// }}}
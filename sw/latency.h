@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	latency.h
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Declares LATENCY, which measures the time between pairs of
+//		events in a capture--a request and its acknowledgement, a chip select
+//	falling and rising again, one rising clock edge and the next--and keeps
+//	the distribution of those times: min, max, mean, percentiles, histogram.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	LATENCY_H
+#define	LATENCY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include "search.h"
+
+/*
+ * LATENCY
+ * {{{
+ * Measures latencies, in clocks, between start and end events.  An event is
+ * the first clock of a SEARCH::TERM's match: the clock a level term starts to
+ * hold, or the clock of an edge.  Each end event is paired with a start
+ * before it, as set by the PAIRING:
+ *
+ *	FIRST	An end goes with the first start since the last end.  Any
+ *		starts in between are ignored.  (A chip select's low time.)
+ *	LAST	An end goes with the latest start since the last end, as when
+ *		a request is retried.
+ *	FIFO	Each end goes with the oldest start that hasn't yet ended, for
+ *		pipelined requests with several outstanding at once.
+ *
+ * End events without a start are counted as orphans, and starts still
+ * waiting at the end of the capture as unfinished.  Where a start and an end
+ * fall on the same clock, the end is taken first--so a TERM may be both start
+ * and end, measuring (say) the period of a clock from one rising edge to the
+ * next.  Latencies are then always at least one clock.
+ *
+ * The capture is scanned once, a block at a time, for both events side by
+ * side, so the time taken is linear in the number of words (not clocks) and
+ * the memory needed doesn't grow with the capture.  The distribution is kept
+ * the same way: latencies below 128 clocks are counted exactly, and those
+ * above in 64 bins for every power of two, so percentiles above 128 clocks
+ * are within 1/64th of the true value.
+ * }}}
+ */
+class	LATENCY {
+public:
+	enum	PAIRING { FIRST, LAST, FIFO };
+
+	// A bin of the histogram: m_count latencies from m_lo to m_hi clocks
+	struct	BIN {
+		uint64_t	m_lo, m_hi, m_count;
+	};
+
+private:
+	unsigned	m_clkfreq_hz;
+	uint64_t	m_count, m_min, m_max, m_orphans, m_unfinished;
+	long double	m_sum;
+	std::vector<uint64_t>	m_bins;
+
+	// The histogram bin holding a latency, and the range of a bin
+	static	unsigned	bin(uint64_t clocks);
+	static	void		bin_range(unsigned b, uint64_t &lo,
+					uint64_t &hi);
+public:
+	LATENCY(unsigned clkfreq_hz = 100000000)
+		: m_clkfreq_hz(clkfreq_hz) { clear(); }
+
+	// Forget every latency measured so far
+	void	clear(void);
+
+	// The clock the latencies were measured with, for converting them
+	// to nanoseconds
+	void	set_clkfreq_hz(unsigned clkfreq_hz) {
+		m_clkfreq_hz = clkfreq_hz;
+	}
+	unsigned get_clkfreq_hz(void) const { return m_clkfreq_hz; }
+
+	// Add one latency to the distribution
+	void	add(uint64_t clocks);
+
+	// Pair the start and end events of a capture, adding the latency of
+	// each pair to the distribution
+	void	measure(const SEARCH &search, const SEARCH::TERM &start,
+			const SEARCH::TERM &end, PAIRING pairing = FIRST);
+
+	uint64_t	count(void) const { return m_count; }
+	uint64_t	min(void) const { return m_min; }
+	uint64_t	max(void) const { return m_max; }
+	double		mean(void) const {
+		return (m_count > 0) ? (double)(m_sum / m_count) : 0.0;
+	}
+	uint64_t	orphans(void) const { return m_orphans; }
+	uint64_t	unfinished(void) const { return m_unfinished; }
+
+	// The latency below which a fraction p (0 to 1) of the latencies
+	// fall.  percentile(0.5) is the median.
+	uint64_t	percentile(double p) const;
+
+	// A number of clocks, in nanoseconds
+	double	ns(double clocks) const {
+		return clocks * 1e9 / m_clkfreq_hz;
+	}
+
+	// The bins of the histogram with anything in them, in order
+	void	histogram(std::vector<BIN> &bins) const;
+
+	// Describe the distribution, in clocks and nanoseconds
+	void	report(FILE *fp) const;
+};
+
+#endif	// LATENCY_H
@@ -0,0 +1,188 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	memscope.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Reads a memscope (or memscopc) capture directly from the memory
+//		the core records into, starting from the oldest word and
+//	wrapping around at the end of memory.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+
+#include "devbus.h"
+#include "memscope.h"
+
+// The memscope's registers, following its control and data registers
+#define	MEMSCOPE_ADDRLO	8
+#define	MEMSCOPE_ADDRHI	12
+
+// MEMSCOPE::ready
+// {{{
+bool	MEMSCOPE::ready(DEVBUS::BUSW v) {
+	unsigned	status = (v>>28)&7;
+
+	// Let the SCOPE pick up the memory size and holdoff
+	SCOPE::ready(v);
+
+	if (status & 4) {
+		bool	overflow = (status & 2) != 0,
+			buserr   = (status & 1) != 0;
+
+		if ((overflow && !m_overflow)||(buserr && !m_buserr))
+			fprintf(stderr, "ERR: Memscope at 0x%08x reports %s\n",
+				address(), (buserr) ? "a bus error"
+				: "an overflow--samples have been lost");
+		m_overflow = overflow;
+		m_buserr   = buserr;
+		return false;
+	}
+
+	m_overflow = m_buserr = false;
+	return (status == 3);
+}
+// }}}
+
+// MEMSCOPE::oldest_address
+// {{{
+uint64_t	MEMSCOPE::oldest_address(void) {
+	uint64_t	lo, hi;
+
+	// Writing to the data register resets the read address to the
+	// oldest word, which can then be read from ADDRLO and ADDRHI
+	m_bus->writeio(m_ctladdr+4, 0);
+	lo = m_bus->readio(m_ctladdr+MEMSCOPE_ADDRLO);
+	hi = m_bus->readio(m_ctladdr+MEMSCOPE_ADDRHI);
+
+	// The core uses all of its memory, wrapping around at the end
+	return ((hi << 32) | lo) & (((uint64_t)scoplen() << 2)-1);
+}
+// }}}
+
+// MEMSCOPE::direct_read
+// {{{
+void	MEMSCOPE::direct_read(unsigned pos, unsigned ln, DEVBUS::BUSW *buf) {
+	unsigned	len = scoplen(), addr;
+
+	addr = (m_oldest + pos) & (len-1);
+	while(ln > 0) {
+		unsigned	n = ln;
+
+		// Don't read past the end of memory--wrap around to the
+		// beginning instead
+		if (n > len - addr)
+			n = len - addr;
+		if (n > m_burst)
+			n = m_burst;
+
+		m_bus->readi(m_membase + (addr<<2), n, buf);
+		buf  += n;
+		ln   -= n;
+		addr  = (addr + n) & (len-1);
+	}
+}
+// }}}
+
+// MEMSCOPE::read_words
+// {{{
+void	MEMSCOPE::read_words(unsigned pos, unsigned ln, DEVBUS::BUSW *buf) {
+	if (!m_direct) {
+		// Start the data register from the oldest word.  (We may
+		// have been reading from it in benchmark().)
+		if (pos == 0)
+			m_bus->writeio(m_ctladdr+4, 0);
+		SCOPE::read_words(pos, ln, buf);
+		return;
+	}
+
+	if (pos == 0)
+		m_oldest = (unsigned)(oldest_address() >> 2);
+	direct_read(pos, ln, buf);
+}
+// }}}
+
+// MEMSCOPE::seek_words
+// {{{
+bool	MEMSCOPE::seek_words(unsigned pos) {
+	// The data register can only be rewound, not moved
+	if ((!m_direct)&&(pos != 0))
+		return false;
+	return true;
+}
+// }}}
+
+// MEMSCOPE::benchmark
+// {{{
+bool	MEMSCOPE::benchmark(FILE *fp, unsigned nwords) {
+	struct timespec	start, mid, done;
+	double		reg_s, mem_s;
+	bool		same;
+
+	join_reader();
+	if ((nwords == 0)||(nwords > scoplen()))
+		nwords = scoplen();
+	if (nwords == 0)
+		return false;
+
+	std::vector<DEVBUS::BUSW>	viareg(nwords), viamem(nwords);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	m_bus->writeio(m_ctladdr+4, 0);
+	SCOPE::read_words(0, nwords, viareg.data());
+	clock_gettime(CLOCK_MONOTONIC, &mid);
+	m_oldest = (unsigned)(oldest_address() >> 2);
+	direct_read(0, nwords, viamem.data());
+	clock_gettime(CLOCK_MONOTONIC, &done);
+
+	reg_s = (mid.tv_sec - start.tv_sec)
+				+ (mid.tv_nsec - start.tv_nsec) * 1e-9;
+	mem_s = (done.tv_sec - mid.tv_sec)
+				+ (done.tv_nsec - mid.tv_nsec) * 1e-9;
+	same = (viareg == viamem);
+
+	fprintf(fp, "MEMSCOPE readout of %u words\n", nwords);
+	fprintf(fp, "\tData register:\t%10.6f s, %14.0f words/s\n",
+		reg_s, (reg_s > 0) ? nwords / reg_s : 0.0);
+	fprintf(fp, "\tDirect memory:\t%10.6f s, %14.0f words/s\n",
+		mem_s, (mem_s > 0) ? nwords / mem_s : 0.0);
+	if (mem_s > 0)
+		fprintf(fp, "\tSpeedup:\t%10.2fx\n", reg_s / mem_s);
+	if (!same)
+		fprintf(fp, "ERR: The two readouts differ\n");
+
+	// Leave the data register ready to be read from the start again
+	m_bus->writeio(m_ctladdr+4, 0);
+	return same;
+}
+// }}}
@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	memscope.h
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Defines MEMSCOPE, the host side of the memscope and memscopc
+//		cores.  These cores record into an AXI memory, which the host
+//	can often see directly.  MEMSCOPE reads the capture from that memory
+//	in large bursts, rather than one word at a time through the scope's
+//	data register.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	MEMSCOPE_H
+#define	MEMSCOPE_H
+
+#include <stdio.h>
+#include "scopecls.h"
+
+/*
+ * MEMSCOPE
+ * {{{
+ * The host side of the memscope (and memscopc) cores.  These cores record
+ * into an AXI memory rather than into block RAM, and that memory can be
+ * huge.  Reading it through the scope's data register costs one bus
+ * transaction, and one AXI read within the core, for every word.  If the
+ * host can see that memory itself, though, it's far faster to read it
+ * from there directly, in large bursts.  The core will tell us where in
+ * memory the oldest word is, through its ADDRLO and ADDRHI registers, and
+ * the rest follows from there--wrapping around at the end of the memory.
+ *
+ * membase is the address of the scope's memory on the host's bus--that is,
+ * the bus address of what the core sees as address zero.  The memory is
+ * assumed to be the size given in the scope's control word, all of which
+ * is used by the scope.
+ * }}}
+ */
+class	MEMSCOPE : public SCOPE {
+	DEVBUS		*m_bus;
+	DEVBUS::BUSW	m_ctladdr, m_membase;
+	// The offset, in words, into the memory of the oldest word of the
+	// capture
+	unsigned	m_oldest;
+	// The most words to read in any one readi()
+	unsigned	m_burst;
+	// Set to read the memory directly, clear to go through the scope's
+	// data register like any other scope
+	bool		m_direct;
+	// Any errors reported in the last control word read
+	bool		m_overflow, m_buserr;
+
+	// Read ln words, starting pos words after the oldest, directly from
+	// the scope's memory
+	void	direct_read(unsigned pos, unsigned ln, DEVBUS::BUSW *buf);
+public:
+	MEMSCOPE(DEVBUS *fpga, unsigned addr, DEVBUS::BUSW membase,
+			bool compressed=false, bool vecread=true)
+		: SCOPE(fpga, addr, compressed, vecread),
+			m_bus(fpga), m_ctladdr(addr), m_membase(membase),
+			m_oldest(0), m_burst(1<<16), m_direct(true),
+			m_overflow(false), m_buserr(false) {}
+
+	// The memscope's status bits differ from the wbscope's.  Stopped
+	// (with triggered and primed) is 3, not 7, and the top bit instead
+	// marks an overflow or a bus error.  Neither counts as ready.
+	using	SCOPE::ready;
+	virtual	bool	ready(DEVBUS::BUSW ctrl);
+
+	// Did the last control word read report a FIFO overflow (samples
+	// were lost), or an AXI bus error?
+	bool	overflow(void) const { return m_overflow; }
+	bool	bus_error(void) const { return m_buserr; }
+
+	// Read from memory no more than nwords at a time.  The default is
+	// 64k words.
+	void	set_burst(unsigned nwords) { m_burst = (nwords) ? nwords : 1; }
+
+	// Read directly from memory (the default), or, if direct is false,
+	// through the scope's data register
+	void	set_direct(bool direct) { m_direct = direct; }
+
+	// Rewind the scope's read pointer, and return the byte offset into
+	// the scope's memory of the oldest word in the capture
+	uint64_t	oldest_address(void);
+
+	// Read the first nwords of the capture (all of it, if nwords is zero)
+	// both through the scope's data register and directly from memory,
+	// and report the words per second of each to fp.  The scope should
+	// be stopped.  Returns false if the two reads differ.
+	bool	benchmark(FILE *fp, unsigned nwords = 0);
+
+protected:
+	virtual	void	read_words(unsigned pos, unsigned ln,
+				DEVBUS::BUSW *buf);
+	// Reading directly from memory, we can start anywhere
+	virtual	bool	seek_words(unsigned pos);
+};
+
+#endif	// MEMSCOPE_H
@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	outbuf.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Implements the OUTBUF, a buffered text output stream.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "outbuf.h"
+
+// OUTBUF::OUTBUF
+// {{{
+OUTBUF::OUTBUF(FILE *fp, unsigned sz) : m_fp(fp), m_len(0), m_size(sz),
+		m_hook(NULL), m_hookctx(NULL) {
+	// Leave room for the longest single formatted item
+	if (m_size < 256)
+		m_size = 256;
+	m_buf = new char[m_size];
+}
+// }}}
+
+// OUTBUF::~OUTBUF
+// {{{
+OUTBUF::~OUTBUF(void) {
+	flush();
+	delete[] m_buf;
+}
+// }}}
+
+// OUTBUF::flush
+// {{{
+void	OUTBUF::flush(void) {
+	if ((m_len > 0)&&(m_fp))
+		fwrite(m_buf, 1, m_len, m_fp);
+	m_len = 0;
+}
+// }}}
+
+// OUTBUF::grow
+// {{{
+void	OUTBUF::grow(unsigned n) {
+	unsigned	nsz = m_size;
+	char		*nbuf;
+
+	while(m_len + n > nsz)
+		nsz *= 2;
+	nbuf = new char[nsz];
+	memcpy(nbuf, m_buf, m_len);
+	delete[] m_buf;
+	m_buf  = nbuf;
+	m_size = nsz;
+}
+// }}}
+
+// OUTBUF::hex
+// {{{
+void	OUTBUF::hex(unsigned v, int ndigits) {
+	static	const char	digits[] = "0123456789abcdef";
+	int	n = 1;
+
+	while((n < 8)&&(v >> (4*n)))
+		n++;
+	if (ndigits > 8)
+		ndigits = 8;
+	if (n < ndigits)
+		n = ndigits;
+
+	reserve(n);
+	for(int k=n-1; k>=0; k--)
+		m_buf[m_len++] = digits[(v >> (4*k))&0x0f];
+}
+// }}}
+
+// OUTBUF::dec
+// {{{
+void	OUTBUF::dec(int64_t v, int width) {
+	char		tmp[24], *ptr = &tmp[sizeof(tmp)];
+	uint64_t	u = (v < 0) ? -(uint64_t)v : v;
+	int		ln;
+
+	// Convert from the least significant digit up
+	do {
+		*--ptr = '0' + (u % 10);
+		u /= 10;
+	} while(u > 0);
+	if (v < 0)
+		*--ptr = '-';
+	ln = &tmp[sizeof(tmp)] - ptr;
+
+	if (width > 64)
+		width = 64;
+	reserve(((ln > width) ? ln : width));
+	for(; width > ln; width--)
+		m_buf[m_len++] = ' ';
+	memcpy(&m_buf[m_len], ptr, ln);
+	m_len += ln;
+}
+// }}}
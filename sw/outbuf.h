@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	outbuf.h
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Printing a capture one small printf() at a time is slow.  This
+//		file defines an OUTBUF, a large block of memory that text is
+//	formatted into, and which is only written to its file in large writes,
+//	once it fills or is flushed.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	OUTBUF_H
+#define	OUTBUF_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * OUTBUF
+ * {{{
+ * A buffered text output stream.  Text is formatted directly into m_buf, which
+ * is written to m_fp once it fills, on flush(), or when the OUTBUF is deleted.
+ *
+ * If no file is given, the OUTBUF instead collects everything written to it in
+ * memory, growing as needed, until the owner takes it with data() and size().
+ *
+ * Lines are ended with endl().  By default this just adds a newline, but the
+ * owner of the buffer may hook endl() to add something at the end of every
+ * line, and/or the start of the next one.
+ * }}}
+ */
+class	OUTBUF {
+public:
+	typedef	void	(*ENDL_HOOK)(OUTBUF &out, void *ctx);
+protected:
+	FILE		*m_fp;
+	char		*m_buf;
+	unsigned	m_len, m_size;
+	ENDL_HOOK	m_hook;
+	void		*m_hookctx;
+
+	// Make sure there's room for at least n more characters
+	void	reserve(unsigned n) {
+		if (m_len + n > m_size) {
+			if (m_fp)
+				flush();
+			else
+				grow(n);
+		}
+	}
+
+	// Grow an in-memory buffer, to hold at least n more characters
+	void	grow(unsigned n);
+public:
+	static	const	unsigned DEFAULT_SIZE = (1<<20);
+
+	OUTBUF(FILE *fp, unsigned sz = DEFAULT_SIZE);
+	virtual	~OUTBUF(void);
+
+	// Write everything buffered so far to the file
+	void	flush(void);
+
+	// For an in-memory OUTBUF, everything written so far
+	const char	*data(void) const { return m_buf; }
+	unsigned	size(void) const { return m_len; }
+
+	// Add len characters of str to the buffer
+	void	put(const char *str, unsigned len) {
+		if ((len > m_size)&&(m_fp)) {
+			flush();
+			fwrite(str, 1, len, m_fp);
+			return;
+		}
+
+		reserve(len);
+		memcpy(&m_buf[m_len], str, len);
+		m_len += len;
+	}
+
+	// Add a string to the buffer
+	void	put(const char *str) { put(str, strlen(str)); }
+
+	// Add a single character
+	void	put(char ch) {
+		reserve(1);
+		m_buf[m_len++] = ch;
+	}
+
+	// Add a value in hexadecimal, using at least ndigits digits--as in
+	// printf("%0*x", ndigits, v)
+	void	hex(unsigned v, int ndigits = 1);
+
+	// Add a value in decimal, right justified in a field of at least
+	// width characters--as in printf("%*ld", width, v)
+	void	dec(int64_t v, int width = 0);
+
+	// End the current line
+	void	endl(void) {
+		if (m_hook)
+			m_hook(*this, m_hookctx);
+		else
+			put('\n');
+	}
+
+	// Replace the newline written by endl() with a call to hook(ctx).
+	// Call with a NULL hook to restore the default.
+	void	set_endl_hook(ENDL_HOOK hook, void *ctx) {
+		m_hook    = hook;
+		m_hookctx = ctx;
+	}
+};
+
+#endif	// OUTBUF_H
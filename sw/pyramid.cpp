@@ -0,0 +1,383 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	pyramid.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Builds and queries the PYRAMID summary of a capture's traces.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pyramid.h"
+
+#define	PYRAMID_MAGIC	"WBSPYR\r\n"
+#define	PYRAMID_VERSION	1
+
+// Fold the summary b into a
+static inline	void	merge(PYRAMID::NODE &a, const PYRAMID::NODE &b) {
+	if (b.m_min < a.m_min)
+		a.m_min = b.m_min;
+	if (b.m_max > a.m_max)
+		a.m_max = b.m_max;
+	a.m_or  |= b.m_or;
+	a.m_and &= b.m_and;
+	a.m_changes += b.m_changes;
+}
+
+// PYRAMID::setup
+// {{{
+void	PYRAMID::setup(unsigned len, bool compressed, unsigned lgbase) {
+	m_len    = len;
+	m_valid  = 0;
+	m_lgbase = lgbase;
+	m_compressed = compressed;
+	m_eff    = 0;
+	for(unsigned k=0; k<m_traces.size(); k++) {
+		m_traces[k].m_levels.clear();
+		m_traces[k].m_last = 0;
+	}
+}
+// }}}
+
+// PYRAMID::add_trace
+// {{{
+void	PYRAMID::add_trace(unsigned nbits, unsigned nshift) {
+	TRACE	t;
+
+	t.m_nbits  = nbits;
+	t.m_nshift = nshift;
+	t.m_mask   = (nbits >= 32) ? 0xffffffff : ((1u << nbits)-1);
+	t.m_last   = 0;
+	memset(&t.m_acc, 0, sizeof(t.m_acc));
+	m_traces.push_back(t);
+}
+// }}}
+
+// PYRAMID::push
+// {{{
+void	PYRAMID::push(TRACE &t, unsigned level, const NODE &n) {
+	if (t.m_levels.size() <= level)
+		t.m_levels.resize(level+1);
+
+	std::vector<NODE>	&lv = t.m_levels[level];
+
+	lv.push_back(n);
+	if ((lv.size() & 1) == 0) {
+		NODE	parent = lv[lv.size()-2];
+
+		merge(parent, lv.back());
+		push(t, level+1, parent);
+	}
+}
+// }}}
+
+// PYRAMID::extend
+// {{{
+void	PYRAMID::extend(const uint32_t *data, unsigned nwords) {
+	const unsigned	blkmsk = (1u << m_lgbase)-1;
+	unsigned	i;
+
+	if (nwords > m_len)
+		nwords = m_len;
+	if (nwords <= m_valid)
+		return;
+
+	for(i=m_valid; i<nwords; i++) {
+		bool	fresh = (i & blkmsk) == 0,
+			done  = (i & blkmsk) == blkmsk;
+
+		if ((!m_compressed)||((data[i] & 0x80000000)==0))
+			m_eff = data[i];
+
+		for(unsigned k=0; k<m_traces.size(); k++) {
+			TRACE		&t = m_traces[k];
+			NODE		&acc = t.m_acc;
+			uint32_t	v = (m_eff >> t.m_nshift) & t.m_mask;
+
+			if (fresh) {
+				acc.m_min = acc.m_max = acc.m_or = acc.m_and = v;
+				acc.m_changes = 0;
+			} else {
+				if (v < acc.m_min)
+					acc.m_min = v;
+				if (v > acc.m_max)
+					acc.m_max = v;
+				acc.m_or  |= v;
+				acc.m_and &= v;
+			}
+
+			if ((i > 0)&&(v != t.m_last))
+				acc.m_changes++;
+			t.m_last = v;
+
+			if (done)
+				push(t, 0, acc);
+		}
+	}
+
+	m_valid = nwords;
+	if (m_valid >= m_len)
+		finish();
+}
+// }}}
+
+// PYRAMID::finish
+// {{{
+void	PYRAMID::finish(void) {
+	for(unsigned k=0; k<m_traces.size(); k++) {
+		TRACE	&t = m_traces[k];
+
+		// Any partial block at the bottom
+		if (m_len & ((1u << m_lgbase)-1))
+			push(t, 0, t.m_acc);
+
+		// Any level with a block left over, without a partner, passes
+		// it up on its own--so the top level covers everything
+		for(unsigned l=0; l<t.m_levels.size(); l++) {
+			unsigned	n = t.m_levels[l].size();
+
+			if ((n > 1)&&(n & 1))
+				push(t, l+1, t.m_levels[l].back());
+		}
+	}
+}
+// }}}
+
+// PYRAMID::value
+// {{{
+uint32_t	PYRAMID::value(const TRACE &t, const uint32_t *data,
+		unsigned i) const {
+	if (m_compressed) {
+		// Back up over any run, to the data word it repeats
+		while((i > 0)&&(data[i] & 0x80000000))
+			i--;
+		if (data[i] & 0x80000000)
+			return 0;
+	} return (data[i] >> t.m_nshift) & t.m_mask;
+}
+// }}}
+
+// PYRAMID::scan
+// {{{
+void	PYRAMID::scan(const TRACE &t, const uint32_t *data, unsigned start,
+		unsigned end, NODE &acc, bool &any) const {
+	uint32_t	last, v;
+
+	if (start >= end)
+		return;
+
+	last = (start > 0) ? value(t, data, start-1) : 0;
+	v = value(t, data, start);
+	for(unsigned i=start; i<end; i++) {
+		if ((i > start)&&((!m_compressed)||((data[i] & 0x80000000)==0)))
+			v = (data[i] >> t.m_nshift) & t.m_mask;
+
+		if (!any) {
+			acc.m_min = acc.m_max = acc.m_or = acc.m_and = v;
+			acc.m_changes = 0;
+			any = true;
+		} else {
+			if (v < acc.m_min)
+				acc.m_min = v;
+			if (v > acc.m_max)
+				acc.m_max = v;
+			acc.m_or  |= v;
+			acc.m_and &= v;
+		}
+		if ((i > 0)&&(v != last))
+			acc.m_changes++;
+		last = v;
+	}
+}
+// }}}
+
+// PYRAMID::query
+// {{{
+PYRAMID::NODE	PYRAMID::query(unsigned trace, const uint32_t *data,
+		unsigned start, unsigned end) const {
+	const TRACE	&t = m_traces[trace];
+	const unsigned	blkmsk = (1u << m_lgbase)-1;
+	NODE		acc;
+	bool		any = false;
+	unsigned	pos;
+
+	memset(&acc, 0, sizeof(acc));
+	if (end > m_valid)
+		end = m_valid;
+	if (start >= end)
+		return acc;
+
+	pos = start;
+	while(pos < end) {
+		bool	used = false;
+
+		// Use the biggest block that starts here and fits
+		for(unsigned l=t.m_levels.size(); (l > 0)&&(!used); l--) {
+			unsigned	sh = m_lgbase + l-1;
+			uint64_t	bend;
+
+			if (pos & ((1ull << sh)-1))
+				continue;
+			if ((pos >> sh) >= t.m_levels[l-1].size())
+				continue;
+			bend = (uint64_t)pos + (1ull << sh);
+			if (bend > m_len)
+				bend = m_len;
+			if (bend > end)
+				continue;
+
+			const NODE &n = t.m_levels[l-1][pos >> sh];
+			if (!any) {
+				acc = n;
+				any = true;
+			} else
+				merge(acc, n);
+			pos  = (unsigned)bend;
+			used = true;
+		}
+
+		if (!used) {
+			// Nothing fits.  Scan up to the next block instead.
+			unsigned	next = (pos | blkmsk) + 1;
+
+			if ((next > end)||(next == 0))
+				next = end;
+			scan(t, data, pos, next, acc, any);
+			pos = next;
+		}
+	}
+
+	// Whether or not the first word changed, is outside the range
+	if ((start > 0)&&(value(t, data, start) != value(t, data, start-1)))
+		acc.m_changes--;
+
+	return acc;
+}
+// }}}
+
+// PYRAMID::save
+// {{{
+bool	PYRAMID::save(FILE *fp) const {
+	uint32_t	hdr[6];
+	bool		ok;
+
+	if (!complete())
+		return false;
+
+	hdr[0] = PYRAMID_VERSION;
+	hdr[1] = m_traces.size();
+	hdr[2] = m_len;
+	hdr[3] = m_lgbase;
+	hdr[4] = (m_compressed) ? 1:0;
+	hdr[5] = 0;
+
+	ok = (fwrite(PYRAMID_MAGIC, 1, 8, fp) == 8)
+		&& (fwrite(hdr, sizeof(uint32_t), 6, fp) == 6);
+	for(unsigned k=0; (ok)&&(k<m_traces.size()); k++) {
+		const TRACE	&t = m_traces[k];
+		uint32_t	thdr[3];
+
+		thdr[0] = t.m_nbits;
+		thdr[1] = t.m_nshift;
+		thdr[2] = t.m_levels.size();
+		ok = (fwrite(thdr, sizeof(uint32_t), 3, fp) == 3);
+		for(unsigned l=0; (ok)&&(l<t.m_levels.size()); l++) {
+			uint32_t	n = t.m_levels[l].size();
+
+			ok = (fwrite(&n, sizeof(n), 1, fp) == 1)
+				&& (fwrite(t.m_levels[l].data(), sizeof(NODE),
+						n, fp) == n);
+		}
+	}
+
+	return ok;
+}
+// }}}
+
+// PYRAMID::load
+// {{{
+bool	PYRAMID::load(FILE *fp) {
+	char		magic[8];
+	uint32_t	hdr[6];
+
+	clear();
+	if ((fread(magic, 1, 8, fp) != 8)
+			||(memcmp(magic, PYRAMID_MAGIC, 8) != 0)
+			||(fread(hdr, sizeof(uint32_t), 6, fp) != 6)
+			||(hdr[0] != PYRAMID_VERSION)
+			||(hdr[3] < 1)||(hdr[3] > 30)||(hdr[4] > 1)) {
+		fprintf(stderr, "ERR: Not a valid pyramid file\n");
+		return false;
+	}
+
+	setup(hdr[2], hdr[4] != 0, hdr[3]);
+	for(unsigned k=0; k<hdr[1]; k++) {
+		uint32_t	thdr[3];
+
+		if ((fread(thdr, sizeof(uint32_t), 3, fp) != 3)
+				||(thdr[0] < 1)||(thdr[0] > 32)||(thdr[1] > 31)
+				||(thdr[2] > 32)) {
+			fprintf(stderr, "ERR: Invalid trace in pyramid file\n");
+			clear();
+			return false;
+		}
+
+		add_trace(thdr[0], thdr[1]);
+		TRACE	&t = m_traces.back();
+		t.m_levels.resize(thdr[2]);
+		for(unsigned l=0; l<thdr[2]; l++) {
+			uint32_t	n;
+			uint64_t	most = ((uint64_t)m_len
+					+ (1ull << (m_lgbase+l))-1)
+					>> (m_lgbase+l);
+
+			if ((fread(&n, sizeof(n), 1, fp) != 1)||(n > most)) {
+				fprintf(stderr, "ERR: Invalid pyramid level\n");
+				clear();
+				return false;
+			}
+			t.m_levels[l].resize(n);
+			if (fread(t.m_levels[l].data(), sizeof(NODE), n, fp)
+					!= n) {
+				fprintf(stderr, "ERR: Pyramid file is truncated\n");
+				clear();
+				return false;
+			}
+		}
+	}
+
+	m_valid = m_len;
+	return true;
+}
+// }}}
@@ -0,0 +1,161 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	pyramid.h
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Defines PYRAMID, a multi-resolution summary of each trace of a
+//		capture: the minimum, maximum, OR, AND and number of changes
+//	across blocks of 2^k words, for every k.  This gives an overview of where
+//	the activity is in even the biggest capture, and answers questions about
+//	any range of it, without walking every word.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	PYRAMID_H
+#define	PYRAMID_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+/*
+ * PYRAMID
+ * {{{
+ * A level-of-detail summary of every trace of a capture.  Level zero
+ * summarizes each block of (1<<lgbase) words--the minimum, maximum, OR and
+ * AND of the trace's values across the block, and the number of times it
+ * changed.  Each level above summarizes pairs of blocks of the level below,
+ * up to a single block covering everything.  A query over any range of words
+ * then needs only O(log n) blocks, plus at most two partial blocks' worth of
+ * words at either end, no matter how long the range.
+ *
+ * The pyramid is built in one pass over the raw words, for all traces at
+ * once, and may be built incrementally as the words arrive.  For compressed
+ * scopes, a run-length word stands for the value it repeats.  The pyramid
+ * doesn't keep the words themselves--queries need them passed back in.
+ * }}}
+ */
+class	PYRAMID {
+public:
+	// The summary of a block of consecutive words of one trace.
+	// m_changes counts the words whose value differs from that of the
+	// word before--including the first word of the block, unless it's
+	// the first word of the capture.
+	struct	NODE {
+		uint32_t	m_min, m_max, m_or, m_and, m_changes;
+	};
+
+private:
+	struct	TRACE {
+		unsigned	m_nbits, m_nshift;
+		uint32_t	m_mask;
+		// m_levels[l] summarizes blocks of (1<<(m_lgbase+l)) words
+		std::vector<std::vector<NODE> >	m_levels;
+		// The block being built, and the last value seen
+		NODE		m_acc;
+		uint32_t	m_last;
+	};
+
+	std::vector<TRACE>	m_traces;
+	unsigned	m_len, m_valid, m_lgbase;
+	bool		m_compressed;
+	// The last data word seen, which any run-length words repeat
+	uint32_t	m_eff;
+
+	// Add a node to a level, adding their parent above if it completes
+	// a pair
+	void	push(TRACE &t, unsigned level, const NODE &n);
+
+	// Once all words have been seen, summarize any partial blocks left
+	// over, so the top level is a single block
+	void	finish(void);
+
+	// The value of trace t at word i
+	uint32_t	value(const TRACE &t, const uint32_t *data,
+				unsigned i) const;
+
+	// Summarize words start to end-1 of trace t, one word at a time
+	void	scan(const TRACE &t, const uint32_t *data, unsigned start,
+			unsigned end, NODE &acc, bool &any) const;
+public:
+	PYRAMID(void) : m_len(0), m_valid(0), m_lgbase(6),
+		m_compressed(false), m_eff(0) {}
+
+	// Forget everything, and get ready to summarize len words.  Blocks at
+	// the bottom level hold (1<<lgbase) words.
+	void	setup(unsigned len, bool compressed, unsigned lgbase = 6);
+
+	// Add a trace, ((word >> nshift) & ((1<<nbits)-1)).  All traces must
+	// be added before the first extend().
+	void	add_trace(unsigned nbits, unsigned nshift);
+
+	void	clear(void) { setup(0, false); m_traces.clear(); }
+
+	// Summarize data words up to (but not including) nwords.  Words
+	// before valid() have already been summarized and are skipped.
+	void	extend(const uint32_t *data, unsigned nwords);
+
+	// The number of words to be summarized, and that have been
+	unsigned	size(void) const { return m_len; }
+	unsigned	valid(void) const { return m_valid; }
+	bool		complete(void) const {
+		return (m_len > 0)&&(m_valid >= m_len);
+	}
+
+	unsigned	ntraces(void) const { return m_traces.size(); }
+	unsigned	nlevels(unsigned trace) const {
+		return m_traces[trace].m_levels.size();
+	}
+
+	// The number of words summarized by each block at level l.  (The last
+	// block of a level may cover fewer.)
+	unsigned	block_size(unsigned l) const { return 1u << (m_lgbase+l); }
+
+	// The blocks of level l of a trace, for zoomed out views
+	const std::vector<NODE>	&level(unsigned trace, unsigned l) const {
+		return m_traces[trace].m_levels[l];
+	}
+
+	// Summarize words start to end-1 of a trace.  data must be the same
+	// words the pyramid was built from.  m_changes counts the changes
+	// within the range, not counting the first word.  Returns all zeros
+	// for an empty range.
+	NODE	query(unsigned trace, const uint32_t *data,
+			unsigned start, unsigned end) const;
+
+	// Write the (complete) pyramid to a file, or read one back.  Like the
+	// .wbscap format, these files are in the host's byte order.  load()
+	// returns false if the file isn't a valid pyramid.
+	bool	save(FILE *fp) const;
+	bool	load(FILE *fp);
+};
+
+#endif	// PYRAMID_H
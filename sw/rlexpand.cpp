@@ -0,0 +1,224 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	rlexpand.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	SIMD and scalar kernels to expand the run-length encoded data
+//		of a compressed (wbscopc) scope into one value per clock.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "rlexpand.h"
+
+#if	defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define	RLEXPAND_X86
+#include <immintrin.h>
+#endif
+
+// The number of clocks a run word stands for
+static inline	uint64_t	run_length(uint32_t word) {
+	return (uint64_t)(word & 0x7fffffff) + 1;
+}
+
+// rle_expand_scalar
+// {{{
+uint64_t	rle_expand_scalar(uint32_t *out, uint64_t nout,
+		const uint32_t *data, unsigned nwords,
+		uint32_t &last, unsigned &nused) {
+	uint64_t	k = 0;
+	unsigned	i;
+
+	for(i=0; (i<nwords)&&(k<nout); i++) {
+		uint32_t	word = data[i];
+
+		if (word & 0x80000000) {
+			uint64_t	n = run_length(word);
+
+			if (n > nout - k)
+				n = nout - k;
+			for(uint64_t j=0; j<n; j++)
+				out[k++] = last;
+		} else
+			out[k++] = last = word;
+	}
+
+	nused = i;
+	return k;
+}
+// }}}
+
+#ifdef	RLEXPAND_X86
+// AVX2 kernel
+// {{{
+// Eight words at a time: if none of them are runs, they're copied as they
+// are.  Otherwise all eight are still stored, but only those before the first
+// run are kept--the rest will be written over.  Runs are then filled eight
+// clocks at a time with the repeated value.
+__attribute__((target("avx2")))
+static	uint64_t	avx2_expand(uint32_t *out, uint64_t nout,
+		const uint32_t *data, unsigned nwords,
+		uint32_t &last, unsigned &nused) {
+	uint64_t	k = 0;
+	unsigned	i = 0;
+
+	while((i < nwords)&&(k < nout)) {
+		uint32_t	word;
+
+		if ((i+8 <= nwords)&&(k+8 <= nout)) {
+			__m256i	v = _mm256_loadu_si256((const __m256i *)&data[i]);
+			unsigned runs = _mm256_movemask_ps(_mm256_castsi256_ps(v));
+
+			_mm256_storeu_si256((__m256i *)&out[k], v);
+			if (runs == 0) {
+				last = data[i+7];
+				i += 8;
+				k += 8;
+				continue;
+			} else if ((runs & 1) == 0) {
+				unsigned n = __builtin_ctz(runs);
+
+				last = data[i+n-1];
+				i += n;
+				k += n;
+			}
+		}
+
+		word = data[i++];
+		if (word & 0x80000000) {
+			uint64_t	n = run_length(word);
+			__m256i		b = _mm256_set1_epi32(last);
+
+			if (n > nout - k)
+				n = nout - k;
+			if (k + ((n+7) & -8) <= nout) {
+				// Round up to whole stores, overwriting
+				// whatever comes next
+				for(uint64_t j=0; j<n; j+=8)
+					_mm256_storeu_si256((__m256i *)&out[k+j], b);
+				k += n;
+			} else {
+				for(; n >= 8; n -= 8, k += 8)
+					_mm256_storeu_si256((__m256i *)&out[k], b);
+				for(; n > 0; n--)
+					out[k++] = last;
+			}
+		} else
+			out[k++] = last = word;
+	}
+
+	nused = i;
+	return k;
+}
+// }}}
+
+// SSE2 kernel
+// {{{
+// As above, but four words at a time
+static	uint64_t	sse2_expand(uint32_t *out, uint64_t nout,
+		const uint32_t *data, unsigned nwords,
+		uint32_t &last, unsigned &nused) {
+	uint64_t	k = 0;
+	unsigned	i = 0;
+
+	while((i < nwords)&&(k < nout)) {
+		uint32_t	word;
+
+		if ((i+4 <= nwords)&&(k+4 <= nout)) {
+			__m128i	v = _mm_loadu_si128((const __m128i *)&data[i]);
+			unsigned runs = _mm_movemask_ps(_mm_castsi128_ps(v));
+
+			_mm_storeu_si128((__m128i *)&out[k], v);
+			if (runs == 0) {
+				last = data[i+3];
+				i += 4;
+				k += 4;
+				continue;
+			} else if ((runs & 1) == 0) {
+				unsigned n = __builtin_ctz(runs);
+
+				last = data[i+n-1];
+				i += n;
+				k += n;
+			}
+		}
+
+		word = data[i++];
+		if (word & 0x80000000) {
+			uint64_t	n = run_length(word);
+			__m128i		b = _mm_set1_epi32(last);
+
+			if (n > nout - k)
+				n = nout - k;
+			if (k + ((n+3) & -4) <= nout) {
+				// Round up to whole stores, overwriting
+				// whatever comes next
+				for(uint64_t j=0; j<n; j+=4)
+					_mm_storeu_si128((__m128i *)&out[k+j], b);
+				k += n;
+			} else {
+				for(; n >= 4; n -= 4, k += 4)
+					_mm_storeu_si128((__m128i *)&out[k], b);
+				for(; n > 0; n--)
+					out[k++] = last;
+			}
+		} else
+			out[k++] = last = word;
+	}
+
+	nused = i;
+	return k;
+}
+// }}}
+
+static	bool	has_avx2(void) {
+	static	const bool	avx2 = __builtin_cpu_supports("avx2");
+	return avx2;
+}
+#endif
+
+// rle_expand
+// {{{
+uint64_t	rle_expand(uint32_t *out, uint64_t nout,
+		const uint32_t *data, unsigned nwords,
+		uint32_t &last, unsigned &nused) {
+#ifdef	RLEXPAND_X86
+	if (has_avx2())
+		return avx2_expand(out, nout, data, nwords, last, nused);
+	return sse2_expand(out, nout, data, nwords, last, nused);
+#else
+	return rle_expand_scalar(out, nout, data, nwords, last, nused);
+#endif
+}
+// }}}
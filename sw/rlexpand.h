@@ -0,0 +1,64 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	rlexpand.h
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Expands the run-length encoded data of a compressed scope into
+//		one value per clock, with SIMD kernels and a scalar reference.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	RLEXPAND_H
+#define	RLEXPAND_H
+
+#include <stdint.h>
+
+// Expand the run-length encoded words of a compressed (wbscopc) capture into
+// one value per clock.  Data words (top bit clear) are a value for one clock.
+// Run words (top bit set) repeat the last value for another
+// (word & 0x7fffffff)+1 clocks.  last is the value being repeated by any run
+// at data[0], and is updated to the last value seen.  At most nout values are
+// written to out, even if that means stopping in the middle of a run--but
+// anything in out beyond the values written, up to nout, may be overwritten.
+// Returns the number of values written, and sets nused to the number of words
+// consumed (a run that was cut short counts as consumed).
+//
+// rle_expand() uses SIMD instructions where the CPU has them: whole groups of
+// data words are copied at once, and runs are filled with broadcast stores.
+// rle_expand_scalar() is the plain C++ reference it must match.
+extern	uint64_t	rle_expand(uint32_t *out, uint64_t nout,
+			const uint32_t *data, unsigned nwords,
+			uint32_t &last, unsigned &nused);
+extern	uint64_t	rle_expand_scalar(uint32_t *out, uint64_t nout,
+			const uint32_t *data, unsigned nwords,
+			uint32_t &last, unsigned &nused);
+
+#endif	// RLEXPAND_H
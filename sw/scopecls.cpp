@@ -48,28 +48,224 @@
 #include <signal.h>
 #include <assert.h>
 #include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <algorithm>
 
 #include "devbus.h"
 #include "scopecls.h"
+#include "outbuf.h"
+#include "vcdbuf.h"
+#include "rlexpand.h"
+
+// When writing only VCD changes for a compressed scope, the trigger is kept in
+// the otherwise unused top bit of the data word
+#define	VCD_TRIGGER	0x80000000
+
+// The smallest number of words worth handing to a separate thread when
+// writing a VCD file in parallel
+#define	VCD_MIN_PARTITION	4096
+
+// index_offset
+// {{{
+// Where, in an out-of-core scope's backing file, the time index begins: on the
+// first page after nwords words of data
+static	size_t	index_offset(unsigned nwords) {
+	const size_t	pgmask = sysconf(_SC_PAGESIZE)-1;
+
+	return ((size_t)nwords * sizeof(DEVBUS::BUSW) + pgmask) & ~pgmask;
+}
+// }}}
+
+// elapsed
+// {{{
+// Returns the time from a to b, in seconds
+static	double	elapsed(const struct timespec &a, const struct timespec &b) {
+	return (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) * 1e-9;
+}
+// }}}
+
+// ctrl_scoplen()
+// {{{
+// The control register holds the log base 2 of the scope's memory length in
+// bits 24:20.  Convert it to a length in words, or zero if no scope is
+// present.  The shift is unsigned, so LGMEM=31 is still well defined.
+static	unsigned	ctrl_scoplen(DEVBUS::BUSW v) {
+	unsigned	lgln = (v>>20) & 0x1f;
+
+	return (lgln != 0) ? (1u<<lgln) : 0;
+}
+// }}}
 
 // SCOPE::ready()
 // {{{
 bool	SCOPE::ready() {
 	unsigned v;
+
+	join_reader();
 	v = m_fpga->readio(m_addr);
+	return ready(v);
+}
+
+bool	SCOPE::ready(DEVBUS::BUSW v) {
+	// Keep the most recent control word, so a capture saved by
+	// write_capture() records the state the scope stopped in
+	m_ctrl = v;
 	if (m_scoplen == 0) {
-		m_scoplen = (1<<((v>>20)&0x01f));
+		m_scoplen = ctrl_scoplen(v);
 		m_holdoff = (v & ((1<<20)-1));
 	} v = (v>>28)&6;
 	return (v==6);
 }
 // }}}
 
+// SCOPE::wait_ready()
+// {{{
+bool	SCOPE::wait_ready(int timeout_ms) {
+	struct timespec	start, now;
+	unsigned	delay_us = 100;
+	const unsigned	MAX_DELAY_US = 100000;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	m_wait_reads++;
+	if (ready())
+		return true;
+
+	while(1) {
+		double	remaining_ms = -1;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (timeout_ms >= 0) {
+			remaining_ms = timeout_ms - elapsed(start, now) * 1e3;
+			if (remaining_ms <= 0)
+				return false;
+		}
+
+		if (m_interrupts) {
+			// Sleep until an interrupt.  Since other interrupts
+			// may wake us, check the scope once we wake.
+			if (remaining_ms < 0)
+				m_fpga->wait();
+			else
+				m_fpga->usleep((unsigned)remaining_ms + 1);
+
+			if (m_fpga->poll()) {
+				m_fpga->clear();
+				m_wait_reads++;
+				if (ready())
+					return true;
+			} else if (remaining_ms >= 0) {
+				// Timed out.  Check one last time, in case
+				// the interrupt was missed
+				m_wait_reads++;
+				return ready();
+			}
+		} else {
+			// No interrupt.  Poll, backing off exponentially
+			// so we don't hog the bus from others who need it
+			if ((remaining_ms >= 0)&&(delay_us > remaining_ms*1e3))
+				delay_us = (unsigned)(remaining_ms*1e3) + 1;
+			::usleep(delay_us);
+			delay_us *= 2;
+			if (delay_us > MAX_DELAY_US)
+				delay_us = MAX_DELAY_US;
+
+			m_wait_reads++;
+			if (ready())
+				return true;
+		}
+	}
+}
+// }}}
+
+// SCOPE::rearm()
+// {{{
+void	SCOPE::rearm(unsigned holdoff) {
+	release_data();
+
+	// Writing to the control register with the top bit clear resets the
+	// scope, and sets the new holdoff
+	m_holdoff = holdoff & ((1<<20)-1);
+	m_fpga->writeio(m_addr, m_holdoff);
+}
+// }}}
+
+// SCOPE::capture_loop()
+// {{{
+unsigned	SCOPE::capture_loop(unsigned holdoff, unsigned ncaptures) {
+	struct timespec	start, stopped, armed, now;
+	unsigned	count = 0;
+	double		total_dead = 0.0, max_dead = 0.0;
+
+	if (scoplen() <= 4) {
+		printf("ERR: Scope has less than a minimum length.  Is it truly a scope?\n");
+		return 0;
+	}
+
+	// Allocate our capture buffer, once
+	if (!m_capbuf)
+		m_capbuf = new DEVBUS::BUSW[m_scoplen];
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	rearm(holdoff);
+
+	while((ncaptures == 0)||(count < ncaptures)) {
+		// Wait for the scope to trigger and stop
+		wait_ready();
+		clock_gettime(CLOCK_MONOTONIC, &stopped);
+
+		// Read it out, into our capture buffer
+		release_data();
+		m_data = m_capbuf;
+		start_readout();
+		join_reader();
+
+		// Re-arm the scope while we still have the data, so the next
+		// capture can begin while this one is processed.  (The
+		// holdoff doesn't change, so m_holdoff still describes the
+		// data we've just read.)
+		m_fpga->writeio(m_addr, m_holdoff);
+		clock_gettime(CLOCK_MONOTONIC, &armed);
+
+		m_dead_time = elapsed(stopped, armed);
+		total_dead += m_dead_time;
+		if (m_dead_time > max_dead)
+			max_dead = m_dead_time;
+
+		if (!on_capture(count++))
+			break;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (count > 0) {
+		double	dt = elapsed(start, now);
+
+		fprintf(stderr, "Captures:   %d in %.3f s (%.2f captures/s)\n",
+			count, dt, (dt > 0) ? count / dt : 0.0);
+		fprintf(stderr, "Dead time:  %.6f s mean, %.6f s max\n",
+			total_dead / count, max_dead);
+	}
+
+	return count;
+}
+// }}}
+
+// SCOPE::on_capture()
+// {{{
+bool	SCOPE::on_capture(unsigned capture_id) {
+	printf("CAPTURE #%d\n", capture_id);
+	print();
+	return true;
+}
+// }}}
+
 // SCOPE::decode_control()
 // {{{
 void	SCOPE::decode_control(void) {
 	unsigned	v;
 
+	join_reader();
 	v = m_fpga->readio(m_addr);
 	printf("\tCNTRL-REG:\t0x%08x\n", v);
 	printf("\t31. RESET:\t%s\n", (v&0x80000000)?"Ongoing":"Complete");
@@ -85,31 +281,24 @@ void	SCOPE::decode_control(void) {
 }
 // }}}
 
-// int SCOPE::scoplen()
+// unsigned SCOPE::scoplen()
 // {{{
-int	SCOPE::scoplen(void) {
-	unsigned	v, lgln;
+unsigned	SCOPE::scoplen(void) {
+	unsigned	v;
 
 	// If the scope length is zero, then the scope isn't present.
 	// We use a length of zero here to also represent whether or not we've
 	// looked up the length by reading from the scope.
 	if (m_scoplen == 0) {
 		v = m_fpga->readio(m_addr);
+		m_ctrl = v;
 		m_holdoff = (v & ((1<<20)-1));
 
 		// Since the length of the scope memory is a configuration
 		// parameter internal to the scope, we read it here to find
-		// out how the scope was configured.
-		lgln = (v>>20) & 0x1f;
-
-		// If the length is still zero, then there is no scope installed
-		if (lgln != 0) {
-			// Otherwise, the scope length contained in the device
-			// control register is the log base 2 of the actual
-			// length of what's in the FPGA.  Here, we just convert
-			// that to the actual length of the scope.
-			m_scoplen = (1<<lgln);
-		}
+		// out how the scope was configured.  If the length is still
+		// zero, then there is no scope installed.
+		m_scoplen = ctrl_scoplen(v);
 	// else we already know the length of the scope, and don't need to
 	// slow down to read that length from the device a second time.
 	} return m_scoplen;
@@ -133,69 +322,726 @@ void	SCOPE::rawread(void) {
 	}
 
 	// Now that we know the size of the scopes buffer, let's allocate a
-	// buffer to hold all this data
-	m_data = new DEVBUS::BUSW[m_scoplen];
+	// buffer to hold all this data--either in memory, or in a file
+	if (m_backing) {
+		m_data = map_backing();
+		if (!m_data)
+			return;
+	} else
+		m_data = new DEVBUS::BUSW[m_scoplen];
+
+	start_readout();
+}
+// }}}
+
+// SCOPE::start_readout
+// {{{
+void	SCOPE::start_readout(void) {
+	m_nvalid  = 0;
+	m_indexed = false;
+	m_readerr = false;
+	m_retried_chunks = 0;
+	m_retried_words  = 0;
+	clock_gettime(CLOCK_MONOTONIC, &m_rdstart);
+
+	// If we might need to resume the readout, find out now whether the
+	// scope can seek.  Asking writes to the data register, which on a
+	// scope that can't seek resets its read address--harmless before
+	// the readout, but not part way through it.
+	if (m_max_retries > 0)
+		probe_seek();
+
+	// If we've been asked to read in chunks, then hand the rest off to
+	// our reader thread and return.  Those who want the data will then
+	// need to wait_for_data() until it arrives.
+	if ((readout_chunk() > 0)&&(readout_chunk() < m_scoplen)) {
+		m_reading = true;
+		m_reader = std::thread(&SCOPE::chunked_read, this);
+		return;
+	}
 
+	// If we can retry, read in checkpoints, so that a bus error costs us
+	// no more than one checkpoint's worth of words.  If the retries fail,
+	// keep what we have, as chunked_read() does, rather than throwing
+	// the error at our caller.
+	if ((m_max_retries > 0)&&(m_checkpoint > 0)) {
+		unsigned	pos = 0;
+
+		try {
+			while(pos < m_scoplen) {
+				unsigned ln = m_scoplen - pos;
+
+				if (ln > m_checkpoint)
+					ln = m_checkpoint;
+				read_chunk(pos, ln);
+				pos += ln;
+				m_nvalid = pos;
+			}
+		} catch(BUSERR &e) {
+			fprintf(stderr, "ERR: Bus error at 0x%08x during scope readout, "
+				"%d of %d words read\n", e.addr, pos, m_scoplen);
+			m_readerr = true;
+		}
+	} else {
+		read_words(0, m_scoplen, m_data);
+		m_nvalid = m_scoplen;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &m_rddone);
+}
+// }}}
+
+// SCOPE::read_chunk
+// {{{
+// Read ln words of the buffer, starting pos words after the oldest, into
+// m_data.  If this fails with a bus error, wait a while and, if the readout
+// can be resumed from pos, try again--up to m_max_retries times, doubling the
+// wait each time.  Throws a BUSERR if the words can't be read.
+void	SCOPE::read_chunk(unsigned pos, unsigned ln) {
+	unsigned	delay_us = m_retry_delay_us;
+	const unsigned	MAX_DELAY_US = 100000;
+	DEVBUS::BUSW	erraddr = m_addr+4;
+
+	for(unsigned attempt=0; ; attempt++) {
+		try {
+			if (attempt > 0) {
+				if (!seek_words(pos)) {
+					fprintf(stderr, "ERR: The readout can't be resumed at word %d\n", pos);
+					break;
+				}
+				m_retried_chunks++;
+				m_retried_words += ln;
+			}
+
+			read_words(pos, ln, &m_data[pos]);
+
+			// Not every DEVBUS throws on a bus error
+			if (!m_fpga->bus_err())
+				return;
+			m_fpga->reset_err();
+			throw BUSERR(erraddr);
+		} catch(BUSERR &e) {
+			erraddr = e.addr;
+			if (attempt >= m_max_retries)
+				break;
+			fprintf(stderr, "ERR: Bus error at 0x%08x reading words %d-%d of the scope\n",
+				e.addr, pos, pos+ln-1);
+
+			::usleep(delay_us);
+			delay_us *= 2;
+			if (delay_us > MAX_DELAY_US)
+				delay_us = MAX_DELAY_US;
+		}
+	}
+
+	throw BUSERR(erraddr);
+}
+// }}}
+
+// SCOPE::seek_words
+// {{{
+bool	SCOPE::seek_words(unsigned pos) {
+	// Whether or not we can seek was found out before the readout began
+	if ((!m_seek_probed)||(!m_seekable))
+		return false;
+	m_fpga->writeio(m_addr+4, pos);
+	return true;
+}
+// }}}
+
+// SCOPE::read_words
+// {{{
+void	SCOPE::read_words(unsigned /* pos */, unsigned ln,
+		DEVBUS::BUSW *buf) {
 	// There are two means of reading from a DEVBUS interface: The first
 	// is a vector read, optimized so that the address and read command
 	// only needs to be sent once.  This is the optimal means.  However,
 	// if the bus isn't (yet) trustworthy, it may be more reliable to access
 	// the port by reading one register at a time--hence the second method.
-	// If the bus works, you'll want to use readz(): read scoplen values
+	// If the bus works, you'll want to use readz(): read ln values
 	// into the buffer, from the address WBSCOPEDATA, without incrementing
 	// the address each time (hence the 'z' in readz--for zero increment).
+	//
+	// Either way, the scope's read pointer advances by itself, so pos
+	// isn't needed here.
 	if (m_vector_read) {
-		m_fpga->readz(m_addr+4, m_scoplen, m_data);
+		m_fpga->readz(m_addr+4, ln, buf);
 	} else {
-		for(unsigned int i=0; i<m_scoplen; i++)
-			m_data[i] = m_fpga->readio(m_addr+4);
+		for(unsigned int i=0; i<ln; i++)
+			buf[i] = m_fpga->readio(m_addr+4);
+	}
+}
+// }}}
+
+// SCOPE::chunked_read
+// {{{
+// Runs on the reader thread.  Reads the scope's buffer readout_chunk() words at
+// a time, publishing the number of valid words after every chunk.  Since the
+// scope's read pointer only ever advances, the chunks are read in order and
+// each lands immediately after the last one in m_data.
+void	SCOPE::chunked_read(void) {
+	unsigned	pos = 0, released = 0, chunk = readout_chunk();
+
+	try {
+		while(pos < m_scoplen) {
+			unsigned ln = m_scoplen - pos;
+
+			if (ln > chunk)
+				ln = chunk;
+
+			read_chunk(pos, ln);
+			pos += ln;
+
+			{
+				std::lock_guard<std::mutex> lock(m_rdlock);
+				m_nvalid = pos;
+			} m_rdcv.notify_all();
+
+			// Don't keep what we've read in memory, if it has a
+			// file to go to
+			release_words(released, pos);
+		}
+	} catch(BUSERR &e) {
+		fprintf(stderr, "ERR: Bus error at 0x%08x during scope readout, "
+			"%d of %d words read\n", e.addr, pos, m_scoplen);
+		std::lock_guard<std::mutex> lock(m_rdlock);
+		m_readerr = true;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_rdlock);
+		clock_gettime(CLOCK_MONOTONIC, &m_rddone);
+		m_reading = false;
+	} m_rdcv.notify_all();
+}
+// }}}
+
+// SCOPE::wait_for_data
+// {{{
+unsigned	SCOPE::wait_for_data(unsigned nwords) {
+	if (!m_data)
+		return 0;
+	if (nwords > m_scoplen)
+		nwords = m_scoplen;
+
+	std::unique_lock<std::mutex> lock(m_rdlock);
+	m_rdcv.wait(lock, [this, nwords]{
+		return (m_nvalid >= nwords)||(!m_reading); });
+	return m_nvalid;
+}
+// }}}
+
+// SCOPE::readout_failed
+// {{{
+bool	SCOPE::readout_failed(void) const {
+	std::lock_guard<std::mutex> lock(m_rdlock);
+	return m_readerr;
+}
+// }}}
+
+// SCOPE::join_reader
+// {{{
+void	SCOPE::join_reader(void) {
+	if (m_reader.joinable())
+		m_reader.join();
+}
+// }}}
+
+// SCOPE::seekable
+// {{{
+bool	SCOPE::seekable(void) {
+	if (!m_seek_probed)
+		join_reader();
+	return probe_seek();
+}
+// }}}
+
+// SCOPE::probe_seek
+// {{{
+// As seekable(), but without waiting on the reader thread--since this is
+// called by start_readout(), before there is one.
+bool	SCOPE::probe_seek(void) {
+	if (!m_seek_probed) {
+		DEVBUS::BUSW	caps;
+
+		// A scope with OPT_SEEK answers the query with its
+		// capabilities, in place of the next control word.  Their
+		// LGMEM field is zero, as no control word's ever is, and bit
+		// 0 shows the scope can seek.  Any other scope just returns
+		// its control word.
+		m_fpga->writeio(m_addr+4, 0x80000000);
+		caps = m_fpga->readio(m_addr);
+
+		m_seekable = (((caps >> 20) & 0x1f) == 0) && (caps & 1);
+		m_seek_probed = true;
+	} return m_seekable;
+}
+// }}}
+
+// SCOPE::rewind
+// {{{
+void	SCOPE::rewind(void) {
+	if (seekable())
+		m_fpga->writeio(m_addr+4, 0);
+	else {
+		// Writing to the control register resets the read address.
+		// With the top bit set, this won't reset the scope, but the
+		// manual and disable trigger bits are still written--so write
+		// them back as they were.
+		DEVBUS::BUSW	v = m_fpga->readio(m_addr);
+
+		m_fpga->writeio(m_addr, 0x80000000 | (v & 0x0c000000));
 	}
 }
 // }}}
 
+// SCOPE::read_window
+// {{{
+unsigned	SCOPE::read_window(unsigned before, unsigned after) {
+	DEVBUS::BUSW	*buf;
+	unsigned	len, nw, holdoff;
+
+	release_data();
+
+	if (scoplen() <= 4) {
+		printf("ERR: Scope has less than a minimum length.  Is it truly a scope?\n");
+		return 0;
+	}
+
+	len = m_scoplen;
+	clock_gettime(CLOCK_MONOTONIC, &m_rdstart);
+	if (!m_compressed) {
+		// {{{
+		// Every word is a clock, so we know exactly which words we
+		// need: those around the trigger, m_holdoff words before the
+		// last
+		int64_t		trig = (int64_t)len - m_holdoff - 1,
+				first = trig - before,
+				last  = trig + after + 1;
+
+		if (first < 0)
+			first = 0;
+		if (last > len)
+			last = len;
+		if (first >= last) {
+			fprintf(stderr, "ERR: The trigger window is empty\n");
+			return 0;
+		}
+
+		unsigned	start = (unsigned)first;
+
+		nw      = (unsigned)(last - first);
+		holdoff = (unsigned)(last - 1 - trig);
+
+		if (seekable()) {
+			buf = new DEVBUS::BUSW[nw];
+			m_fpga->writeio(m_addr+4, start);
+			read_words(start, nw, buf);
+		} else {
+			// Read from the beginning, and keep only the window
+			buf = new DEVBUS::BUSW[last];
+			read_words(0, (unsigned)last, buf);
+			memmove(buf, &buf[start], nw * sizeof(DEVBUS::BUSW));
+		}
+		// }}}
+	} else {
+		// {{{
+		// The trigger is m_holdoff clocks before the last clock, but
+		// we can't tell how many words that is without reading them.
+		// Read from the end, backwards, doubling what we read until
+		// it reaches back far enough to cover the window.
+		std::vector<DEVBUS::BUSW>	tail;
+		uint64_t	total = 0, sclk = 0;
+		int64_t		trig = 0, lastclk;
+		unsigned	k = 0, ntail;
+
+		// Every word is at least one clock, so we'll never need more
+		// than m_holdoff+1+before words
+		uint64_t	most = (uint64_t)m_holdoff + 1 + before;
+
+		ntail = 64;
+		if (2*(uint64_t)before + 64 < len)
+			ntail = 2*before + 64;
+		else
+			ntail = len;
+		if (ntail > most)
+			ntail = (unsigned)most;
+		if (ntail > len)
+			ntail = len;
+		if (!seekable())
+			ntail = len;
+
+		while(1) {
+			std::vector<DEVBUS::BUSW>	more(ntail);
+			unsigned	nnew = ntail - (unsigned)tail.size();
+			bool		found = false;
+
+			if (nnew > 0) {
+				if (seekable())
+					m_fpga->writeio(m_addr+4, len - ntail);
+				read_words(len-ntail, nnew, more.data());
+				std::copy(tail.begin(), tail.end(),
+							more.begin() + nnew);
+				tail.swap(more);
+			}
+
+			// Count the clocks in what we have.  As in build_index(),
+			// a run at the very beginning of the buffer is only one.
+			total = 0;
+			for(unsigned j=0; j<ntail; j++) {
+				total++;
+				if ((tail[j] & 0x80000000)&&(j+len-ntail != 0))
+					total += tail[j] & 0x7fffffff;
+			}
+			trig = (int64_t)total - m_holdoff - 1;
+
+			// Look for the data word that starts the window
+			sclk = total;
+			for(unsigned j=ntail; j>0; j--) {
+				uint64_t	span = 1;
+
+				if ((tail[j-1] & 0x80000000)&&(j-1+len-ntail != 0))
+					span += tail[j-1] & 0x7fffffff;
+				sclk -= span;
+				if ((tail[j-1] & 0x80000000) == 0
+					&& (int64_t)sclk <= trig - (int64_t)before) {
+					k = j-1;
+					found = true;
+					break;
+				}
+			}
+
+			if (found)
+				break;
+			if (ntail >= len) {
+				// The window goes back to the start of the buffer
+				k = 0;
+				sclk = 0;
+				break;
+			} else if (ntail > len/2)
+				ntail = len;
+			else
+				ntail *= 2;
+		}
+
+		// Now drop any words after the window, shortening any run
+		// that crosses its end
+		lastclk = trig + after;
+		if (lastclk >= (int64_t)total)
+			lastclk = total - 1;
+		if (lastclk < (int64_t)sclk) {
+			fprintf(stderr, "ERR: The trigger window is empty\n");
+			return 0;
+		}
+
+		uint64_t	clk = sclk;
+		unsigned	end = k;
+		while((end < ntail)&&((int64_t)clk <= lastclk)) {
+			uint64_t	span = 1;
+
+			if ((tail[end] & 0x80000000)&&(end+len-ntail != 0))
+				span += tail[end] & 0x7fffffff;
+			if ((int64_t)(clk + span - 1) > lastclk)
+				tail[end] = 0x80000000
+					| (DEVBUS::BUSW)(lastclk - (int64_t)clk);
+			clk += span;
+			end++;
+		}
+
+		nw      = end - k;
+		holdoff = (unsigned)(lastclk - trig);
+		buf = new DEVBUS::BUSW[nw];
+		memcpy(buf, &tail[k], nw * sizeof(DEVBUS::BUSW));
+		// }}}
+	}
+
+	// Leave the scope ready to be read from the beginning again
+	rewind();
+
+	m_memlen     = m_scoplen;
+	m_memholdoff = m_holdoff;
+	m_scoplen    = nw;
+	m_holdoff    = holdoff;
+	m_data       = buf;
+	m_nvalid     = nw;
+	clock_gettime(CLOCK_MONOTONIC, &m_rddone);
+
+	return nw;
+}
+// }}}
+
+// SCOPE::release_data
+// {{{
+void	SCOPE::release_data(void) {
+	join_reader();
+	if (m_data) {
+		if (m_map) {
+			munmap(m_map, m_maplen);
+			m_map = NULL;
+			// If the traces were named from within the file,
+			// they need to go too
+			if (m_mapped_traces)
+				m_traces.clear();
+			m_mapped_traces = false;
+		} else if (m_data != m_capbuf)
+			delete[] m_data;
+	}
+
+	m_data    = NULL;
+	m_nvalid  = 0;
+	m_indexed = false;
+	m_tindex  = NULL;
+	m_tindex_buf.clear();
+	m_columns.clear();
+	m_colvalid = 0;
+	m_pyramid.clear();
+	m_edges.clear();
+	m_stats.clear();
+
+	// If we were holding a window, the scope is back to its full length
+	if (m_memlen) {
+		m_scoplen = m_memlen;
+		m_holdoff = m_memholdoff;
+		m_memlen  = 0;
+	}
+}
+// }}}
+
+// SCOPE::set_backing_file
+// {{{
+void	SCOPE::set_backing_file(const char *fname, unsigned segment_words) {
+	if (m_backing)
+		free(m_backing);
+	m_backing = (fname) ? strdup(fname) : NULL;
+
+	// Segments need to be a whole number of pages, and a power of two
+	m_segment = 4096;
+	while(m_segment < segment_words)
+		m_segment <<= 1;
+}
+// }}}
+
+// SCOPE::map_backing
+// {{{
+DEVBUS::BUSW	*SCOPE::map_backing(void) {
+	size_t	len;
+	void	*map;
+	int	fd;
+
+	// Room for the data, and for a compressed scope its time index
+	len = index_offset(m_scoplen);
+	if (m_compressed)
+		len += ((size_t)m_scoplen+1) * sizeof(uint64_t);
+
+	fd = open(m_backing, O_RDWR|O_CREAT|O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "ERR: Cannot open %s\n", m_backing);
+		return NULL;
+	} if (ftruncate(fd, len) != 0) {
+		fprintf(stderr, "ERR: Cannot make %s large enough\n", m_backing);
+		close(fd);
+		return NULL;
+	}
+
+	map = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "ERR: Cannot map %s\n", m_backing);
+		return NULL;
+	}
+
+	m_map    = map;
+	m_maplen = len;
+	m_mapped_traces = false;
+	return (DEVBUS::BUSW *)map;
+}
+// }}}
+
+// SCOPE::release_words
+// {{{
+void	SCOPE::release_words(unsigned &mark, unsigned upto) {
+	const uintptr_t	pgmask = sysconf(_SC_PAGESIZE)-1;
+	uintptr_t	start, end;
+
+	if ((!m_map)||(upto < mark + m_segment))
+		return;
+
+	// Only whole pages can be released
+	start = ((uintptr_t)&m_data[mark] + pgmask) & ~pgmask;
+	end   = ((uintptr_t)&m_data[upto]) & ~pgmask;
+	if (end > start)
+		madvise((void *)start, end-start, MADV_DONTNEED);
+
+	if (m_tindex) {
+		start = ((uintptr_t)&m_tindex[mark] + pgmask) & ~pgmask;
+		end   = ((uintptr_t)&m_tindex[upto]) & ~pgmask;
+		if (end > start)
+			madvise((void *)start, end-start, MADV_DONTNEED);
+	}
+
+	mark = upto;
+}
+// }}}
+
+// SCOPE::report_timing
+// {{{
+void	SCOPE::report_timing(FILE *fp) {
+	struct timespec	now;
+	double		rdtime, total;
+
+	if (!m_data)
+		return;
+
+	// The reader thread sets m_rddone as the very last thing it does, so
+	// wait for it to finish rather than just for the data
+	join_reader();
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	rdtime = elapsed(m_rdstart, m_rddone);
+	total  = elapsed(m_rdstart, now);
+	fprintf(fp, "Readout:    %8d words in %.3f s", m_nvalid, rdtime);
+	if (rdtime > 0)
+		fprintf(fp, " (%.0f words/s)", m_nvalid / rdtime);
+	fprintf(fp, "\nEnd-to-end: %.3f s\n", total);
+}
+// }}}
+
+// PRINTLINE
+// {{{
+// Tracks the line being printed by print(), so that the endl() hook can finish
+// each line and begin the next while decode_batch() is decoding a batch of
+// words.
+struct	PRINTLINE {
+	const DEVBUS::BUSW	*m_data;
+	unsigned		m_addr, m_last;
+	uint64_t		m_clk;
+	int64_t			m_offset;
+	bool			m_compressed;
+
+	// Start a line: the clock number (or address), and the raw word
+	void	prefix(OUTBUF &out) {
+		if (m_compressed)
+			out.dec(m_clk, 10);
+		else
+			out.dec(m_addr, 9);
+		out.put(' ');
+		out.hex(m_data[m_addr], 8);
+		out.put(": ", 2);
+	}
+
+	// End a line, marking the trigger, and start the next one if it's
+	// still within this batch
+	static	void	endl(OUTBUF &out, void *vctx) {
+		PRINTLINE	*ctx = (PRINTLINE *)vctx;
+
+		if ((ctx->m_compressed)
+				? ((int64_t)(ctx->m_clk+1) == ctx->m_offset)
+				: ((int64_t)ctx->m_addr == ctx->m_offset))
+			out.put(" <--- TRIGGER");
+		out.put('\n');
+
+		ctx->m_addr++;
+		ctx->m_clk++;
+		if (ctx->m_addr < ctx->m_last)
+			ctx->prefix(out);
+	}
+};
+// }}}
+
 // SCOPE::print
 // {{{
 void	SCOPE::print(void) {
-	unsigned long addrv = 0, alen;
-	int	offset;
+	uint64_t	addrv = 0, alen;
+	unsigned	nvalid, released = 0;
+	int64_t		offset;
+	OUTBUF		out(stdout);
+	PRINTLINE	line;
 
 	rawread();
+	if (!m_data)
+		return;
 
 	// Count how many values are in our (possibly compressed) buffer.
-	// If it weren't for the compression, this'd be m_scoplen
+	// If it weren't for the compression, this'd be m_scoplen.  This
+	// requires the whole buffer for a compressed scope, so we can only
+	// start on an uncompressed scope's data before it has all arrived.
+	if (m_compressed)
+		wait_for_data(m_scoplen);
 	alen = getaddresslen();
+	nvalid = 0;
 
 	// If the holdoff is zero, the triggered item is the very
 	// last one.
-	offset = alen - m_holdoff -1;
+	offset = (int64_t)alen - m_holdoff -1;
+
+	// Lines are printed in batches of consecutive words.  Each batch is
+	// decoded by one call to decode_batch(), with our hook on endl()
+	// finishing one line and starting the next.
+	line.m_data   = m_data;
+	line.m_offset = offset;
+	line.m_compressed = m_compressed;
+	out.set_endl_hook(PRINTLINE::endl, &line);
 
 	if(m_compressed) {
-		for(int i=0; i<(int)m_scoplen; i++) {
+		for(unsigned i=0; i<m_scoplen; ) {
+			unsigned	j;
+
 			if ((m_data[i]>>31)&1) {
 				addrv += (m_data[i]&0x7fffffff) + 1;
-				printf(" ** (+0x%08x = %8d)\n",
-					(m_data[i]&0x07fffffff),
-					(m_data[i]&0x07fffffff));
+				out.put(" ** (+0x");
+				out.hex(m_data[i]&0x07fffffff, 8);
+				out.put(" = ");
+				out.dec(m_data[i]&0x07fffffff, 8);
+				out.put(")\n");
+				i++;
 				continue;
 			}
-			printf("%10ld %08x: ", addrv++, m_data[i]);
-			decode(m_data[i]);
-			if ((int)addrv == offset)
-				printf(" <--- TRIGGER");
-			printf("\n");
+
+			// Find the run of data words starting here
+			for(j=i+1; (j<m_scoplen)&&(((m_data[j]>>31)&1)==0); j++)
+				;
+
+			line.m_addr = i;
+			line.m_last = j;
+			line.m_clk  = addrv;
+			line.prefix(out);
+			decode_batch(&m_data[i], j-i, out);
+
+			addrv += j-i;
+			i = j;
+			release_words(released, i);
 		}
 	} else {
-		for(int i=0; i<(int)m_scoplen; i++) {
-			if ((i>0)&&(m_data[i] == m_data[i-1])&&(i<(int)(m_scoplen-1))) {
+		for(unsigned i=0; i<m_scoplen; ) {
+			unsigned	j;
+
+			if (i >= nvalid) {
+				nvalid = wait_for_data(i+1);
+				if (i >= nvalid)
+					break;
+			}
+
+			if ((i>0)&&(m_data[i] == m_data[i-1])&&(i<m_scoplen-1)) {
 				if ((i>2)&&(m_data[i] != m_data[i-2]))
-					printf(" **** ****\n");
+					out.put(" **** ****\n");
+				i++;
 				continue;
-			} printf("%9d %08x: ", i, m_data[i]);
-			decode(m_data[i]);
+			}
+
+			// Find the run of words, starting here, that all need
+			// to be printed
+			for(j=i+1; (j<nvalid)&&((m_data[j] != m_data[j-1])
+						||(j==m_scoplen-1)); j++)
+				;
 
-			if (i == offset)
-				printf(" <--- TRIGGER");
-			printf("\n");
+			line.m_addr = i;
+			line.m_last = j;
+			line.m_clk  = i;
+			line.prefix(out);
+			decode_batch(&m_data[i], j-i, out);
+
+			i = j;
+			release_words(released, i);
 		}
 	}
 }
@@ -204,19 +1050,24 @@ void	SCOPE::print(void) {
 // SCOPE::write_trace_timescale
 // {{{
 void	SCOPE::write_trace_timescale(FILE *fp) {
-	fprintf(fp, "$timescale 1ns $end\n\n");
+	TIMEBASE	tb(vcd_rate());
+
+	fprintf(fp, "$timescale %s $end\n\n", tb.timescale());
 }
 // }}}
 
 // SCOPE::write_trace_timezero
 // {{{
-void	SCOPE::write_trace_timezero(FILE *fp, int offset) {
-	double		dwhen;
-	long		when_ns;
-
-	dwhen = 1.0/((double)m_clkfreq_hz) * (offset);
-	when_ns = (unsigned long)(dwhen * 1e9);
-	fprintf(fp, "$timezero %ld $end\n\n", -when_ns);
+void	SCOPE::write_trace_timezero(FILE *fp, int64_t offset) {
+	TIMEBASE	tb(vcd_rate());
+	int64_t		when;
+
+	// The time of the trigger's clock, in our timescale's units
+	if (offset >= 0)
+		when = tb.time((uint64_t)offset * vcd_steps());
+	else
+		when = -(int64_t)tb.time((uint64_t)(-offset) * vcd_steps());
+	fprintf(fp, "$timezero %lld $end\n\n", (long long)-when);
 }
 // }}}
 
@@ -224,7 +1075,7 @@ void	SCOPE::write_trace_timezero(FILE *fp, int offset) {
 
 // SCOPE::write_trace_header
 // {{{
-void	SCOPE::write_trace_header(FILE *fp, int offset) {
+void	SCOPE::write_trace_header(FILE *fp, int64_t offset) {
 	time_t	now;
 
 	time(&now);
@@ -240,7 +1091,8 @@ void	SCOPE::write_trace_header(FILE *fp, int offset) {
 		fprintf(fp, "  $var wire %2d \'R _raw_data [%d:0] $end\n", 31,
 			30);
 	} else {
-		fprintf(fp, "  $var wire %2d \'C clk $end\n", 1);
+		if (!m_vcd_clockless)
+			fprintf(fp, "  $var wire %2d \'C clk $end\n", 1);
 		fprintf(fp, "  $var wire %2d \'R _raw_data [%d:0] $end\n", 32,
 			31);
 	}
@@ -248,10 +1100,13 @@ void	SCOPE::write_trace_header(FILE *fp, int offset) {
 	// Add in a fake _trigger variable to the VCD file we are producing,
 	// so we can see when our trigger took place (assuming the holdoff is
 	// such that it is within the collect)
-	fprintf(fp, "  $var wire %2d \'T _trigger $end\n", 1);
+	if ((m_vcd_clockless)&&(!m_compressed))
+		fprintf(fp, "  $var event %2d \'T _trigger $end\n", 1);
+	else
+		fprintf(fp, "  $var wire %2d \'T _trigger $end\n", 1);
 
 	for(unsigned i=0; i<m_traces.size(); i++) {
-		TRACEINFO *info = m_traces[i];
+		const TRACEINFO *info = &m_traces[i];
 		fprintf(fp, "  $var wire %2d %s %s",
 			info->m_nbits, info->m_key, info->m_name);
 		if ((info->m_nbits > 1)&&(NULL == strchr(info->m_name, '[')))
@@ -273,48 +1128,101 @@ void	SCOPE::write_binary_trace(FILE *fp, const int nbits, unsigned val,
 		fprintf(fp, "%d%s\n", val&1, str);
 		return;
 	}
-	if ((unsigned)nbits < sizeof(val)*8)
-		val &= ~(-1<<nbits);
-	fputs("b", fp);
+	val &= (nbits >= 32) ? ~0u : ((1u<<nbits)-1);
+
+	// Build the binary string first, then write it all at once
+	char	tmp[8*sizeof(val)+2], *ptr = tmp;
+	*ptr++ = 'b';
 	for(int i=0; i<nbits; i++)
-		fprintf(fp, "%d", (val>>(nbits-1-i))&1);
-	fprintf(fp, " %s\n", str);
+		*ptr++ = '0' + ((val>>(nbits-1-i))&1);
+	*ptr = '\0';
+	fprintf(fp, "%s %s\n", tmp, str);
 }
 // }}}
 
 // SCOPE::write_binary
 // {{{
-void	SCOPE::write_binary_trace(FILE *fp, TRACEINFO *info, unsigned value) {
+void	SCOPE::write_binary_trace(FILE *fp, const TRACEINFO *info,
+		unsigned value) {
 	write_binary_trace(fp, info->m_nbits, (value>>info->m_nshift),
 		info->m_key);
 }
+
+void	SCOPE::write_binary_trace(VCDBUF &out, const TRACEINFO *info,
+		unsigned value) {
+	out.binary(info->m_nbits, (value>>info->m_nshift), info->m_key);
+}
+// }}}
+
+// SCOPE::write_vcd_changes
+// {{{
+// Write to the VCD file only those values within word that have changed since
+// last_word, or all of them if this is the first sample.  For a 31-bit
+// (compressed) word, bit 31 holds the trigger.
+void	SCOPE::write_vcd_changes(VCDBUF &out, const int nbits, unsigned addr,
+		unsigned word, unsigned last_word, bool first) {
+	unsigned	diff = word ^ last_word;
+
+	if (nbits < 32) {
+		if ((first)||(diff & VCD_TRIGGER))
+			out.put((word & VCD_TRIGGER) ? "1\'T\n" : "0\'T\n");
+		word &= ~VCD_TRIGGER;
+		diff &= ~VCD_TRIGGER;
+	}
+
+	if ((!first)&&(diff == 0))
+		return;
+
+	out.binary(nbits, word, "\'R");
+
+	const TRACEINFO	*info = m_traces.data();
+	for(unsigned k=0; k<m_traces.size(); k++, info++) {
+		if ((first)||((diff >> info->m_nshift) & info->m_mask))
+			out.binary(info->m_nbits, trace_value(k, addr),
+				info->m_key);
+	}
+}
 // }}}
 
 // SCOPE::register_trace
 // {{{
 void	SCOPE::register_trace(const char *name,
 		unsigned nbits, unsigned shift) {
-	TRACEINFO	*info = new TRACEINFO;
-	int	nkey = m_traces.size();
-
-	info->m_name   = name;
-	info->m_nbits  = nbits;
-	info->m_nshift = shift;
-
-	info->m_key[0] = 'v';
-	if (nkey < 26)
-		info->m_key[1] = 'a'+nkey;
-	else if (nkey < 26+26)
-		info->m_key[1] = 'A'+nkey-26;
-	else // if (nkey < 26+26+10)	// Should never happen
-		info->m_key[1] = '0'+nkey-26-26;
-	info->m_key[2] = '\0';
-	info->m_key[3] = '\0';
+	TRACEINFO	info;
+
+	info.m_name   = name;
+	info.m_nbits  = nbits;
+	info.m_nshift = shift;
+	info.m_mask   = (nbits >= 32) ? 0xffffffff : ((1u << nbits)-1);
+	vcd_identifier(m_traces.size(), info.m_key);
 
 	m_traces.push_back(info);
 }
 // }}}
 
+// SCOPE::vcd_identifier
+// {{{
+void	SCOPE::vcd_identifier(unsigned id, char *key) {
+	// The first character can be any printable character but the quote
+	char	ch = '!' + (id % 93);
+
+	if (ch >= '\'')
+		ch++;
+	*key++ = ch;
+	id /= 93;
+
+	// Any further characters may be any of the 94 printable characters.
+	// Counting them from one, rather than zero, keeps every identifier
+	// unique--"!" and "!!" are different signals.
+	while(id > 0) {
+		id--;
+		*key++ = '!' + (id % 94);
+		id /= 94;
+	}
+	*key = '\0';
+}
+// }}}
+
 /*
  * SCOPE::getaddresslen(void)
  * {{{
@@ -322,133 +1230,729 @@ void	SCOPE::register_trace(const char *name,
  * scope, this is just the size of hte scope.  For the compressed scope ... this
  * is a touch longer.
  */
-unsigned	SCOPE::getaddresslen(void) {
+uint64_t	SCOPE::getaddresslen(void) {
 	// Find the offset to the trigger
 	if (m_compressed) {
-		// First, find the overall length
-		//
 		// If we are compressed, then *every* item increments
-		// the address length
-		unsigned alen = m_scoplen;
-		//
-		// Some items increment it more.
-		for(int i=0; i<(int)m_scoplen; i++) {
-			if ((m_data[i]&0x80000000)&&(i!=0))
-				alen += m_data[i] & 0x7fffffff;
+		// the address length, and some items increment it more.
+		// This is all captured by the time index.
+		build_index();
+		if (!m_indexed)
+			return 0;
+		return m_tindex[m_scoplen];
+	} return m_scoplen;
+}
+// }}}
+
+/*
+ * SCOPE::build_index
+ * {{{
+ * Walk the compressed buffer once, building a prefix sum of the number of
+ * clocks represented by each word.  Data words represent a single clock.
+ * Run-length words represent the prior value being repeated for an
+ * additional (m_data[i]&0x7fffffff) clocks--save for a run-length word at the
+ * very beginning, where we don't know what was being repeated, which is
+ * counted as one clock only.
+ */
+void	SCOPE::build_index(void) {
+	uint64_t	clk = 0;
+
+	if ((m_indexed)||(!m_compressed)||(!m_data))
+		return;
+	if (wait_for_data(m_scoplen) < m_scoplen)
+		return;
+
+	// An out-of-core scope keeps its index in its backing file, after
+	// the data
+	uint64_t	*index;
+	unsigned	released = 0;
+
+	if (m_map)
+		index = (uint64_t *)((char *)m_data + index_offset(m_scoplen));
+	else {
+		m_tindex_buf.resize(m_scoplen+1);
+		index = m_tindex_buf.data();
+	}
+	m_tindex = index;
+
+	for(unsigned i=0; i<m_scoplen; i++) {
+		index[i] = clk;
+		clk++;
+		if ((m_data[i]&0x80000000)&&(i!=0))
+			clk += m_data[i] & 0x7fffffff;
+		if ((i & (m_segment-1)) == m_segment-1)
+			release_words(released, i+1);
+	} index[m_scoplen] = clk;
+
+	m_indexed = true;
+}
+// }}}
+
+/*
+ * SCOPE::sample_time
+ * {{{
+ */
+uint64_t	SCOPE::sample_time(unsigned addr) {
+	if (!m_compressed)
+		return addr;
+
+	build_index();
+	if (!m_indexed)
+		return 0;
+	if (addr > m_scoplen)
+		addr = m_scoplen;
+	return m_tindex[addr];
+}
+// }}}
+
+/*
+ * SCOPE::sample_index
+ * {{{
+ * A binary search through the time index for the last word starting at or
+ * before clk.
+ */
+unsigned	SCOPE::sample_index(uint64_t clk) {
+	if (!m_compressed)
+		return (clk < m_scoplen) ? (unsigned)clk : m_scoplen;
+
+	build_index();
+	if ((!m_indexed)||(clk >= m_tindex[m_scoplen]))
+		return m_scoplen;
+
+	// upper_bound finds the first word starting *after* clk, so the
+	// word we want is the one before it
+	return (unsigned)(std::upper_bound(m_tindex, m_tindex+m_scoplen, clk)
+		- m_tindex) - 1;
+}
+// }}}
+
+/*
+ * SCOPE::value_at
+ * {{{
+ */
+DEVBUS::BUSW	SCOPE::value_at(uint64_t clk) {
+	unsigned	addr = sample_index(clk);
+
+	if (addr >= m_scoplen)
+		return 0;
+	if (!m_compressed)
+		return m_data[addr];
+
+	// Run-length words repeat the last data value.  Back up to find it.
+	while((addr > 0)&&(m_data[addr] & 0x80000000))
+		addr--;
+	if (m_data[addr] & 0x80000000)
+		// The buffer starts with a run, we don't know its value
+		return 0;
+	return m_data[addr];
+}
+// }}}
+
+/*
+ * SCOPE::expand
+ * {{{
+ */
+uint64_t	SCOPE::expand(DEVBUS::BUSW *out, uint64_t first, uint64_t nclks) {
+	uint64_t	alen, skip, span, k;
+	unsigned	addr, nused;
+	DEVBUS::BUSW	last = 0, val;
+
+	if ((!m_data)||(wait_for_data(m_scoplen) < m_scoplen))
+		return 0;
+
+	alen = getaddresslen();
+	if (first >= alen)
+		return 0;
+	if (nclks > alen - first)
+		nclks = alen - first;
+
+	if (!m_compressed) {
+		memcpy(out, &m_data[first], nclks * sizeof(DEVBUS::BUSW));
+		return nclks;
+	}
+
+	// Start with whatever's left of the word holding the first clock.
+	// It may be a run, part of which is before first--or the run at the
+	// very start of the buffer, which only counts as one clock.  Either
+	// way, the index knows its length.
+	addr = sample_index(first);
+	skip = first - m_tindex[addr];
+	span = m_tindex[addr+1] - m_tindex[addr];
+	if (m_data[addr] & 0x80000000) {
+		// Find the value being repeated
+		for(unsigned a=addr; a>0; a--)
+			if ((m_data[a-1] & 0x80000000) == 0) {
+				last = m_data[a-1];
+				break;
+			}
+		val = last;
+	} else
+		val = last = m_data[addr];
+
+	for(k=0; (k < span - skip)&&(k < nclks); k++)
+		out[k] = val;
+	addr++;
+
+	// The SIMD kernel can take it from here
+	if (k < nclks)
+		k += rle_expand(&out[k], nclks - k, &m_data[addr],
+				m_scoplen - addr, last, nused);
+	return k;
+}
+// }}}
+
+/*
+ * SCOPE::build_columns
+ * {{{
+ */
+void	SCOPE::build_columns(void) {
+	if (!m_data)
+		return;
+	if (m_traces.size() == 0)
+		define_traces();
+	if ((m_colvalid >= m_scoplen)&&(m_columns.size() == m_traces.size()))
+		return;
+
+	extend_columns(wait_for_data(m_scoplen));
+}
+// }}}
+
+/*
+ * SCOPE::extend_columns
+ * {{{
+ * Extends the columns to cover the first nwords of m_data.  Uncompressed
+ * scopes may do this a chunk at a time while the data is still arriving.  A
+ * compressed scope's columns are built all at once, since each run-length
+ * word needs the last data word before it.
+ */
+void	SCOPE::extend_columns(unsigned nwords) {
+	if (m_columns.size() != m_traces.size()) {
+		m_columns.resize(m_traces.size());
+		for(unsigned k=0; k<m_traces.size(); k++)
+			m_columns[k].setup(m_scoplen, m_traces[k].m_nbits,
+				m_traces[k].m_nshift);
+		m_colvalid = 0;
+	}
+
+	if (nwords > m_scoplen)
+		nwords = m_scoplen;
+	if (nwords <= m_colvalid)
+		return;
+
+	if (m_compressed) {
+		std::vector<uint32_t>	eff(m_scoplen);
+		uint32_t		last = 0;
+
+		if (wait_for_data(m_scoplen) < m_scoplen)
+			return;
+		for(unsigned i=0; i<m_scoplen; i++) {
+			if ((m_data[i] & 0x80000000)==0)
+				last = m_data[i];
+			eff[i] = last;
 		}
 
-		return alen;
-	} return m_scoplen;
+		for(unsigned k=0; k<m_columns.size(); k++)
+			m_columns[k].fill(eff.data(), 0, m_scoplen);
+		m_colvalid = m_scoplen;
+	} else {
+		for(unsigned k=0; k<m_columns.size(); k++)
+			m_columns[k].fill(m_data, m_colvalid, nwords);
+		m_colvalid = nwords;
+	}
 }
 // }}}
 
 /*
- * SCOPE::define_traces
+ * SCOPE::pyramid
  * {{{
- * This is a user stub.  User programs should define this function.
  */
-void	SCOPE::define_traces(void) {}
+const PYRAMID	&SCOPE::pyramid(void) {
+	unsigned	released = 0;
+
+	if (!m_data)
+		return m_pyramid;
+	if (m_traces.size() == 0)
+		define_traces();
+	if ((m_pyramid.complete())&&(m_pyramid.size() == m_scoplen)
+			&&(m_pyramid.ntraces() == m_traces.size()))
+		return m_pyramid;
+
+	m_pyramid.clear();
+	m_pyramid.setup(m_scoplen, m_compressed);
+	for(unsigned k=0; k<m_traces.size(); k++)
+		m_pyramid.add_trace(m_traces[k].m_nbits, m_traces[k].m_nshift);
+
+	// Summarize the data a segment at a time, as it arrives
+	while(m_pyramid.valid() < m_scoplen) {
+		unsigned	upto = m_pyramid.valid() + m_segment, nv;
+
+		if (upto > m_scoplen)
+			upto = m_scoplen;
+		nv = wait_for_data(upto);
+		if (nv <= m_pyramid.valid())
+			break;
+		m_pyramid.extend(m_data, nv);
+		release_words(released, nv);
+	}
+
+	return m_pyramid;
+}
 // }}}
 
-// SCOPE::writevcd (FILE *fp)
-// {{{
-void	SCOPE::writevcd(FILE *fp) {
-	unsigned	alen;
-	int	offset = 0;
+/*
+ * SCOPE::summary
+ * {{{
+ */
+PYRAMID::NODE	SCOPE::summary(unsigned k, uint64_t first, uint64_t nclks) {
+	PYRAMID::NODE	none;
+	uint64_t	last;
+
+	memset(&none, 0, sizeof(none));
+	if ((nclks == 0)||(k >= pyramid().ntraces())
+			||(!m_pyramid.complete()))
+		return none;
+
+	last = first + nclks - 1;
+	if (last < first)
+		last = UINT64_MAX - 1;
+	return m_pyramid.query(k, m_data, sample_index(first),
+			(last >= getaddresslen()) ? m_scoplen
+			: sample_index(last)+1);
+}
+// }}}
+
+/*
+ * SCOPE::write_pyramid
+ * {{{
+ */
+bool	SCOPE::write_pyramid(const char *fname) {
+	FILE	*fp;
+	bool	ok;
+
+	if (!pyramid().complete())
+		return false;
+
+	fp = fopen(fname, "wb");
+	if (!fp) {
+		fprintf(stderr, "ERR: Cannot open %s for writing\n", fname);
+		return false;
+	}
+
+	ok = m_pyramid.save(fp);
+	if (fclose(fp) != 0)
+		ok = false;
+	if (!ok)
+		fprintf(stderr, "ERR: Could not write the pyramid to %s\n",
+			fname);
+	return ok;
+}
+// }}}
+
+/*
+ * SCOPE::read_pyramid
+ * {{{
+ */
+bool	SCOPE::read_pyramid(const char *fname) {
+	FILE	*fp;
+	bool	ok;
+
+	if (wait_for_data(m_scoplen) == 0)
+		return false;
+	if (m_traces.size() == 0)
+		define_traces();
+
+	fp = fopen(fname, "rb");
+	if (!fp) {
+		fprintf(stderr, "ERR: Cannot open %s\n", fname);
+		return false;
+	}
+
+	ok = m_pyramid.load(fp);
+	fclose(fp);
+
+	// Make sure it's the pyramid of this capture
+	if ((ok)&&((m_pyramid.size() != m_scoplen)
+			||(m_pyramid.ntraces() != m_traces.size()))) {
+		fprintf(stderr, "ERR: %s doesn\'t match this capture\n",
+			fname);
+		ok = false;
+	}
+	if (!ok)
+		m_pyramid.clear();
+
+	return ok;
+}
+// }}}
+
+/*
+ * SCOPE::edges
+ * {{{
+ */
+const EDGEIDX	&SCOPE::edges(void) {
+	unsigned	released = 0;
 
 	if (!m_data)
-		rawread();
+		return m_edges;
+	if (m_traces.size() == 0)
+		define_traces();
+	if ((m_edges.complete())&&(m_edges.size() == m_scoplen)
+			&&(m_edges.ntraces() == m_traces.size()))
+		return m_edges;
+
+	m_edges.clear();
+	m_edges.setup(m_scoplen, m_compressed);
+	for(unsigned k=0; k<m_traces.size(); k++)
+		m_edges.add_trace(m_traces[k].m_nbits, m_traces[k].m_nshift);
+
+	// Index the data a segment at a time, as it arrives
+	while(m_edges.valid() < m_scoplen) {
+		unsigned	upto = m_edges.valid() + m_segment, nv;
+
+		if (upto > m_scoplen)
+			upto = m_scoplen;
+		nv = wait_for_data(upto);
+		if (nv <= m_edges.valid())
+			break;
+		m_edges.extend(m_data, nv);
+		release_words(released, nv);
+	}
 
-	// If the traces haven't yet been defined, then define them now.
-	if (m_traces.size()==0)
+	return m_edges;
+}
+// }}}
+
+/*
+ * SCOPE::trace_id
+ * {{{
+ */
+int	SCOPE::trace_id(const char *name) {
+	if (m_traces.size() == 0)
 		define_traces();
+	for(unsigned k=0; k<m_traces.size(); k++)
+		if (strcmp(m_traces[k].m_name, name) == 0)
+			return (int)k;
+	return -1;
+}
+// }}}
 
-	// Count how many values are in our (possibly compressed) buffer.
-	// If it weren't for the compression, this'd be m_scoplen
-	alen = getaddresslen();
+/*
+ * SCOPE::search
+ * {{{
+ */
+void	SCOPE::search(const SEARCH::TERM &term,
+		std::vector<SEARCH::MATCH> &matches) {
+	if ((!m_data)||(wait_for_data(m_scoplen) < m_scoplen))
+		return;
+	if ((m_compressed)&&(getaddresslen() == 0))
+		return;
 
-	// If the holdoff is zero, the triggered item is the very
-	// last one.
-	offset = alen - m_holdoff -1;
+	SEARCH(m_data, m_scoplen, m_compressed, m_tindex).find(term, matches);
+}
 
-	// Write the file header.
-	write_trace_header(fp, offset);
+void	SCOPE::search(const std::vector<SEARCH::STEP> &seq,
+		std::vector<SEARCH::MATCH> &matches) {
+	if ((!m_data)||(wait_for_data(m_scoplen) < m_scoplen))
+		return;
+	if ((m_compressed)&&(getaddresslen() == 0))
+		return;
+
+	SEARCH(m_data, m_scoplen, m_compressed, m_tindex).find(seq, matches);
+}
+// }}}
+
+/*
+ * SCOPE::latency
+ * {{{
+ */
+void	SCOPE::latency(LATENCY &lat, const SEARCH::TERM &start,
+		const SEARCH::TERM &end, LATENCY::PAIRING pairing) {
+	lat.set_clkfreq_hz(m_clkfreq_hz);
+	if ((!m_data)||(wait_for_data(m_scoplen) < m_scoplen))
+		return;
+	if ((m_compressed)&&(getaddresslen() == 0))
+		return;
+
+	lat.measure(SEARCH(m_data, m_scoplen, m_compressed, m_tindex),
+		start, end, pairing);
+}
+// }}}
+
+/*
+ * SCOPE::stats
+ * {{{
+ */
+const TRACESTATS	&SCOPE::stats(void) {
+	unsigned	released = 0;
+
+	if (!m_data)
+		return m_stats;
+	if (m_traces.size() == 0)
+		define_traces();
+	if ((m_stats.complete())&&(m_stats.size() == m_scoplen)
+			&&(m_stats.ntraces() == m_traces.size()))
+		return m_stats;
+
+	m_stats.clear();
+	m_stats.setup(m_scoplen, m_compressed);
+	for(unsigned k=0; k<m_traces.size(); k++)
+		m_stats.add_trace(m_traces[k].m_nbits, m_traces[k].m_nshift);
+
+	// Count the data a segment at a time, as it arrives
+	while(m_stats.valid() < m_scoplen) {
+		unsigned	upto = m_stats.valid() + m_segment, nv;
+
+		if (upto > m_scoplen)
+			upto = m_scoplen;
+		nv = wait_for_data(upto);
+		if (nv <= m_stats.valid())
+			break;
+		m_stats.extend(m_data, nv);
+		release_words(released, nv);
+	}
+
+	return m_stats;
+}
+// }}}
+
+/*
+ * SCOPE::write_stats
+ * {{{
+ */
+void	SCOPE::write_stats(FILE *fp) {
+	std::vector<const char *>	names;
+
+	stats();
+	for(unsigned k=0; k<m_traces.size(); k++)
+		names.push_back(m_traces[k].m_name);
+	m_stats.write_json(fp, names);
+}
+// }}}
+
+/*
+ * SCOPE::decode_batch
+ * {{{
+ * The default: just call decode() for each word.  Since decode() writes to
+ * stdout directly, anything already in our buffer needs to go out first.
+ */
+void	SCOPE::decode_batch(const DEVBUS::BUSW *v, size_t n, OUTBUF &out) {
+	for(size_t k=0; k<n; k++) {
+		out.flush();
+		decode(v[k]);
+		out.endl();
+	}
+}
+// }}}
+
+/*
+ * SCOPE::define_traces
+ * {{{
+ * This is a user stub.  User programs should define this function.
+ */
+void	SCOPE::define_traces(void) {}
+// }}}
+
+// SCOPE::vcd_state
+// {{{
+// Find the state writevcd() would be in upon reaching word start, so that
+// writing can start from there rather than from the beginning.
+void	SCOPE::vcd_state(unsigned start, VCDSTATE &st, const TIMEBASE &tb,
+		uint64_t alen, int64_t offset) {
+	if (!m_compressed) {
+		st.m_addrv = start;
+		st.m_first = (start == 0);
+		st.m_last_word    = (start > 0) ? m_data[start-1] : 0;
+		st.m_last_trigger = (start > 0)&&((int64_t)start-1 == offset);
+		tb.seek((uint64_t)start * vcd_steps(), st.m_now);
+		return;
+	}
 
+	// A run at the very start of the buffer doesn't advance the clock
+	st.m_addrv = (start == 0) ? 0
+			: sample_time(start) - ((m_data[0]>>31)&1);
+	tb.seek(st.m_addrv, st.m_now);
+	st.m_last_trigger = true;
+	st.m_last_word = 0;
+	st.m_first = true;
+
+	// Find the last data word before start
+	unsigned	p = start;
+	while((p > 0)&&(m_data[p-1] & 0x80000000))
+		p--;
+	if (p > 0) {
+		uint64_t	addrv;
+
+		p--;
+		st.m_first = false;
+		st.m_last_word = m_data[p];
+
+		// If that word was the trigger, and nothing has come along
+		// since to clear it, it's still set
+		addrv = (p == 0) ? 0 : sample_time(p) - ((m_data[0]>>31)&1);
+		if ((p+1 == start)&&((int64_t)(addrv-alen) == offset))
+			st.m_last_word |= VCD_TRIGGER;
+	}
+}
+// }}}
+
+// SCOPE::write_vcd_range
+// {{{
+// Write the VCD values for words start through end-1, starting from (and
+// updating) the state st.
+void	SCOPE::write_vcd_range(VCDBUF &out, unsigned start, unsigned end,
+		VCDSTATE &st, const TIMEBASE &tb, uint64_t alen,
+		int64_t offset) {
 	// And split into two paths--one for compressed scopes (wbscopc), and
 	// the other for the more normal scopes (wbscope).
 	if(m_compressed) {
 		// {{{
 		// With compressed scopes, you need to track the address
 		// relative to the beginning.
-		uint64_t	addrv = 0;
-		uint64_t	now_ns;
-		double		dnow;
-		bool		last_trigger = true;
+		// now is the time of addrv
+		uint64_t	addrv = st.m_addrv;
+		TIMEBASE::TIME	now = st.m_now;
+		bool		last_trigger = st.m_last_trigger;
+		unsigned	last_word = st.m_last_word;
+		bool		first = st.m_first;
 
 		// Loop over each data word read from the scope
-		for(int i=0; i<(int)m_scoplen; i++) {
+		for(unsigned i=start; i<end; i++) {
 			// If the high bit is set, the address jumps by more
 			// than an increment
 			if ((m_data[i]>>31)&1) {
 				if (i!=0) {
-					if (last_trigger) {
+					if ((last_trigger)&&((!m_vcd_changes_only)
+							||(last_word & VCD_TRIGGER))) {
 						// If the trigger was valid
 						// on the last clock, then we
 						// need to include the change
 						// to drop it.
 						//
-						dnow   = 1.0/((double)m_clkfreq_hz) * (addrv+1);
-						now_ns = (uint64_t)(dnow * 1e9);
-						fprintf(fp, "#%ld\n", now_ns);
-						fprintf(fp, "0\'T\n");
+						TIMEBASE::TIME	t = now;
+
+						tb.step(t);
+						out.timestamp(t.m_time);
+						out.put("0\'T\n");
+						last_word &= ~VCD_TRIGGER;
 					}
 					// But ... with nothing to write out.
 					addrv += (m_data[i]&0x7fffffff) + 1;
+					tb.step(now, (m_data[i]&0x7fffffff) + 1);
 				} continue;
 			}
 
+			bool	trigger = ((int64_t)(addrv-alen) == offset);
+
+			if (m_vcd_changes_only) {
+				// {{{
+				// Keep the trigger in the top bit of the word,
+				// so we can check for any change at all with
+				// one comparison
+				unsigned word = (m_data[i] & 0x7fffffff)
+						| (trigger ? VCD_TRIGGER : 0);
+
+				if ((!first)&&(word == last_word)) {
+					addrv++;
+					tb.step(now);
+					continue;
+				}
+
+				out.timestamp(now.m_time);
+				write_vcd_changes(out, 31, i, word, last_word,
+						first);
+				last_word = word;
+				first = false;
+				addrv++;
+				tb.step(now);
+				continue;
+				// }}}
+			}
+
 			// Produce a line identifying the time associated with
 			// this piece of data.
-			//
-			// dnow is the current time represented as a double
-			dnow = 1.0/((double)m_clkfreq_hz) * addrv;
-			// Convert to nanoseconds, and to integers.
-			now_ns = (uint64_t)(dnow * 1e9);
+			out.timestamp(now.m_time);
 
-			fprintf(fp, "#%ld\n", now_ns);
-
-			if ((int64_t)(addrv-alen) ==(int64_t)offset) {
-				fprintf(fp, "1\'T\n");
+			if (trigger) {
+				out.put("1\'T\n");
 				last_trigger = true;
 			} else if (last_trigger)
-				fprintf(fp, "0\'T\n");
+				out.put("0\'T\n");
 
 			// For compressed data, only the lower 31 bits are
 			// valid.  Write those bits to the VCD file as a raw
 			// value.
-			write_binary_trace(fp, 31, m_data[i], "\'R\n");
+			out.binary(31, m_data[i], "\'R");
 
 			// Finally, walk through all of the user defined traces,
 			// writing each to the VCD file.
-			for(unsigned k=0; k<m_traces.size(); k++) {
-				TRACEINFO *info = m_traces[k];
-				write_binary_trace(fp, info, m_data[i]);
-			}
+			const TRACEINFO	*info = m_traces.data();
+			for(unsigned k=0; k<m_traces.size(); k++, info++)
+				out.binary(info->m_nbits, trace_value(k, i),
+					info->m_key);
 
 			addrv++;
+			tb.step(now);
+		}
+
+		st.m_addrv = addrv;
+		st.m_now = now;
+		st.m_last_trigger = last_trigger;
+		st.m_last_word = last_word;
+		st.m_first = first;
+		// }}}
+	} else if (m_vcd_clockless) {
+		// {{{
+		// An uncompressed scope, but without the synthetic clock.  Just
+		// one timestamp per clock, or none at all if nothing changes.
+		TIMEBASE::TIME	now = st.m_now;
+		unsigned	last_word = st.m_last_word;
+
+		for(unsigned i=start; i<end; i++) {
+			bool	trigger = ((int64_t)i == offset);
+
+			if (m_vcd_changes_only) {
+				if ((i == 0)||(trigger)
+						||(m_data[i] != last_word)) {
+					out.timestamp(now.m_time);
+					if (trigger)
+						out.put("1\'T\n");
+					write_vcd_changes(out, 32, i,
+						m_data[i], last_word, i==0);
+				}
+				last_word = m_data[i];
+			} else {
+				out.timestamp(now.m_time);
+				if (trigger)
+					out.put("1\'T\n");
+				out.binary(32, m_data[i], "\'R");
+
+				const TRACEINFO	*info = m_traces.data();
+				for(unsigned k=0; k<m_traces.size();k++,info++)
+					out.binary(info->m_nbits,
+						trace_value(k, i), info->m_key);
+			}
+
+			tb.step(now);
 		}
+
+		st.m_addrv = end;
+		st.m_now = now;
+		st.m_last_word = (end > 0) ? m_data[end-1] : 0;
+		st.m_last_trigger = (end > 0)&&((int64_t)end-1 == offset);
+		st.m_first = (end == 0);
 		// }}}
 	} else { // Uncompressed scope.
 		// {{{
-		unsigned now_ns;
-		double	dnow;
+		// now steps through each half clock
+		TIMEBASE::TIME	now = st.m_now;
+		unsigned	last_word = st.m_last_word;
+		bool		last_trigger = st.m_last_trigger;
 
 		// We assume a clock signal, and set it to one and zero.
 		// We also assume everything changes on the positive edge of
 		// that clock within here.
 
 		// Loop over all data words
-		for(int i=0; i<(int)m_scoplen; i++) {
+		for(unsigned i=start; i<end; i++) {
 			// Positive edge of the clock (everything is assumed to
 			// be on the positive edge)
 
@@ -458,41 +1962,242 @@ void	SCOPE::writevcd(FILE *fp) {
 			//
 
 			// Write the current (relative) time of this data word
-			dnow = 1.0/((double)m_clkfreq_hz) * i;
-			now_ns = (unsigned)(dnow * 1e9 + 0.5);
-			fprintf(fp, "#%d\n", now_ns);
-
-			fprintf(fp, "1\'C\n");
-			write_binary_trace(fp, (m_compressed)?31:32,
-				m_data[i], "\'R\n");
-
-			if (i == offset)
-				fprintf(fp, "1\'T\n");
-			else // if (addrv == offset+1)
-				fprintf(fp, "0\'T\n");
-
-			for(unsigned k=0; k<m_traces.size(); k++) {
-				TRACEINFO *info = m_traces[k];
-				write_binary_trace(fp, info, m_data[i]);
+			out.timestamp(now.m_time);
+			tb.step(now);
+
+			out.put("1\'C\n");
+			if (m_vcd_changes_only) {
+				// Only write out what has changed since the
+				// last clock
+				bool	trigger = ((int64_t)i == offset);
+
+				if ((i == 0)||(trigger != last_trigger))
+					out.put(trigger ? "1\'T\n" : "0\'T\n");
+				write_vcd_changes(out, 32, i, m_data[i],
+					last_word, i==0);
+				last_word = m_data[i];
+				last_trigger = trigger;
+			} else {
+				out.binary(32, m_data[i], "\'R");
+
+				if ((int64_t)i == offset)
+					out.put("1\'T\n");
+				else // if (addrv == offset+1)
+					out.put("0\'T\n");
+
+				const TRACEINFO	*info = m_traces.data();
+				for(unsigned k=0; k<m_traces.size();k++,info++)
+					out.binary(info->m_nbits,
+						trace_value(k, i), info->m_key);
 			}
 
 			//
 			// Clock goes to zero
 			//
 
-			// Add half a clock period to our time
-			dnow += 1.0/((double)m_clkfreq_hz)/2.;
-			now_ns = (unsigned)(dnow * 1e9 + 0.5);
-			fprintf(fp, "#%d\n", now_ns);
+			// Half a clock period later
+			out.timestamp(now.m_time);
+			tb.step(now);
 
 			// Now finally write the clock as zero.
-			fprintf(fp, "0\'C\n");
+			out.put("0\'C\n");
 		}
+
+		st.m_addrv = end;
+		st.m_now = now;
+		st.m_last_word = last_word;
+		st.m_last_trigger = last_trigger;
+		st.m_first = (end == 0);
 		// }}}
 	}
 }
 // }}}
 
+// SCOPE::load
+// {{{
+unsigned	SCOPE::load(void) {
+	if (!m_data)
+		rawread();
+	if (!m_data)
+		return 0;
+
+	// If the traces haven't yet been defined, then define them now.
+	if (m_traces.size()==0)
+		define_traces();
+
+	return wait_for_data(m_scoplen);
+}
+// }}}
+
+// SCOPE::writevcd (FILE *fp)
+// {{{
+void	SCOPE::writevcd(FILE *fp, bool clockless) {
+	bool	was_clockless = m_vcd_clockless;
+
+	// Everything from the header on down needs to know whether or not
+	// we're writing the clock.  Put it back afterwards, so that a later
+	// call to write_trace_header() and friends sees the default again.
+	m_vcd_clockless = clockless;
+	write_vcd_file(fp);
+	m_vcd_clockless = was_clockless;
+}
+// }}}
+
+// SCOPE::write_vcd_file
+// {{{
+void	SCOPE::write_vcd_file(FILE *fp) {
+	uint64_t	alen;
+	unsigned	nthreads;
+	int64_t		offset = 0;
+
+	if (!m_data)
+		rawread();
+	if (!m_data)
+		return;
+
+	// If the traces haven't yet been defined, then define them now.
+	if (m_traces.size()==0)
+		define_traces();
+
+	nthreads = m_vcd_threads;
+	if (nthreads == 0)
+		nthreads = std::thread::hardware_concurrency();
+	if (m_scoplen < 2*VCD_MIN_PARTITION)
+		nthreads = 1;
+
+	// Count how many values are in our (possibly compressed) buffer.
+	// If it weren't for the compression, this'd be m_scoplen.  Writing
+	// in parallel, or from a compressed scope, needs the whole buffer.
+	if ((m_compressed)||(nthreads > 1)) {
+		wait_for_data(m_scoplen);
+		if (!m_map)
+			build_columns();
+	}
+	alen = getaddresslen();
+
+	// If the holdoff is zero, the triggered item is the very
+	// last one.
+	offset = (int64_t)alen - m_holdoff -1;
+
+	// Write the file header.
+	write_trace_header(fp, offset);
+
+	// Timestamps are counted in steps: one per clock, or for the
+	// uncompressed scope, one per clock edge
+	TIMEBASE	tb(vcd_rate());
+
+	if (nthreads > 1) {
+		writevcd_parallel(fp, nthreads, tb, alen, offset);
+		return;
+	}
+
+	// From here on, everything goes through our output buffer, rather
+	// than directly to the file
+	VCDBUF		out(fp);
+	VCDSTATE	st;
+	unsigned	done = 0, released = 0;
+
+	vcd_state(0, st, tb, alen, offset);
+	while(done < m_scoplen) {
+		// Wait for more data to arrive, if we are reading it in
+		// chunks, and then write out whatever we have
+		unsigned nvalid = wait_for_data(done+1);
+		if (nvalid <= done)
+			break;
+		if (!m_map)
+			extend_columns(nvalid);
+		else if (nvalid - done > m_segment)
+			// Take mapped data a segment at a time
+			nvalid = done + m_segment;
+		write_vcd_range(out, done, nvalid, st, tb, alen, offset);
+		done = nvalid;
+		release_words(released, done);
+	}
+}
+// }}}
+
+// SCOPE::writevcd_parallel
+// {{{
+// Split the capture into partitions, and hand them out to nthreads worker
+// threads to format into memory.  Each worker starts its partition from the
+// state writevcd() would've had at that point, so the result is identical to
+// writing the file in one pass.  Meanwhile, we write the finished partitions
+// to the file in order.  Workers are kept from getting too far ahead of the
+// writer, so as to bound the memory used.
+void	SCOPE::writevcd_parallel(FILE *fp, unsigned nthreads,
+		const TIMEBASE &tb, uint64_t alen, int64_t offset) {
+	unsigned	nparts, partlen, next = 0, written = 0;
+	const unsigned	window = 2*nthreads;
+	std::vector<VCDBUF *>	parts;
+	std::vector<std::thread> workers;
+	std::mutex		lock;
+	std::condition_variable	cv;
+
+	nparts = 4*nthreads;
+	partlen = (m_scoplen + nparts-1) / nparts;
+	if (partlen < VCD_MIN_PARTITION)
+		partlen = VCD_MIN_PARTITION;
+	nparts = (m_scoplen + partlen-1) / partlen;
+	parts.assign(nparts, NULL);
+
+	for(unsigned t=0; t<nthreads; t++)
+		workers.push_back(std::thread([&]() {
+			while(1) {
+				unsigned	k;
+				{
+					std::unique_lock<std::mutex> lk(lock);
+					cv.wait(lk, [&]{ return (next >= nparts)
+						||(next < written + window); });
+					if (next >= nparts)
+						return;
+					k = next++;
+				}
+
+				unsigned start = k * partlen,
+					end = start + partlen;
+				VCDBUF		*buf = new VCDBUF(NULL);
+				VCDSTATE	st;
+
+				if (end > m_scoplen)
+					end = m_scoplen;
+				vcd_state(start, st, tb, alen, offset);
+				write_vcd_range(*buf, start, end, st, tb,
+					alen, offset);
+				if (m_map) {
+					unsigned	mark = start;
+					release_words(mark, end);
+				}
+
+				{
+					std::lock_guard<std::mutex> lk(lock);
+					parts[k] = buf;
+				} cv.notify_all();
+			}
+		}));
+
+	for(unsigned k=0; k<nparts; k++) {
+		VCDBUF	*buf;
+		{
+			std::unique_lock<std::mutex> lk(lock);
+			cv.wait(lk, [&]{ return parts[k] != NULL; });
+			buf = parts[k];
+		}
+
+		fwrite(buf->data(), 1, buf->size(), fp);
+		delete buf;
+
+		{
+			std::lock_guard<std::mutex> lk(lock);
+			parts[k] = NULL;
+			written++;
+		} cv.notify_all();
+	}
+
+	for(unsigned t=0; t<nthreads; t++)
+		workers[t].join();
+}
+// }}}
+
 /*
  * SCOPE::writevcd
  * {{{
@@ -500,7 +2205,7 @@ void	SCOPE::writevcd(FILE *fp) {
  * given name, and writes the VCD info to it.  If the file cannot be opened,
  * an error is written to the standard error stream, and the routine returns.
  */
-void	SCOPE::writevcd(const char *trace_file_name) {
+void	SCOPE::writevcd(const char *trace_file_name, bool clockless) {
 	FILE	*fp = fopen(trace_file_name, "w");
 
 	if (fp == NULL) {
@@ -509,7 +2214,7 @@ void	SCOPE::writevcd(const char *trace_file_name) {
 		return;
 	}
 
-	writevcd(fp);
+	writevcd(fp, clockless);
 
 	fclose(fp);
 }
@@ -45,7 +45,21 @@
 #define	SCOPECLS_H
 
 #include <vector>
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <time.h>
 #include "devbus.h"
+#include "outbuf.h"
+#include "vcdbuf.h"
+#include "tracecol.h"
+#include "pyramid.h"
+#include "edgeidx.h"
+#include "search.h"
+#include "tracestat.h"
+#include "latency.h"
+#include "timebase.h"
 
 
 /*
@@ -58,14 +72,15 @@
  * zero.
  *
  * Other key pieces include the human readable name given to the signal, m_name,
- * as well as the VCD name, m_key.
+ * as well as the VCD name, m_key.  m_mask is just ((1<<m_nbits)-1), kept here
+ * so it needn't be recomputed for every word.
  * }}}
  */
 class	TRACEINFO {
 public:
 	const char	*m_name;
-	char		m_key[4];
-	unsigned	m_nbits, m_nshift;
+	char		m_key[8];
+	unsigned	m_nbits, m_nshift, m_mask;
 };
 
 /*
@@ -91,16 +106,208 @@ class	SCOPE {
 	unsigned	*m_data;	// Data read from the scope
 	unsigned	m_clkfreq_hz;
 
+	// Chunked readout.  If m_chunklen is non-zero, rawread() hands the
+	// readout to a reader thread which reads m_chunklen words at a time,
+	// advancing m_nvalid as each chunk lands in m_data.  Consumers
+	// (print(), writevcd(), ...) then wait on m_nvalid rather than on
+	// the whole buffer, so decoding overlaps with the bus transfer.
+	unsigned	m_chunklen, m_nvalid;
+	bool		m_reading, m_readerr;
+	std::thread	m_reader;
+	mutable	std::mutex	m_rdlock;
+	std::condition_variable	m_rdcv;
+	struct timespec	m_rdstart, m_rddone;
+
+	// Set to only write VCD values when they change
+	bool		m_vcd_changes_only;
+	// Set, for the duration of a writevcd() call, if that call asked for
+	// a compact file without the synthetic clock
+	bool		m_vcd_clockless;
+
+	// The time index.  For a compressed scope, m_tindex[i] is the clock
+	// number of the first clock represented by m_data[i], and
+	// m_tindex[m_scoplen] is the total number of clocks in the capture.
+	// It's built once, after the data has been read, into m_tindex_buf--
+	// or mapped, along with the data, from a capture file.  Uncompressed
+	// scopes don't need it, since there the clock number is the address.
+	const uint64_t		*m_tindex;
+	std::vector<uint64_t>	m_tindex_buf;
+	bool		m_indexed;
+
+	// The last control word read from the scope
+	DEVBUS::BUSW	m_ctrl;
+
+	// Whether the scope lets us set its read address, by writing to its
+	// data register--once we've checked
+	bool		m_seek_probed, m_seekable;
+	// After read_window(), m_scoplen and m_holdoff describe the window.
+	// The scope's own length and holdoff are kept here until the
+	// window's data is released.  m_memlen is zero otherwise.
+	unsigned	m_memlen, m_memholdoff;
+
+	// Set the scope's read address back to the oldest word
+	void	rewind(void);
+
+	// Find out if the scope can seek, if we haven't already
+	bool	probe_seek(void);
+
+	// A file mapped into memory, holding m_data (and, for a compressed
+	// scope, m_tindex).  This is either a capture file mapped by
+	// open_capture()--in which case m_mapped_traces is set, since the
+	// trace names live there too--or the backing file of an out-of-core
+	// scope.  Either way, m_data is then walked m_segment words at a
+	// time, releasing each segment's pages once done with it, to keep
+	// the memory we use bounded no matter how big the capture.
+	void		*m_map;
+	size_t		m_maplen;
+	bool		m_mapped_traces;
+	char		*m_backing;
+	unsigned	m_segment;
+
+	// Map the backing file, sized for m_scoplen words, returning where
+	// the data goes (or NULL on failure)
+	DEVBUS::BUSW	*map_backing(void);
+
+	// Release the pages of mapped data (and index) from word mark up to
+	// word upto, once there's at least a segment of them.  mark is then
+	// moved up to upto.
+	void	release_words(unsigned &mark, unsigned upto);
+
+	// The number of words to read at a time
+	unsigned	readout_chunk(void) const {
+		if ((m_map)&&((m_chunklen == 0)||(m_chunklen > m_segment)))
+			return m_segment;
+		return m_chunklen;
+	}
+
+	// The value of trace k within data word i.  Mapped data is used in
+	// place, rather than building columns for it.
+	unsigned	trace_value(unsigned k, unsigned i) {
+		if (m_map) {
+			const TRACEINFO	&t = m_traces[k];
+			return (m_data[i] >> t.m_nshift) & t.m_mask;
+		} return m_columns[k][i];
+	}
+
+	// The body of the reader thread
+	void	chunked_read(void);
+
+	// Readout retries.  A chunk of the readout failing with a bus error
+	// is read again, up to m_max_retries times, waiting m_retry_delay_us
+	// before the first retry and twice as long before each one after.
+	// Readouts that aren't otherwise chunked are read m_checkpoint words
+	// at a time when retries are enabled, so that an error costs no more
+	// than that.  The counters cover the last readout.
+	unsigned	m_max_retries, m_retry_delay_us, m_checkpoint;
+	unsigned long	m_retried_chunks, m_retried_words;
+
+	// Read ln words, starting at word pos, into m_data, retrying as above
+	void	read_chunk(unsigned pos, unsigned ln);
+
+	// Read the scope's memory into the (already allocated) m_data
+	void	start_readout(void);
+
+	// Forget any data we've read from the scope
+	void	release_data(void);
+
+	// The buffer capture_loop() reads every capture into, allocated once
+	// so captures can be read back to back without allocating new memory
+	// for each
+	DEVBUS::BUSW	*m_capbuf;
+	double		m_dead_time;
+
+	// Set m_interrupts if the scope's o_interrupt line is connected to
+	// the DEVBUS's interrupt, so wait_ready() can sleep on it
+	bool		m_interrupts;
+	// The number of bus transactions spent waiting in wait_ready()
+	unsigned long	m_wait_reads;
+
+	// Columns, one per trace, holding the value of that trace for every
+	// word read from the scope.  m_colvalid is the number of words
+	// extracted into the columns so far.
+	std::vector<TRACECOL>	m_columns;
+	unsigned	m_colvalid;
+
+	// Extract the traces from the first nwords words into the columns
+	void	extend_columns(unsigned nwords);
+
+	// The level-of-detail summary of the traces, built by pyramid()
+	PYRAMID		m_pyramid;
+
+	// The index of where each trace changes, built by edges()
+	EDGEIDX		m_edges;
+
+	// The statistics of each trace, gathered by stats()
+	TRACESTATS	m_stats;
+
+	// The number of threads to use when writing VCD files.  0 uses one
+	// per CPU.
+	unsigned	m_vcd_threads;
+
+	// What writevcd() needs to know about what it has written so far,
+	// to carry on writing from any given word
+	struct	VCDSTATE {
+		uint64_t	m_addrv;
+		TIMEBASE::TIME	m_now;
+		unsigned	m_last_word;
+		bool		m_last_trigger, m_first;
+	};
+
+	// The number of VCD timestamps per clock.  The uncompressed scope
+	// gets two per clock, one for each edge of its synthetic clock,
+	// unless writing a clockless file.
+	unsigned	vcd_steps(void) const {
+		return ((m_compressed)||(m_vcd_clockless)) ? 1:2;
+	}
+
+	// The rate of VCD timestamps, per second
+	uint64_t	vcd_rate(void) const {
+		return (uint64_t)m_clkfreq_hz * vcd_steps();
+	}
+
+	// Find the VCDSTATE at word start, without writing everything before
+	void	vcd_state(unsigned start, VCDSTATE &st, const TIMEBASE &tb,
+			uint64_t alen, int64_t offset);
+
+	// Write words start through end-1 to the VCD buffer
+	void	write_vcd_range(VCDBUF &out, unsigned start, unsigned end,
+			VCDSTATE &st, const TIMEBASE &tb, uint64_t alen,
+			int64_t offset);
+
+	// The body of writevcd(), once m_vcd_clockless has been set
+	void	write_vcd_file(FILE *fp);
+
+	// Write the VCD values, spread across nthreads threads
+	void	writevcd_parallel(FILE *fp, unsigned nthreads,
+			const TIMEBASE &tb, uint64_t alen, int64_t offset);
+
 	// The m_traces variable holds a list of all of the various wire
-	// definitions within the scope data word.
-	std::vector<TRACEINFO *> m_traces;
+	// definitions within the scope data word.  They're kept in one
+	// contiguous table, since writevcd() walks the whole table for every
+	// word it writes.
+	std::vector<TRACEINFO> m_traces;
 
 public:
 	SCOPE(DEVBUS *fpga, unsigned addr,
 			bool compressed=false, bool vecread=true)
 		: m_fpga(fpga), m_addr(addr),
 			m_compressed(compressed), m_vector_read(vecread),
-			m_scoplen(0), m_data(NULL) {
+			m_scoplen(0), m_data(NULL),
+			m_chunklen(0), m_nvalid(0),
+			m_reading(false), m_readerr(false),
+			m_vcd_changes_only(false), m_vcd_clockless(false),
+			m_tindex(NULL), m_indexed(false), m_ctrl(0),
+			m_seek_probed(false), m_seekable(false),
+			m_memlen(0), m_memholdoff(0),
+			m_map(NULL), m_maplen(0), m_mapped_traces(false),
+			m_backing(NULL), m_segment(1<<20),
+			m_max_retries(0), m_retry_delay_us(1000),
+			m_checkpoint(1<<16),
+			m_retried_chunks(0), m_retried_words(0),
+			m_capbuf(NULL), m_dead_time(0.0),
+			m_interrupts(false),
+			m_wait_reads(0), m_colvalid(0),
+			m_vcd_threads(1) {
 		//
 		// First thing we want to do upon allocating a scope, is to
 		// define the traces for that scope.  Sad thing is ... we can't
@@ -114,15 +321,66 @@ public:
 	}
 
 	// Free up any of our allocated memory.
-	~SCOPE(void) {
-		for(unsigned i=0; i<m_traces.size(); i++)
-			delete m_traces[i];
-		if (m_data) delete[] m_data;
+	virtual	~SCOPE(void) {
+		join_reader();
+		release_data();
+		delete[] m_capbuf;
+		if (m_backing)
+			free(m_backing);
 	}
 
 	// Query the scope: Is it ready?  Has it primed, triggered, and stopped?
 	// If so, this routine returns true, false otherwise.
 	bool	ready();
+	// Same as ready(), but given a control word that's already been read
+	// from the scope.  Scopes whose control words differ from wbscope's
+	// may override this.
+	virtual	bool	ready(DEVBUS::BUSW ctrl);
+
+	// The address of the scope's control register.  Its data register
+	// immediately follows, at address()+4.
+	DEVBUS::BUSW	address(void) const { return m_addr; }
+
+	// Wait for the scope to be ready, for no more than timeout_ms
+	// milliseconds (or forever, if timeout_ms is negative).  Returns
+	// true if the scope is ready.  If the scope's interrupt is connected,
+	// this sleeps on the DEVBUS interrupt, reading the control register
+	// only once an interrupt has been seen.  Otherwise it polls the
+	// control register, with an exponentially increasing delay between
+	// reads.
+	bool	wait_ready(int timeout_ms = -1);
+
+	// Declare whether or not the scope's interrupt is connected to the
+	// DEVBUS interrupt
+	void	set_interrupt(bool connected) { m_interrupts = connected; }
+
+	// The number of bus transactions spent waiting in wait_ready()
+	unsigned long	wait_transactions(void) const { return m_wait_reads; }
+
+	// Reset the scope, discarding any data we've read from it, and
+	// re-arm it to trigger again with the given holdoff.
+	void	rearm(unsigned holdoff);
+
+	// Capture over and over again.  Each time the scope stops, read its
+	// data, re-arm the scope immediately, and only then call on_capture()
+	// to process what was read.  This keeps the time the scope spends
+	// stopped (its dead time) to little more than the readout time, since
+	// processing overlaps the next capture.  (It doesn't overlap the
+	// next readout, which waits for on_capture() to return.)  Stops after
+	// ncaptures captures (0 for never), or once on_capture() returns
+	// false, and then reports the dead time and capture rate to stderr.
+	// Returns the number of captures made.
+	unsigned	capture_loop(unsigned holdoff, unsigned ncaptures = 0);
+
+	// Called by capture_loop() for each capture, once the scope has been
+	// re-armed.  The capture is then available to print(), writevcd(),
+	// and so forth, just as though rawread() had been called.  Return
+	// false to end the loop.  By default, this just prints the capture.
+	virtual	bool	on_capture(unsigned capture_id);
+
+	// The time, in seconds, between the last capture_loop() capture
+	// being seen as stopped and the scope being re-armed.
+	double	dead_time(void) const { return m_dead_time; }
 
 	// Read the control word from the scope, and send to the standard output
 	// a description of that.
@@ -130,7 +388,7 @@ public:
 
 	// Read the scope's control word, decode the memory size of the scope,
 	// and return that to our caller.
-	int	scoplen(void);
+	unsigned	scoplen(void);
 
 	// Set the clock speed that we are referencing
 	void	set_clkfreq_hz(unsigned clkfreq_hz) {
@@ -140,10 +398,116 @@ public:
 	// Read any previously set clock speed.
 	unsigned get_clkfreq_hz(void) { return m_clkfreq_hz; }
 
+	// Is this a compressed (wbscopc) scope?
+	bool	compressed(void) const { return m_compressed; }
+
+	// The last control word read from the scope, or the one saved with
+	// a capture file
+	DEVBUS::BUSW	control(void) const { return m_ctrl; }
+
+	// Make sure the scope's data has been read, all of it, and its traces
+	// defined, ready to be written out.  Returns the number of words
+	// read, or zero if there's no data.
+	unsigned	load(void);
+
+	// The clock number of the trigger, counted from the first clock in
+	// the buffer.  This is negative if the holdoff exceeds the capture.
+	int64_t	trigger_clock(void) {
+		return (int64_t)getaddresslen() - (int64_t)m_holdoff - 1;
+	}
+
+	// Keep the data read from the scope in the file fname, mapped into
+	// memory, rather than in memory alone.  This allows captures far
+	// bigger than memory--such as from a memscope.  The data is read,
+	// and then printed or written to VCD files, segment_words at a
+	// time, with only a few segments in memory at once.  (Trace columns
+	// aren't built for such scopes, unless asked for with column().)
+	void	set_backing_file(const char *fname,
+				unsigned segment_words = (1<<20));
+
+	// Save the capture to a .wbscap file: a header, the trace table, and
+	// the data words and (for compressed scopes) the time index, each
+	// page aligned.  The file is written in the host's byte order.
+	// Returns true on success.
+	bool	write_capture(const char *fname);
+
+	// Replace whatever we have with a capture from a .wbscap file.  The
+	// file is mapped into memory and used in place, with nothing to
+	// parse beyond the header.  The traces come from the file too, so
+	// define_traces() won't be called.  Returns true on success.
+	bool	open_capture(const char *fname);
+
 	// Read the data from the scope and place it into our m_data array.
-	// Nothing more is done with it beyond that.
+	// Nothing more is done with it beyond that.  If a readout chunk
+	// length has been set, this only starts the readout, and returns
+	// while the data is still arriving.
 	virtual	void	rawread(void);
 
+	// Does the scope allow its read address to be set (OPT_SEEK)?  The
+	// first call finds out by writing bit 31 to the data register, which
+	// asks such a scope for its capabilities word.  This may return the
+	// read address of any other scope to the beginning of its buffer.
+	bool	seekable(void);
+
+	// Read only the part of the buffer around the trigger: before clocks
+	// before it, and after clocks after it, rather than the whole
+	// buffer.  (On a compressed scope, the window starts at a data word,
+	// and so may start a little earlier.)  The window then stands in for
+	// the scope's data, as though the scope had only captured those
+	// clocks, until the data is released.  If the scope can seek, only
+	// the window is read.  Otherwise everything up to the end of the
+	// window is read, and the rest dropped.  Returns the number of words
+	// in the window, or zero on failure.
+	unsigned	read_window(unsigned before, unsigned after);
+
+	// Set the number of words to read per bus transaction during rawread.
+	// Zero, the default, reads the whole buffer in one transaction before
+	// returning.  Anything else reads the buffer on a separate thread,
+	// one chunk at a time, so that the data may be processed as it
+	// arrives.
+	void	set_readout_chunk(unsigned nwords) { m_chunklen = nwords; }
+
+	// If part of the readout fails with a bus error, retry it up to
+	// max_retries times, first after delay_us microseconds and then
+	// doubling the delay each time.  This requires that the readout can
+	// be resumed from the failed chunk, such as on a scope that can seek
+	// or a MEMSCOPE.  Retries are off (zero) by default.  When they are
+	// on, each readout first finds out whether the scope can seek (see
+	// seekable()), before any data is read.
+	void	set_retries(unsigned max_retries, unsigned delay_us = 1000) {
+		m_max_retries    = max_retries;
+		m_retry_delay_us = delay_us;
+	}
+
+	// When retries are on, readouts without a readout chunk length are
+	// still read nwords at a time, so that an error only costs that many
+	// words.  The default is 64k words.
+	void	set_checkpoint(unsigned nwords) { m_checkpoint = nwords; }
+
+	// The number of chunks, and words, read again during the last
+	// readout because of bus errors
+	unsigned long	retried_chunks(void) const { return m_retried_chunks; }
+	unsigned long	retried_words(void) const { return m_retried_words; }
+
+	// True if the last readout ended early, on a bus error that couldn't
+	// be retried.  wait_for_data() then returns the words read before it.
+	bool	readout_failed(void) const;
+
+	// Wait until at least nwords of the buffer have been read, and return
+	// the number of valid words.  This will only return less than nwords
+	// if the readout failed.
+	unsigned	wait_for_data(unsigned nwords);
+
+	// Wait for any background readout to complete.  This must be done
+	// before anything else uses the bus.
+	void	join_reader(void);
+
+	// Report how long the readout took, and how long it's been from the
+	// start of the readout until now--i.e. the end to end time, if called
+	// once all processing is complete.  This waits for any background
+	// readout to finish.
+	void	report_timing(FILE *fp);
+
 	// Walk through the data, and print out to the standard output, what is
 	// in it.  If multiple lines have the same data, print() will avoid
 	// printing those lines for the purpose of keeping the output from
@@ -161,6 +525,16 @@ public:
 	// function--and why it needs to be scope specific.
 	virtual	void	decode(DEVBUS::BUSW v) const = 0;
 
+	// decode_batch() is the batched form of decode().  print() hands it
+	// n consecutive words at a time, which should be decoded into out,
+	// calling out.endl() after each word.  (The prefix and newline of
+	// each line are taken care of by print().)  The default just calls
+	// decode() for each word, but scopes with deep captures may wish to
+	// override this with a loop writing directly to out, avoiding both a
+	// virtual call and several printf()s per word.
+	virtual	void	decode_batch(const DEVBUS::BUSW *v, size_t n,
+				OUTBUF &out);
+
 	//
 	//
 	// The following routines are provided to enable the creation and
@@ -173,10 +547,10 @@ public:
 
 	// Write the offset from the time within the file, to the time of the
 	// trigger, into the file.
-	virtual void	write_trace_timezero(FILE *fp, int offset);
+	virtual void	write_trace_timezero(FILE *fp, int64_t offset);
 
 	// Write the VCD file's header
-	virtual void	write_trace_header(FILE *fp, int offset = 0);
+	virtual void	write_trace_header(FILE *fp, int64_t offset = 0);
 
 	// Given a value, and the number of bits required to define that value,
 	// write a single line to our VCD file.
@@ -191,22 +565,84 @@ public:
 	//
 	// This is also an internal call that you are not likely to need to
 	// modify.
-		void	write_binary_trace(FILE *fp, TRACEINFO *info,
+		void	write_binary_trace(FILE *fp, const TRACEINFO *info,
+				unsigned value);
+	// ... or to a VCDBUF output buffer, as writevcd() does.
+		void	write_binary_trace(VCDBUF &out, const TRACEINFO *info,
 				unsigned value);
 
+	// Write only those traces of the scope word which have changed since
+	// the last word written.  Used by writevcd when only value changes
+	// are requested.
+		void	write_vcd_changes(VCDBUF &out, const int nbits,
+				unsigned addr, unsigned word,
+				unsigned last_word, bool first);
+
 	// This is the user entry point.  When you know the scope is ready,
 	// you may call writevcd to start the VCD generation process.
-		void	writevcd(const char *trace_file_name);
+	//
+	// Uncompressed scopes normally write a synthetic clock, 'C, with a
+	// timestamp for each edge.  If clockless is set, writevcd instead
+	// writes one timestamp per sample (or per change, if only changes
+	// are being written), and marks the trigger with a single event
+	// rather than a wire.  This makes for a much smaller file.
+	// Compressed scopes have no clock, so clockless makes no difference.
+		void	writevcd(const char *trace_file_name,
+				bool clockless = false);
 	// This is an alternate entry point, useful if you already have a
 	// FILE *.  This will write the data to the file, but not close the
 	// file.
-		void	writevcd(FILE *fp);
+		void	writevcd(FILE *fp, bool clockless = false);
+
+	// By default, writevcd writes every trace on every clock.  If
+	// changes_only is set, writevcd will instead only write a value when
+	// it changes, and only write a timestamp when something changes at
+	// that time--as VCD was intended.  This can make the VCD file much
+	// smaller.
+	void	set_vcd_changes_only(bool changes_only) {
+		m_vcd_changes_only = changes_only;
+	}
+
+	// Format the VCD file using nthreads threads, or one per CPU if
+	// nthreads is zero.  The output is the same either way.  The default
+	// is one thread.
+	void	set_vcd_threads(unsigned nthreads) {
+		m_vcd_threads = nthreads;
+	}
 
 	// Calculate the number of points the scope covers.  Nominally, this
 	// will be m_scopelen, the length of the scope.  However, if the
 	// scope is compressed, this could be greater.
 	//
-	unsigned	getaddresslen(void);
+	uint64_t	getaddresslen(void);
+
+	// Build the time index for a compressed scope, mapping each word
+	// read from the scope to the clock it was recorded on.  This is done
+	// automatically the first time the index is needed.
+	void	build_index(void);
+
+	// Return the clock number associated with the data word at address
+	// addr.  For an uncompressed scope, this is just the address.
+	uint64_t	sample_time(unsigned addr);
+
+	// Return the address of the data word holding the value at clock
+	// number clk, or m_scoplen if clk is beyond the end of the capture.
+	// For a compressed scope, this may be a run-length word--in which
+	// case the value is found in the closest data word before it.
+	unsigned	sample_index(uint64_t clk);
+
+	// Return the value of the scope's data word at clock number clk,
+	// whether or not the scope is compressed.  For a compressed scope,
+	// only the bottom 31 bits are valid.
+	DEVBUS::BUSW	value_at(uint64_t clk);
+
+	// Expand the capture into one value per clock, as value_at() would
+	// return them, writing the values of nclks clocks starting at clock
+	// first into out.  For a compressed scope, this walks the raw words
+	// with the SIMD kernels of rlexpand.h, never looking at a clock at a
+	// time.  Returns the number of values written, which will be less
+	// than nclks if the capture ends first.
+	uint64_t	expand(DEVBUS::BUSW *out, uint64_t first, uint64_t nclks);
 
 	// Your program needs to define a define_traces() function, which will
 	// then be called before trying to write the VCD file.  This function
@@ -220,11 +656,113 @@ public:
 		void	register_trace(const char *varname,
 				unsigned nbits, unsigned shift);
 
+	// Generate the VCD identifier for the id'th signal.  Identifiers are
+	// one or more printable characters (base 94), so the first 93
+	// signals get one character, the next 8742 two, and so on.  None
+	// start with a quote, which is reserved for the scope's own signals
+	// ('C, 'T and 'R).  key must have room for at least 8 characters.
+	static	void	vcd_identifier(unsigned id, char *key);
+
+	// Build the trace columns: one packed array per registered trace,
+	// holding that trace's value for every word read from the scope.
+	// For a compressed scope, run-length words hold the value that's
+	// being repeated.  This is done automatically by those functions
+	// needing the columns.
+	void	build_columns(void);
+
+	// The number of registered traces
+	unsigned	ntraces(void) const { return m_traces.size(); }
+
+	// The registered trace k, and its column
+	const TRACEINFO	*trace(unsigned k) const { return &m_traces[k]; }
+	const TRACECOL	&column(unsigned k) {
+		build_columns();
+		return m_columns[k];
+	}
+
+	// The summary pyramid of the traces, built the first time it's asked
+	// for, as the data arrives
+	const PYRAMID	&pyramid(void);
+
+	// Summarize trace k over nclks clocks, starting at clock first, using
+	// the pyramid.  This touches O(log n) blocks of the pyramid, rather
+	// than every word.  For a compressed scope, the range is widened to
+	// whole words.
+	PYRAMID::NODE	summary(unsigned k, uint64_t first, uint64_t nclks);
+
+	// Save the pyramid to a file, to go alongside the capture--or read
+	// one back, rather than building it again.  Returns true on success.
+	bool	write_pyramid(const char *fname);
+	bool	read_pyramid(const char *fname);
+
+	// The index of every trace's edges, built the first time it's asked
+	// for, as the data arrives.  Its clocks are the same as those of
+	// value_at(), so to find when trace k next goes low after the
+	// trigger, for example:
+	//	edges().next_value(k, trigger_clock()+1, 0, clk);
+	const EDGEIDX	&edges(void);
+
+	// The number of the trace registered with the given name, or -1 if
+	// there's no such trace
+	int	trace_id(const char *name);
+
+	// A search TERM for trace k holding the value v, to which further
+	// conditions may be added
+	SEARCH::TERM	term(unsigned k, unsigned v) const {
+		const TRACEINFO	&t = m_traces[k];
+
+		return SEARCH::TERM().is(t.m_mask << t.m_nshift,
+				v << t.m_nshift);
+	}
+
+	// Find every clock where a pattern matches, or every occurrence of a
+	// sequence of patterns, as described in search.h.  The matches are
+	// appended to matches, in clocks from the start of the capture.  For
+	// a compressed scope, runs are searched without expanding them.
+	void	search(const SEARCH::TERM &term,
+			std::vector<SEARCH::MATCH> &matches);
+	void	search(const std::vector<SEARCH::STEP> &seq,
+			std::vector<SEARCH::MATCH> &matches);
+
+	// The duty cycle, number of changes, minimum, maximum, mean and
+	// histogram of every trace, gathered in one pass over the data the
+	// first time they're asked for, as the data arrives
+	const TRACESTATS	&stats(void);
+
+	// Write those statistics to fp, as JSON
+	void	write_stats(FILE *fp);
+
+	// Measure the latency from each start event to its end event, as
+	// described in latency.h, adding them to lat.  lat is given this
+	// scope's clock frequency, for its conversions to nanoseconds.
+	void	latency(LATENCY &lat, const SEARCH::TERM &start,
+			const SEARCH::TERM &end,
+			LATENCY::PAIRING pairing = LATENCY::FIRST);
+
+	// The data word at addr, wrapping around the end of the buffer as the
+	// scope's own memory does.  A window from read_window(), or from a
+	// capture file, may be any length, not just a power of two.
 	unsigned operator[](unsigned addr) {
-		if ((m_data)&&(m_scoplen > 0))
+		if ((!m_data)||(m_scoplen == 0))
+			return 0;
+		if ((m_scoplen & (m_scoplen-1)) == 0)
 			return m_data[(addr)&(m_scoplen-1)];
-		return 0;
+		return m_data[addr % m_scoplen];
 	}
+
+protected:
+	// Read ln words of the scope's buffer, starting pos words after the
+	// oldest, into buf.  The readout calls this with pos starting at
+	// zero and increasing from one call to the next.  By default this
+	// reads from the scope's data register, but scopes whose data can
+	// be found elsewhere may override it.
+	virtual	void	read_words(unsigned pos, unsigned ln,
+				DEVBUS::BUSW *buf);
+
+	// Set things up so the next read_words() call can start at word pos,
+	// to resume a readout after an error.  Returns false if that can't
+	// be done.  By default this seeks, if the scope allows it.
+	virtual	bool	seek_words(unsigned pos);
 };
 
 #endif	// SCOPECLS_H
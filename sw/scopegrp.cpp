@@ -0,0 +1,163 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	scopegrp.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Implements the SCOPE_GROUP, a manager for polling and reading
+//		out many scopes sharing a single debug bus.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "devbus.h"
+#include "scopecls.h"
+#include "scopegrp.h"
+
+// elapsed
+// {{{
+static	double	elapsed(const struct timespec &a, const struct timespec &b) {
+	return (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) * 1e-9;
+}
+// }}}
+
+// SCOPE_GROUP::add
+// {{{
+void	SCOPE_GROUP::add(SCOPE *scope) {
+	GROUP_ENTRY	e;
+
+	e.m_scope   = scope;
+	e.m_stopped = false;
+	e.m_done    = false;
+	e.m_latency = 0.0;
+	e.m_ctrl    = 0;
+	m_scopes.push_back(e);
+}
+// }}}
+
+// SCOPE_GROUP::poll
+// {{{
+unsigned	SCOPE_GROUP::poll(void) {
+	struct timespec	now;
+
+	if (m_scopes.size() == 0)
+		return 0;
+
+	// Read every control register, and only the control registers.
+	// Reading a data register would advance that scope's read pointer.
+	for(unsigned k=0; k<m_scopes.size(); k++)
+		m_scopes[k].m_ctrl = m_fpga->readio(
+			m_scopes[k].m_scope->address());
+	m_polls++;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	for(unsigned k=0; k<m_scopes.size(); k++) {
+		GROUP_ENTRY	&e = m_scopes[k];
+
+		if ((!e.m_stopped)&&(e.m_scope->ready(e.m_ctrl))) {
+			e.m_stopped = true;
+			e.m_seen    = now;
+			m_queue.push_back(k);
+		}
+	}
+
+	return m_queue.size();
+}
+// }}}
+
+// SCOPE_GROUP::acquire
+// {{{
+bool	SCOPE_GROUP::acquire(int timeout_ms) {
+	struct timespec	start, now;
+	unsigned	ndone = 0, delay_us = 100;
+	const unsigned	MAX_DELAY_US = 100000;
+
+	for(unsigned k=0; k<m_scopes.size(); k++)
+		if (m_scopes[k].m_done)
+			ndone++;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while(ndone < m_scopes.size()) {
+		if (poll() == 0) {
+			// Nothing to read.  Back off before polling again.
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if ((timeout_ms >= 0)
+				&&(elapsed(start, now) * 1e3 >= timeout_ms))
+				return false;
+			usleep(delay_us);
+			delay_us *= 2;
+			if (delay_us > MAX_DELAY_US)
+				delay_us = MAX_DELAY_US;
+			continue;
+		}
+
+		// Read out the scope that stopped first, then come back and
+		// poll again before the next, so that everything that has
+		// stopped in the meantime gets queued behind it.
+		unsigned	k = m_queue[0];
+		GROUP_ENTRY	&e = m_scopes[k];
+
+		m_queue.erase(m_queue.begin());
+
+		e.m_scope->rawread();
+		e.m_scope->join_reader();
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		e.m_latency = elapsed(e.m_seen, now);
+		e.m_done = true;
+		ndone++;
+		delay_us = 100;
+	}
+
+	return true;
+}
+// }}}
+
+// SCOPE_GROUP::report
+// {{{
+void	SCOPE_GROUP::report(FILE *fp) {
+	fprintf(fp, "%d scopes, %ld polls\n", (int)m_scopes.size(), m_polls);
+	for(unsigned k=0; k<m_scopes.size(); k++) {
+		GROUP_ENTRY	&e = m_scopes[k];
+
+		fprintf(fp, "  SCOPE @0x%08x: ", e.m_scope->address());
+		if (e.m_done)
+			fprintf(fp, "%.6f s from stop to data\n", e.m_latency);
+		else if (e.m_stopped)
+			fprintf(fp, "stopped, not yet read\n");
+		else
+			fprintf(fp, "not yet stopped\n");
+	}
+}
+// }}}
@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	scopegrp.h
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Many designs have several scopes behind one debug link.  This
+//		file defines a SCOPE_GROUP, which polls all of them at once and
+//	reads out each scope as soon as it stops, so that the host needn't
+//	walk through the scopes one at a time.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	SCOPEGRP_H
+#define	SCOPEGRP_H
+
+#include <vector>
+#include <time.h>
+#include "devbus.h"
+#include "scopecls.h"
+
+/*
+ * SCOPE_GROUP
+ * {{{
+ * Manages a set of SCOPEs sharing a single DEVBUS.  The control registers of
+ * all scopes are polled together, one readio() per scope.  (A single readi()
+ * across scopes packed together in the address space would also read their
+ * data registers, advancing the read pointer of any scope that had stopped.)
+ * Scopes that have stopped are then read out, oldest stop first,
+ * re-polling between readouts so that scopes stopping in the meantime join
+ * the queue.  The time from seeing each scope stopped until its data is in
+ * memory is recorded as that scope's latency.
+ * }}}
+ */
+class	SCOPE_GROUP {
+	struct	GROUP_ENTRY {
+		SCOPE		*m_scope;
+		bool		m_stopped, m_done;
+		struct timespec	m_seen;
+		double		m_latency;
+		DEVBUS::BUSW	m_ctrl;
+	};
+
+	DEVBUS		*m_fpga;
+	std::vector<GROUP_ENTRY>	m_scopes;
+	// The order scopes were seen to stop, for reading them out
+	std::vector<unsigned>		m_queue;
+	unsigned long	m_polls;
+public:
+	SCOPE_GROUP(DEVBUS *fpga) : m_fpga(fpga), m_polls(0) {}
+
+	// Add a scope to the group.  The group doesn't take ownership of the
+	// scope, it must still be deleted by the caller.
+	void	add(SCOPE *scope);
+
+	unsigned	size(void) const { return m_scopes.size(); }
+	SCOPE	*operator[](unsigned k) { return m_scopes[k].m_scope; }
+
+	// Read all of the scopes' control registers, noting any that have
+	// newly stopped.  Returns the number of scopes that have stopped
+	// but not yet been read out.
+	unsigned	poll(void);
+
+	// Poll, and read out whichever scopes have stopped, until all scopes
+	// have been read out or timeout_ms milliseconds have passed (negative
+	// for no timeout).  Returns true if all of the scopes were read.
+	bool	acquire(int timeout_ms = -1);
+
+	// Has scope k been read out?
+	bool	done(unsigned k) const { return m_scopes[k].m_done; }
+
+	// The time, in seconds, from when scope k was first seen to be
+	// stopped until its data was read into memory
+	double	latency(unsigned k) const { return m_scopes[k].m_latency; }
+
+	// The number of polls of the control registers made so far
+	unsigned long	polls(void) const { return m_polls; }
+
+	// Write out a summary of each scope's latency
+	void	report(FILE *fp);
+};
+
+#endif	// SCOPEGRP_H
@@ -0,0 +1,448 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	search.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Searches a capture's raw words for the patterns described in
+//		search.h, using SIMD compare kernels where the CPU has them to test
+//	many words at once.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+#include "search.h"
+
+#if	defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define	SEARCH_X86
+#include <immintrin.h>
+#endif
+
+// The number of words tested at a time by SEARCH::find()
+#define	SEARCH_BLOCK	4096
+
+// a+b, or the largest clock if that would overflow
+static inline	uint64_t	sat_add(uint64_t a, uint64_t b) {
+	return (a > UINT64_MAX - b) ? UINT64_MAX : a+b;
+}
+
+// Clear the bits of e for run-length words (those set in r), and then give
+// each the bit of the word before it instead.  carry is the bit of the word
+// before bit zero, and is updated to bit 31.  The bits are spread through
+// any stretch of consecutive runs in five steps, each doubling the distance
+// covered, rather than one run at a time.
+static inline	uint32_t	inherit(uint32_t e, uint32_t r,
+		uint32_t &carry) {
+	uint32_t	g = r;
+
+	e = (e & ~r) | (r & carry & 1);
+	e |= (e << 1)  & g;	g &= g << 1;
+	e |= (e << 2)  & g;	g &= g << 2;
+	e |= (e << 4)  & g;	g &= g << 4;
+	e |= (e << 8)  & g;	g &= g << 8;
+	e |= (e << 16) & g;
+
+	carry = e >> 31;
+	return e;
+}
+
+// match_bits_scalar
+// {{{
+void	match_bits_scalar(const uint32_t *data, unsigned n,
+		uint32_t mask, uint32_t value,
+		uint32_t *mbits, uint32_t *rbits,
+		uint32_t pmask, uint32_t pvalue, uint32_t *pbits) {
+	unsigned	nw = (n+31)/32;
+
+	memset(mbits, 0, nw * sizeof(uint32_t));
+	if (rbits)
+		memset(rbits, 0, nw * sizeof(uint32_t));
+	if (pbits)
+		memset(pbits, 0, nw * sizeof(uint32_t));
+
+	for(unsigned i=0; i<n; i++) {
+		if ((data[i] & mask) == value)
+			mbits[i>>5] |= 1u << (i&31);
+		if ((rbits)&&(data[i] & 0x80000000))
+			rbits[i>>5] |= 1u << (i&31);
+		if ((pbits)&&((data[i] & pmask) == pvalue))
+			pbits[i>>5] |= 1u << (i&31);
+	}
+}
+// }}}
+
+#ifdef	SEARCH_X86
+// AVX2 kernel
+// {{{
+// Eight words per compare, four compares per 32 bits of results.  The run
+// bits are just the words' sign bits, which movemask hands us for free.
+__attribute__((target("avx2")))
+static	void	avx2_match(const uint32_t *data, unsigned n,
+		uint32_t mask, uint32_t value,
+		uint32_t *mbits, uint32_t *rbits,
+		uint32_t pmask, uint32_t pvalue, uint32_t *pbits) {
+	const __m256i	vmask   = _mm256_set1_epi32((int)mask),
+			vvalue  = _mm256_set1_epi32((int)value),
+			vpmask  = _mm256_set1_epi32((int)pmask),
+			vpvalue = _mm256_set1_epi32((int)pvalue);
+	unsigned	i;
+
+	for(i=0; i+32 <= n; i+=32) {
+		uint32_t	m = 0, r = 0, p = 0;
+
+		for(unsigned g=0; g<4; g++) {
+			__m256i	v = _mm256_loadu_si256(
+					(const __m256i *)&data[i+8*g]);
+			__m256i	eq = _mm256_cmpeq_epi32(
+					_mm256_and_si256(v, vmask), vvalue);
+
+			m |= (uint32_t)_mm256_movemask_ps(
+					_mm256_castsi256_ps(eq)) << (8*g);
+			r |= (uint32_t)_mm256_movemask_ps(
+					_mm256_castsi256_ps(v)) << (8*g);
+			if (pbits) {
+				eq = _mm256_cmpeq_epi32(
+					_mm256_and_si256(v, vpmask), vpvalue);
+				p |= (uint32_t)_mm256_movemask_ps(
+					_mm256_castsi256_ps(eq)) << (8*g);
+			}
+		}
+
+		mbits[i>>5] = m;
+		if (rbits)
+			rbits[i>>5] = r;
+		if (pbits)
+			pbits[i>>5] = p;
+	}
+
+	// Any words left over, fewer than 32 of them
+	if (i < n)
+		match_bits_scalar(&data[i], n-i, mask, value, &mbits[i>>5],
+			(rbits) ? &rbits[i>>5] : NULL,
+			pmask, pvalue, (pbits) ? &pbits[i>>5] : NULL);
+}
+// }}}
+
+// SSE2 kernel
+// {{{
+// As above, but four words per compare
+static	void	sse2_match(const uint32_t *data, unsigned n,
+		uint32_t mask, uint32_t value,
+		uint32_t *mbits, uint32_t *rbits,
+		uint32_t pmask, uint32_t pvalue, uint32_t *pbits) {
+	const __m128i	vmask   = _mm_set1_epi32((int)mask),
+			vvalue  = _mm_set1_epi32((int)value),
+			vpmask  = _mm_set1_epi32((int)pmask),
+			vpvalue = _mm_set1_epi32((int)pvalue);
+	unsigned	i;
+
+	for(i=0; i+32 <= n; i+=32) {
+		uint32_t	m = 0, r = 0, p = 0;
+
+		for(unsigned g=0; g<8; g++) {
+			__m128i	v = _mm_loadu_si128(
+					(const __m128i *)&data[i+4*g]);
+			__m128i	eq = _mm_cmpeq_epi32(
+					_mm_and_si128(v, vmask), vvalue);
+
+			m |= (uint32_t)_mm_movemask_ps(
+					_mm_castsi128_ps(eq)) << (4*g);
+			r |= (uint32_t)_mm_movemask_ps(
+					_mm_castsi128_ps(v)) << (4*g);
+			if (pbits) {
+				eq = _mm_cmpeq_epi32(
+					_mm_and_si128(v, vpmask), vpvalue);
+				p |= (uint32_t)_mm_movemask_ps(
+					_mm_castsi128_ps(eq)) << (4*g);
+			}
+		}
+
+		mbits[i>>5] = m;
+		if (rbits)
+			rbits[i>>5] = r;
+		if (pbits)
+			pbits[i>>5] = p;
+	}
+
+	if (i < n)
+		match_bits_scalar(&data[i], n-i, mask, value, &mbits[i>>5],
+			(rbits) ? &rbits[i>>5] : NULL,
+			pmask, pvalue, (pbits) ? &pbits[i>>5] : NULL);
+}
+// }}}
+
+static	bool	has_avx2(void) {
+	static	const bool	avx2 = __builtin_cpu_supports("avx2");
+	return avx2;
+}
+#endif
+
+// match_bits
+// {{{
+void	match_bits(const uint32_t *data, unsigned n,
+		uint32_t mask, uint32_t value,
+		uint32_t *mbits, uint32_t *rbits,
+		uint32_t pmask, uint32_t pvalue, uint32_t *pbits) {
+#ifdef	SEARCH_X86
+	if (has_avx2())
+		avx2_match(data, n, mask, value, mbits, rbits,
+			pmask, pvalue, pbits);
+	else
+		sse2_match(data, n, mask, value, mbits, rbits,
+			pmask, pvalue, pbits);
+#else
+	match_bits_scalar(data, n, mask, value, mbits, rbits,
+		pmask, pvalue, pbits);
+#endif
+}
+// }}}
+
+// SEARCH::SCANNER::SCANNER
+// {{{
+SEARCH::SCANNER::SCANNER(const SEARCH &search, const TERM &term, bool starts)
+		: m_search(search), m_term(term), m_starts(starts),
+		m_pos(0), m_mstart(0) {
+	// A run at the very start repeats a value we never saw, and so
+	// reads as zero--as in SCOPE::value_at()
+	m_ecarry = (term.m_value == 0) ? 1:0;
+	m_pcarry = (term.m_pvalue == 0) ? 1:0;
+	// The prior clock's match, shifted into each word.  Clock zero has
+	// no prior clock.
+	m_pin  = 0;
+	// Whether the last word scanned matched, leaving a match open from
+	// word m_mstart
+	m_open = 0;
+}
+// }}}
+
+// SEARCH::SCANNER::scan
+// {{{
+unsigned	SEARCH::SCANNER::scan(unsigned nwords,
+		std::vector<MATCH> &matches) {
+	uint32_t	mb[SEARCH_BLOCK/32], pb[SEARCH_BLOCK/32],
+			rb[SEARCH_BLOCK/32];
+	const TERM	&term = m_term;
+	const bool	prior = (term.m_pmask != 0),
+			compressed = m_search.m_compressed;
+	const uint32_t	*data = m_search.m_data;
+	unsigned	len = m_search.m_len, start = m_pos, end;
+
+	// Scans end on a multiple of 32 words, so only the last bits of the
+	// capture are ever scanned without the rest of their word
+	if (nwords < len - m_pos)
+		nwords = (nwords + 31) & -32;
+	end = (nwords >= len - m_pos) ? len : m_pos + nwords;
+	for(unsigned base=m_pos; base<end; base+=SEARCH_BLOCK) {
+		unsigned	nb = end - base, nw;
+
+		if (nb > SEARCH_BLOCK)
+			nb = SEARCH_BLOCK;
+		nw = (nb+31)/32;
+
+		// Both halves of the TERM are tested in the same pass
+		match_bits(&data[base], nb, term.m_mask, term.m_value, mb,
+			(compressed) ? rb : NULL, term.m_pmask, term.m_pvalue,
+			(prior) ? pb : NULL);
+
+		for(unsigned j=0; j<nw; j++) {
+			uint32_t	w = mb[j], starts, ends;
+
+			if (compressed)
+				w = inherit(w, rb[j], m_ecarry);
+			if (prior) {
+				uint32_t	p = pb[j];
+
+				if (compressed)
+					p = inherit(p, rb[j], m_pcarry);
+				w &= (p << 1) | m_pin;
+				m_pin = p >> 31;
+			}
+
+			// Bits past the end of the capture are always clear,
+			// closing any match left open there
+			starts = w & ~((w << 1) | m_open);
+			ends   = ~w & ((w << 1) | m_open);
+			m_open = w >> 31;
+
+			if (m_starts) {
+				// Only the starts are wanted, and they're
+				// reported right away
+				for(uint32_t t = starts; t; t &= t-1) {
+					MATCH	m;
+
+					m.m_clk = m_search.clock(base + 32*j
+						+ __builtin_ctz(t));
+					m.m_nclks = 0;
+					matches.push_back(m);
+				} continue;
+			}
+
+			for(uint32_t t = starts | ends; t; t &= t-1) {
+				unsigned	p = __builtin_ctz(t),
+						i = base + 32*j + p;
+
+				if (starts & (1u << p))
+					m_mstart = i;
+				else {
+					MATCH	m;
+
+					m.m_clk   = m_search.clock(m_mstart);
+					m.m_nclks = m_search.clock(i) - m.m_clk;
+					matches.push_back(m);
+				}
+			}
+		}
+	}
+
+	m_pos = end;
+	if ((m_pos >= len)&&(m_open)) {
+		if (!m_starts) {
+			MATCH	m;
+
+			m.m_clk   = m_search.clock(m_mstart);
+			m.m_nclks = m_search.clock(len) - m.m_clk;
+			matches.push_back(m);
+		}
+		m_open = 0;
+	}
+
+	return end - start;
+}
+// }}}
+
+// SEARCH::find (a single TERM)
+// {{{
+void	SEARCH::find(const TERM &term, std::vector<MATCH> &matches) const {
+	SCANNER(*this, term).scan(m_len, matches);
+}
+// }}}
+
+// SEARCH::find (a sequence)
+// {{{
+// The clocks where each step can complete the sequence so far are found in
+// turn: those where the step's TERM matches, that are also within the allowed
+// gap of a clock where the step before could complete it.  Each step's set of
+// clocks is kept as a list of intervals, so that once the last step has been
+// reached we can work back to where the sequence started.
+void	SEARCH::find(const std::vector<STEP> &seq,
+		std::vector<MATCH> &matches) const {
+	std::vector<std::vector<MATCH> >	reach(seq.size());
+
+	if (seq.size() == 0)
+		return;
+
+	find(seq[0].m_term, reach[0]);
+	for(unsigned s=1; s<seq.size(); s++) {
+		std::vector<MATCH>	hits, window;
+		const std::vector<MATCH>	&prev = reach[s-1];
+
+		if (prev.size() == 0)
+			return;
+		find(seq[s].m_term, hits);
+
+		// The clocks within the allowed gap of the last step,
+		// merging any intervals that overlap
+		for(unsigned k=0; k<prev.size(); k++) {
+			uint64_t	a = sat_add(prev[k].m_clk, seq[s].m_min),
+					b = sat_add(prev[k].m_clk + prev[k].m_nclks,
+						seq[s].m_max);
+
+			if (a >= b)
+				continue;
+			if ((window.size() > 0)&&(a <= window.back().m_clk
+						+ window.back().m_nclks)) {
+				MATCH	&w = window.back();
+
+				if (b > w.m_clk + w.m_nclks)
+					w.m_nclks = b - w.m_clk;
+			} else {
+				MATCH	w;
+
+				w.m_clk = a;
+				w.m_nclks = b - a;
+				window.push_back(w);
+			}
+		}
+
+		// Intersect those with the clocks where this step matches
+		std::vector<MATCH>	&here = reach[s];
+		unsigned		h = 0, w = 0;
+
+		while((h < hits.size())&&(w < window.size())) {
+			uint64_t	a = std::max(hits[h].m_clk, window[w].m_clk),
+					he = hits[h].m_clk + hits[h].m_nclks,
+					we = window[w].m_clk + window[w].m_nclks,
+					b = std::min(he, we);
+
+			if (a < b) {
+				MATCH	m;
+
+				m.m_clk   = a;
+				m.m_nclks = b - a;
+				here.push_back(m);
+			}
+
+			if (he < we)
+				h++;
+			else
+				w++;
+		}
+	}
+
+	// Work back from the first clock of each interval of the last step,
+	// taking the latest clock each step before could have matched at
+	const std::vector<MATCH>	&done = reach.back();
+
+	for(unsigned k=0; k<done.size(); k++) {
+		uint64_t	end = done[k].m_clk, clk = end;
+
+		for(unsigned s=seq.size()-1; s>0; s--) {
+			const std::vector<MATCH>	&prev = reach[s-1];
+			uint64_t	latest = clk - std::min(clk, seq[s].m_min);
+			std::vector<MATCH>::const_iterator	p;
+
+			p = std::upper_bound(prev.begin(), prev.end(), latest,
+				[](uint64_t v, const MATCH &m) {
+					return v < m.m_clk; }) - 1;
+			clk = std::min(latest, p->m_clk + p->m_nclks - 1);
+		}
+
+		MATCH	m;
+
+		m.m_clk   = clk;
+		m.m_nclks = end - clk + 1;
+		matches.push_back(m);
+	}
+}
+// }}}
@@ -0,0 +1,186 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	search.h
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Declares SEARCH, which looks through a capture for the clocks
+//		where a pattern matches: a set of bits taking on given values,
+//	possibly also requiring values on the clock before (an edge), or an
+//	ordered sequence of such patterns with limits on the time between them.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	SEARCH_H
+#define	SEARCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/*
+ * SEARCH
+ * {{{
+ * Finds where patterns match within a capture, in clocks counted from the
+ * first clock of the capture--the same clocks used by SCOPE::value_at().
+ *
+ * The raw words are tested for each pattern a block at a time, by a SIMD
+ * kernel producing one bit per word.  For compressed (wbscopc) captures, the
+ * kernel also marks the run-length words, which then simply take on the
+ * result of the word they repeat--so a run of a million clocks costs no more
+ * than any other word.  Matches are then read from the bits as intervals of
+ * consecutive matching words, and converted to clocks with the capture's
+ * time index.
+ * }}}
+ */
+class	SEARCH {
+public:
+	// A pattern to match, one clock at a time.  A clock matches if
+	// (word & m_mask) == m_value for that clock, and (word & m_pmask) ==
+	// m_pvalue for the clock before it.  Clock zero, having no clock
+	// before it, only matches patterns with no m_pmask.  For example,
+	//	TERM().is(mask, opcode)			a field holding a value
+	//	TERM().was(bit, 0).is(bit, bit)		a rising edge
+	//	TERM().was(SDA, SDA).is(SDA|SCL, SCL)	an I2C start condition
+	struct	TERM {
+		uint32_t	m_mask, m_value, m_pmask, m_pvalue;
+
+		TERM(void) : m_mask(0), m_value(0), m_pmask(0), m_pvalue(0) {}
+
+		// Require (word & mask) == (value & mask) on this clock
+		TERM	&is(uint32_t mask, uint32_t value) {
+			m_mask |= mask;
+			m_value = (m_value & ~mask) | (value & mask);
+			return *this;
+		}
+
+		// Require (word & mask) == (value & mask) on the clock before
+		TERM	&was(uint32_t mask, uint32_t value) {
+			m_pmask |= mask;
+			m_pvalue = (m_pvalue & ~mask) | (value & mask);
+			return *this;
+		}
+	};
+
+	// One step of a sequence: a TERM that must match between m_min and
+	// m_max clocks (inclusive) after the step before it.  The first
+	// step's m_min and m_max are ignored.
+	struct	STEP {
+		TERM		m_term;
+		uint64_t	m_min, m_max;
+	};
+
+	// A match, starting at clock m_clk and lasting m_nclks clocks
+	struct	MATCH {
+		uint64_t	m_clk, m_nclks;
+	};
+
+private:
+	const uint32_t	*m_data;
+	unsigned	m_len;
+	bool		m_compressed;
+	const uint64_t	*m_tindex;
+
+	// The clock of word i
+	uint64_t	clock(unsigned i) const {
+		return (m_tindex) ? m_tindex[i] : i;
+	}
+
+public:
+	// Search the len words of data.  For a compressed capture, tindex
+	// must be its time index, as built by SCOPE, with tindex[i] the first
+	// clock of word i and tindex[len] the number of clocks in all.
+	SEARCH(const uint32_t *data, unsigned len, bool compressed,
+			const uint64_t *tindex = NULL)
+		: m_data(data), m_len(len), m_compressed(compressed),
+			m_tindex((compressed) ? tindex : NULL) {}
+
+	// Searches for one TERM a piece at a time, so that a capture of any
+	// length can be searched without holding all of its matches--and so
+	// that several searches can be run side by side, in step.
+	class	SCANNER {
+		const SEARCH	&m_search;
+		TERM		m_term;
+		bool		m_starts;
+		unsigned	m_pos, m_mstart;
+		// The matches of the last word scanned, for those words
+		// following it: see SEARCH::find()
+		uint32_t	m_ecarry, m_pcarry, m_pin, m_open;
+	public:
+		// If starts is set, each match is reported as soon as it
+		// starts, with an m_nclks of zero, rather than once it ends
+		SCANNER(const SEARCH &search, const TERM &term,
+				bool starts = false);
+
+		// Scan the next nwords words (rounded up to a multiple of 32,
+		// or as many as are left), appending their matches to
+		// matches.  Returns the number of
+		// words scanned, zero once at the end of the capture.
+		unsigned	scan(unsigned nwords,
+					std::vector<MATCH> &matches);
+
+		// The number of words scanned so far
+		unsigned	position(void) const { return m_pos; }
+	};
+
+	// Find every clock where a TERM matches, as a list of (maximal)
+	// intervals in increasing order.  Matches are appended to matches.
+	void	find(const TERM &term, std::vector<MATCH> &matches) const;
+
+	// Find every occurrence of a sequence of steps.  For each interval of
+	// clocks where the last step completes the sequence, one match is
+	// reported, starting at the latest clock the first step could have
+	// matched at and ending at the first clock of that interval.
+	void	find(const std::vector<STEP> &seq,
+			std::vector<MATCH> &matches) const;
+};
+
+// Set one bit in mbits for each of the n words of data for which
+// (data[i] & mask) == value, and--if rbits isn't NULL--one bit in rbits for
+// each run-length word (one with its top bit set).  If pbits isn't NULL, a
+// second pattern, pmask and pvalue, is tested in the same pass, setting bits
+// in pbits.  Bit i is bit (i&31) of word (i>>5).  Bits past n in the last word
+// are cleared.
+//
+// match_bits() uses SIMD compares where the CPU has them: eight words at once
+// with AVX2, four with SSE2.  match_bits_scalar() is the plain C++ reference
+// it must match.
+extern	void	match_bits(const uint32_t *data, unsigned n,
+			uint32_t mask, uint32_t value,
+			uint32_t *mbits, uint32_t *rbits,
+			uint32_t pmask = 0, uint32_t pvalue = 0,
+			uint32_t *pbits = NULL);
+extern	void	match_bits_scalar(const uint32_t *data, unsigned n,
+			uint32_t mask, uint32_t value,
+			uint32_t *mbits, uint32_t *rbits,
+			uint32_t pmask = 0, uint32_t pvalue = 0,
+			uint32_t *pbits = NULL);
+
+#endif	// SEARCH_H
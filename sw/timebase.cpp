@@ -0,0 +1,177 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	timebase.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Converts clock (or half clock) counts into VCD timestamps, using
+//		exact integer arithmetic.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdint.h>
+
+#include "timebase.h"
+
+// The finest timescale VCD allows: 1fs
+static	const	uint64_t	FEMTOSECONDS = 1000000000000000ull;
+
+// TIMEBASE::setup
+// {{{
+void	TIMEBASE::setup(uint64_t rate, uint64_t units) {
+	static	const	char	*names[] = { "s", "ms", "us", "ns", "ps", "fs"};
+	unsigned	lg = 0, mul = 1;
+
+	if (rate == 0)
+		rate = 1;
+	if (units == 0)
+		units = choose_units(&rate, 1);
+
+	m_rate  = rate;
+	m_units = units;
+	m_quot  = units / rate;
+	m_rem   = units % rate;
+
+	// Units of 10^-lg seconds are written as 1, 10 or 100 of the next
+	// SI unit down
+	for(uint64_t u = units; u > 1; u /= 10)
+		lg++;
+	while(lg % 3 != 0) {
+		lg++;
+		mul *= 10;
+	}
+	snprintf(m_timescale, sizeof(m_timescale), "%u%s", mul, names[lg/3]);
+}
+// }}}
+
+// TIMEBASE::choose_units
+// {{{
+uint64_t	TIMEBASE::choose_units(const uint64_t *rates, unsigned n) {
+	uint64_t	fastest = 1;
+
+	for(uint64_t units = 1; units <= FEMTOSECONDS; units *= 10) {
+		bool	exact = true;
+
+		for(unsigned k=0; k<n; k++)
+			if ((rates[k] != 0)&&(units % rates[k] != 0))
+				exact = false;
+		if (exact)
+			return units;
+	}
+
+	// No timescale gives exact times.  Settle for at least 1000 units
+	// per step.
+	for(unsigned k=0; k<n; k++)
+		if (rates[k] > fastest)
+			fastest = rates[k];
+	for(uint64_t units = 1; units < FEMTOSECONDS; units *= 10)
+		if (units / fastest >= 1000)
+			return units;
+	return FEMTOSECONDS;
+}
+// }}}
+
+// TIMEBASE::time
+// {{{
+uint64_t	TIMEBASE::time(uint64_t n) const {
+	TIME	tm;
+
+	seek(n, tm);
+	return tm.m_time;
+}
+// }}}
+
+// muldivmod
+// {{{
+// Find q and r such that a*b + c == q*d + r, with r < d.  Both b and c must be
+// less than d, so that q fits in 64 bits.
+static void	muldivmod(uint64_t a, uint64_t b, uint64_t c, uint64_t d,
+		uint64_t &q, uint64_t &r) {
+#ifdef	__SIZEOF_INT128__
+	unsigned __int128	v = (unsigned __int128)a * b + c;
+
+	q = (uint64_t)(v / d);
+	r = (uint64_t)(v % d);
+#else
+	// Without a 128-bit type (as on 32-bit hosts), build a*b up one bit
+	// of a at a time, from the top, keeping it as q*d + r so that
+	// nothing overflows
+	q = 0;
+	r = 0;
+	for(int k=63; k>=0; k--) {
+		// Double what we have so far ...
+		q <<= 1;
+		if (r >= d - r) {
+			r -= d - r;
+			q++;
+		} else
+			r += r;
+
+		// ... and add b, if this bit of a is set
+		if ((a >> k) & 1) {
+			if (r >= d - b) {
+				r -= d - b;
+				q++;
+			} else
+				r += b;
+		}
+	}
+
+	if (r >= d - c) {
+		r -= d - c;
+		q++;
+	} else
+		r += c;
+#endif
+}
+// }}}
+
+// TIMEBASE::seek
+// {{{
+void	TIMEBASE::seek(uint64_t n, TIME &tm) const {
+	uint64_t	q, r;
+
+	muldivmod(n, m_rem, 0, m_rate, q, r);
+	tm.m_time = n * m_quot + q;
+	tm.m_frac = r;
+}
+// }}}
+
+// TIMEBASE::step
+// {{{
+void	TIMEBASE::step(TIME &tm, uint64_t n) const {
+	uint64_t	q, r;
+
+	muldivmod(n, m_rem, tm.m_frac, m_rate, q, r);
+	tm.m_time += n * m_quot + q;
+	tm.m_frac  = r;
+}
+// }}}
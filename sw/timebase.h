@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	timebase.h
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Converts clock (or half clock) counts into VCD timestamps, using
+//		exact integer arithmetic, within a timescale chosen to suit the
+//		clock rate.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	TIMEBASE_H
+#define	TIMEBASE_H
+
+#include <stdint.h>
+
+/*
+ * TIMEBASE
+ * {{{
+ * Maps step numbers, counted at m_rate steps per second, onto integer times
+ * in units of 1/m_units seconds.  Step n falls at time floor(n*m_units/m_rate),
+ * computed exactly, so there's no drift however long the capture, and no
+ * floating point.
+ *
+ * The units are chosen as the coarsest VCD timescale (1s, 100ms, 10ms, ...,
+ * 1fs) in which every step falls on an exact integer time.  If there is no
+ * such timescale, as with a 148.5MHz clock, the units are instead chosen fine
+ * enough to give at least 1000 units per step.
+ *
+ * When walking through the steps in order, a TIME holds both the integer time
+ * and the fraction left over, so each step costs only an add and a compare.
+ * }}}
+ */
+class	TIMEBASE {
+	uint64_t	m_rate, m_units,
+			// Units per step, m_quot + m_rem/m_rate
+			m_quot, m_rem;
+	char		m_timescale[8];
+
+	void	setup(uint64_t rate, uint64_t units);
+public:
+	// A time, m_time + m_frac/m_rate units
+	struct	TIME {
+		uint64_t	m_time, m_frac;
+	};
+
+	// Build a timebase for rate steps per second, in units of
+	// 1/units seconds--or, if units is zero, whatever units suit rate.
+	TIMEBASE(uint64_t rate, uint64_t units = 0) { setup(rate, units); }
+
+	// Return the coarsest units (as units per second) in which every one
+	// of the n given rates has an exact period.  If there are none, return
+	// units giving at least 1000 units to the period of the fastest.
+	static	uint64_t	choose_units(const uint64_t *rates, unsigned n);
+
+	uint64_t	rate(void)  const { return m_rate; }
+	uint64_t	units(void) const { return m_units; }
+
+	// The VCD $timescale for our units, such as "1ns" or "10ps"
+	const char	*timescale(void) const { return m_timescale; }
+
+	// Return the time of step n
+	uint64_t	time(uint64_t n) const;
+
+	// Set tm to the time of step n
+	void	seek(uint64_t n, TIME &tm) const;
+
+	// Advance tm by one step, or by n steps
+	void	step(TIME &tm) const {
+		tm.m_time += m_quot;
+		tm.m_frac += m_rem;
+		if (tm.m_frac >= m_rate) {
+			tm.m_frac -= m_rate;
+			tm.m_time++;
+		}
+	}
+	void	step(TIME &tm, uint64_t n) const;
+};
+
+#endif	// TIMEBASE_H
@@ -0,0 +1,267 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	tracecol.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Extracts TRACECOL columns from the raw words of a capture.  The
+//		shift, mask and packing is done eight words at a time using
+//	AVX2 where the CPU supports it, SSE2 for bit-planes otherwise, and a
+//	plain scalar loop everywhere else.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "tracecol.h"
+
+#if	defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define	TRACECOL_X86
+#include <immintrin.h>
+#endif
+
+// Scalar kernels
+// {{{
+static	void	scalar_plane(uint64_t *plane, const uint32_t *data,
+		unsigned start, unsigned len, unsigned nshift) {
+	for(unsigned i=start; i<len; i++)
+		plane[i>>6] |= (uint64_t)((data[i] >> nshift)&1) << (i&63);
+}
+
+template<class T> static	void	scalar_field(T *col, const uint32_t *data,
+		unsigned start, unsigned len, unsigned nshift, uint32_t mask) {
+	for(unsigned i=start; i<len; i++)
+		col[i] = (T)((data[i] >> nshift) & mask);
+}
+// }}}
+
+#ifdef	TRACECOL_X86
+// SSE2 kernels
+// {{{
+// Bit-planes: shift the bit of interest up to bit 31 of each word, and then
+// let movemask collect those sign bits, four words at a time.
+static	unsigned	sse2_plane(uint64_t *plane, const uint32_t *data,
+		unsigned i, unsigned len, unsigned nshift) {
+	const __m128i	cnt = _mm_cvtsi32_si128(31-nshift);
+
+	for(; i+4<=len; i+=4) {
+		__m128i	v = _mm_loadu_si128((const __m128i *)&data[i]);
+		v = _mm_sll_epi32(v, cnt);
+		plane[i>>6] |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(v))
+				<< (i&63);
+	} return i;
+}
+// }}}
+
+// AVX2 kernels
+// {{{
+__attribute__((target("avx2")))
+static	unsigned	avx2_plane(uint64_t *plane, const uint32_t *data,
+		unsigned i, unsigned len, unsigned nshift) {
+	const __m128i	cnt = _mm_cvtsi32_si128(31-nshift);
+
+	for(; i+8<=len; i+=8) {
+		__m256i	v = _mm256_loadu_si256((const __m256i *)&data[i]);
+		v = _mm256_sll_epi32(v, cnt);
+		plane[i>>6] |= (uint64_t)(unsigned)_mm256_movemask_ps(
+				_mm256_castsi256_ps(v)) << (i&63);
+	} return i;
+}
+
+// Load eight words, and shift and mask the field of interest
+__attribute__((target("avx2")))
+static inline	__m256i	avx2_field(const uint32_t *data, __m128i cnt,
+		__m256i mask) {
+	__m256i	v = _mm256_loadu_si256((const __m256i *)data);
+	return _mm256_and_si256(_mm256_srl_epi32(v, cnt), mask);
+}
+
+__attribute__((target("avx2")))
+static	unsigned	avx2_u8(uint8_t *col, const uint32_t *data,
+		unsigned i, unsigned len, unsigned nshift, uint32_t mask) {
+	const __m128i	cnt  = _mm_cvtsi32_si128(nshift);
+	const __m256i	vmsk = _mm256_set1_epi32(mask);
+	// The two packs work within each 128-bit lane, leaving the 32-bit
+	// groups in the order a0 b0 c0 d0 a1 b1 c1 d1.  This puts them back.
+	const __m256i	perm = _mm256_setr_epi32(0,4,1,5,2,6,3,7);
+
+	for(; i+32<=len; i+=32) {
+		__m256i	a = avx2_field(&data[i   ], cnt, vmsk),
+			b = avx2_field(&data[i+ 8], cnt, vmsk),
+			c = avx2_field(&data[i+16], cnt, vmsk),
+			d = avx2_field(&data[i+24], cnt, vmsk);
+		__m256i	ab = _mm256_packus_epi32(a, b),
+			cd = _mm256_packus_epi32(c, d);
+		__m256i	v  = _mm256_packus_epi16(ab, cd);
+
+		v = _mm256_permutevar8x32_epi32(v, perm);
+		_mm256_storeu_si256((__m256i *)&col[i], v);
+	} return i;
+}
+
+__attribute__((target("avx2")))
+static	unsigned	avx2_u16(uint16_t *col, const uint32_t *data,
+		unsigned i, unsigned len, unsigned nshift, uint32_t mask) {
+	const __m128i	cnt  = _mm_cvtsi32_si128(nshift);
+	const __m256i	vmsk = _mm256_set1_epi32(mask);
+
+	for(; i+16<=len; i+=16) {
+		__m256i	a = avx2_field(&data[i  ], cnt, vmsk),
+			b = avx2_field(&data[i+8], cnt, vmsk);
+		__m256i	v = _mm256_packus_epi32(a, b);
+
+		// Undo the in-lane interleaving of the pack
+		v = _mm256_permute4x64_epi64(v, 0xd8);
+		_mm256_storeu_si256((__m256i *)&col[i], v);
+	} return i;
+}
+
+__attribute__((target("avx2")))
+static	unsigned	avx2_u32(uint32_t *col, const uint32_t *data,
+		unsigned i, unsigned len, unsigned nshift, uint32_t mask) {
+	const __m128i	cnt  = _mm_cvtsi32_si128(nshift);
+	const __m256i	vmsk = _mm256_set1_epi32(mask);
+
+	for(; i+8<=len; i+=8)
+		_mm256_storeu_si256((__m256i *)&col[i],
+			avx2_field(&data[i], cnt, vmsk));
+	return i;
+}
+
+// }}}
+#endif
+
+// TRACECOL::best_simd
+// {{{
+TRACECOL::SIMD	TRACECOL::best_simd(void) {
+#ifdef	TRACECOL_X86
+	static	const SIMD	best = (__builtin_cpu_supports("avx2"))
+					? SIMD_AVX2 : SIMD_SSE2;
+	return best;
+#else
+	return SIMD_NONE;
+#endif
+}
+// }}}
+
+// TRACECOL::setup
+// {{{
+void	TRACECOL::setup(unsigned len, unsigned nbits, unsigned nshift) {
+	m_nbits  = nbits;
+	m_nshift = nshift;
+	m_len    = len;
+	m_plane.clear(); m_u8.clear(); m_u16.clear(); m_u32.clear();
+
+	if (nbits <= 1)
+		m_plane.assign((len+63)/64, 0);
+	else if (nbits <= 8)
+		m_u8.assign(len, 0);
+	else if (nbits <= 16)
+		m_u16.assign(len, 0);
+	else
+		m_u32.assign(len, 0);
+}
+// }}}
+
+// TRACECOL::fill_with
+// {{{
+void	TRACECOL::fill_with(SIMD simd, const uint32_t *data, unsigned start,
+		unsigned end) {
+#ifdef	TRACECOL_X86
+	uint32_t	mask;
+	unsigned	head, done;
+
+	if (end > m_len)
+		end = m_len;
+	if (simd > best_simd())
+		simd = best_simd();
+	if ((start >= end)||(m_nbits + m_nshift > 32)||(simd == SIMD_NONE)) {
+		fill_scalar(data, start, end);
+		return;
+	}
+
+	mask = (m_nbits >= 32) ? 0xffffffff : ((1u << m_nbits)-1);
+
+	// Handle any words before the first 8-word boundary the slow way.
+	// This keeps every SIMD group of bit-plane bits within a single
+	// 64-bit word of m_plane.
+	head = (start + 7) & -8;
+	if (head > end)
+		head = end;
+	fill_scalar(data, start, head);
+
+	if (m_nbits <= 1) {
+		if (simd >= SIMD_AVX2)
+			done = avx2_plane(m_plane.data(), data, head, end, m_nshift);
+		else
+			done = sse2_plane(m_plane.data(), data, head, end, m_nshift);
+	} else if (simd < SIMD_AVX2) {
+		done = head;
+	} else if (m_nbits <= 8) {
+		done = avx2_u8(m_u8.data(), data, head, end, m_nshift, mask);
+	} else if (m_nbits <= 16) {
+		done = avx2_u16(m_u16.data(), data, head, end, m_nshift, mask);
+	} else
+		done = avx2_u32(m_u32.data(), data, head, end, m_nshift, mask);
+
+	// And the rest (if any) the slow way as well
+	fill_scalar(data, done, end);
+#else
+	fill_scalar(data, start, end);
+#endif
+}
+// }}}
+
+// TRACECOL::fill_scalar
+// {{{
+void	TRACECOL::fill_scalar(const uint32_t *data, unsigned start,
+		unsigned end) {
+	uint32_t	mask;
+
+	if (end > m_len)
+		end = m_len;
+	if ((start >= end)||(m_nshift >= 32))
+		// Nothing to do, or nothing left of the word to extract
+		return;
+
+	mask = (m_nbits >= 32) ? 0xffffffff : ((1u << m_nbits)-1);
+
+	if (m_nbits <= 1)
+		scalar_plane(m_plane.data(), data, start, end, m_nshift);
+	else if (m_nbits <= 8)
+		scalar_field(m_u8.data(), data, start, end, m_nshift, mask);
+	else if (m_nbits <= 16)
+		scalar_field(m_u16.data(), data, start, end, m_nshift, mask);
+	else
+		scalar_field(m_u32.data(), data, start, end, m_nshift, mask);
+}
+// }}}
@@ -0,0 +1,113 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	tracecol.h
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Most everything we do with a capture looks at the traces within
+//		each data word, one trace at a time.  This file defines a
+//	TRACECOL, a column holding one trace's value for every word of a
+//	capture, packed as tightly as the trace allows: single bit traces as
+//	bit-planes, and wider traces in the narrowest integer type that will
+//	hold them.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	TRACECOL_H
+#define	TRACECOL_H
+
+#include <stdint.h>
+#include <vector>
+
+/*
+ * TRACECOL
+ * {{{
+ * One trace, ((word>>m_nshift)&((1<<m_nbits)-1)), extracted from every word of
+ * a capture.  Only one of the storage vectors is used, depending upon m_nbits:
+ * m_plane for 1-bit traces (bit i%64 of m_plane[i/64]), then m_u8, m_u16, or
+ * m_u32 for traces of up to 8, 16 and 32 bits respectively.
+ * }}}
+ */
+class	TRACECOL {
+public:
+	unsigned	m_nbits, m_nshift, m_len;
+	std::vector<uint64_t>	m_plane;
+	std::vector<uint8_t>	m_u8;
+	std::vector<uint16_t>	m_u16;
+	std::vector<uint32_t>	m_u32;
+
+	// The SIMD kernels fill() may use, each including those before it
+	enum	SIMD { SIMD_NONE = 0, SIMD_SSE2, SIMD_AVX2 };
+
+	TRACECOL(void) : m_nbits(0), m_nshift(0), m_len(0) {}
+
+	// The best kernels this CPU supports
+	static	SIMD	best_simd(void);
+
+	// Allocate (and clear) a column of len values, for the given trace
+	void	setup(unsigned len, unsigned nbits, unsigned nshift);
+
+	// Fill in values start through end-1 of the column from the same
+	// words of data, using the fastest kernel the CPU supports.  Ranges
+	// may be filled in any order, but each only once.
+	void	fill(const uint32_t *data, unsigned start, unsigned end) {
+		fill_with(best_simd(), data, start, end);
+	}
+
+	// The same, but using no better than the given kernels--so that each
+	// of them may be checked against fill_scalar()
+	void	fill_with(SIMD simd, const uint32_t *data, unsigned start,
+			unsigned end);
+
+	// The same, but without any SIMD instructions.  This is the reference
+	// the SIMD kernels must match.
+	void	fill_scalar(const uint32_t *data, unsigned start, unsigned end);
+
+	// Set up and fill the column from all len words of data at once
+	void	extract(const uint32_t *data, unsigned len,
+			unsigned nbits, unsigned nshift) {
+		setup(len, nbits, nshift);
+		fill(data, 0, len);
+	}
+
+	unsigned	size(void) const { return m_len; }
+
+	unsigned	operator[](unsigned i) const {
+		if (m_nbits <= 1)
+			return (m_plane[i>>6] >> (i&63)) & 1;
+		else if (m_nbits <= 8)
+			return m_u8[i];
+		else if (m_nbits <= 16)
+			return m_u16[i];
+		return m_u32[i];
+	}
+};
+
+#endif	// TRACECOL_H
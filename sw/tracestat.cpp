@@ -0,0 +1,372 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	tracestat.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Gathers the TRACESTATS of a capture, with an AVX2 kernel for the
+//		per-trace sums where the CPU has one.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "tracestat.h"
+
+#if	defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define	TRACESTAT_X86
+#include <immintrin.h>
+#endif
+
+// The number of words taken at a time.  Small enough that no per-block sum
+// can overflow 64 bits, even with every word a full length run: the sums
+// are taken over 16-bit halves of each value, so each word adds less than
+// 2^16 * 2^31.
+#define	STAT_BLOCK	1024
+
+// The sums over one block of one trace
+struct	BLOCKSUM {
+	uint64_t	m_same, m_active, m_lo, m_hi;
+	uint32_t	m_min, m_max;
+};
+
+// Sum n words, of value eff[i] and lasting wt[i] clocks.  eff[-1] is the
+// value of the word before the block, so changes can be counted.  Counts the
+// words that didn't change, rather than those that did.
+// {{{
+static	void	scalar_sum(const uint32_t *eff, const uint32_t *wt, unsigned n,
+		unsigned shift, uint32_t mask, BLOCKSUM &s) {
+	uint32_t	last = (eff[-1] >> shift) & mask;
+
+	for(unsigned i=0; i<n; i++) {
+		uint32_t	v = (eff[i] >> shift) & mask;
+
+		if (v == last)
+			s.m_same++;
+		if (v != 0)
+			s.m_active += wt[i];
+		s.m_lo += (uint64_t)(v & 0x0ffff) * wt[i];
+		s.m_hi += (uint64_t)(v >> 16) * wt[i];
+		if (v < s.m_min)
+			s.m_min = v;
+		if (v > s.m_max)
+			s.m_max = v;
+		last = v;
+	}
+}
+// }}}
+
+#ifdef	TRACESTAT_X86
+// AVX2 kernel
+// {{{
+// Eight words at a time.  Each word is compared against the word before it
+// (an unaligned load one word back), and the 32x32 bit products are formed
+// in two halves, even lanes and odd, so they can be summed in 64 bits.
+__attribute__((target("avx2")))
+static inline	__m256i	avx2_widen(__m256i acc, __m256i v) {
+	const __m256i	lo32 = _mm256_set1_epi64x(0xffffffff);
+
+	acc = _mm256_add_epi64(acc, _mm256_and_si256(v, lo32));
+	return _mm256_add_epi64(acc, _mm256_srli_epi64(v, 32));
+}
+
+__attribute__((target("avx2")))
+static inline	__m256i	avx2_mac(__m256i acc, __m256i v, __m256i w) {
+	acc = _mm256_add_epi64(acc, _mm256_mul_epu32(v, w));
+	return _mm256_add_epi64(acc, _mm256_mul_epu32(
+			_mm256_srli_epi64(v, 32), _mm256_srli_epi64(w, 32)));
+}
+
+__attribute__((target("avx2")))
+static inline	uint64_t	avx2_hsum(__m256i v) {
+	uint64_t	x[4];
+
+	_mm256_storeu_si256((__m256i *)x, v);
+	return x[0] + x[1] + x[2] + x[3];
+}
+
+__attribute__((target("avx2")))
+static	void	avx2_sum(const uint32_t *eff, const uint32_t *wt, unsigned n,
+		unsigned shift, uint32_t mask, BLOCKSUM &s) {
+	const __m128i	cnt   = _mm_cvtsi32_si128((int)shift);
+	const __m256i	vmask = _mm256_set1_epi32((int)mask),
+			zero  = _mm256_setzero_si256(),
+			lo16  = _mm256_set1_epi32(0x0ffff);
+	__m256i		same = zero, active = zero, lo = zero, hi = zero,
+			vmin = _mm256_set1_epi32(-1), vmax = zero;
+	unsigned	i;
+
+	for(i=0; i+8 <= n; i+=8) {
+		__m256i	v = _mm256_and_si256(_mm256_srl_epi32(
+				_mm256_loadu_si256((const __m256i *)&eff[i]),
+				cnt), vmask),
+			p = _mm256_and_si256(_mm256_srl_epi32(
+				_mm256_loadu_si256((const __m256i *)(eff+i-1)),
+				cnt), vmask),
+			w = _mm256_loadu_si256((const __m256i *)&wt[i]);
+
+		// Equal lanes are all ones, -1, so subtracting counts them
+		same   = _mm256_sub_epi32(same, _mm256_cmpeq_epi32(v, p));
+		active = avx2_widen(active, _mm256_andnot_si256(
+				_mm256_cmpeq_epi32(v, zero), w));
+		lo     = avx2_mac(lo, _mm256_and_si256(v, lo16), w);
+		hi     = avx2_mac(hi, _mm256_srli_epi32(v, 16), w);
+		vmin   = _mm256_min_epu32(vmin, v);
+		vmax   = _mm256_max_epu32(vmax, v);
+	}
+
+	uint32_t	x[8], y[8], z[8];
+
+	_mm256_storeu_si256((__m256i *)x, same);
+	_mm256_storeu_si256((__m256i *)y, vmin);
+	_mm256_storeu_si256((__m256i *)z, vmax);
+	for(unsigned k=0; k<8; k++) {
+		s.m_same += x[k];
+		if (y[k] < s.m_min)
+			s.m_min = y[k];
+		if (z[k] > s.m_max)
+			s.m_max = z[k];
+	}
+	s.m_active += avx2_hsum(active);
+	s.m_lo += avx2_hsum(lo);
+	s.m_hi += avx2_hsum(hi);
+
+	// Any words left over
+	if (i < n)
+		scalar_sum(&eff[i], &wt[i], n-i, shift, mask, s);
+}
+// }}}
+
+static	bool	has_avx2(void) {
+	static	const bool	avx2 = __builtin_cpu_supports("avx2");
+	return avx2;
+}
+#endif
+
+// TRACESTATS::setup
+// {{{
+void	TRACESTATS::setup(unsigned len, bool compressed) {
+	m_len   = len;
+	m_valid = 0;
+	m_compressed = compressed;
+	m_eff   = 0;
+	for(unsigned k=0; k<m_stats.size(); k++) {
+		STAT	&st = m_stats[k];
+
+		st.m_clocks = st.m_changes = st.m_active = 0;
+		st.m_min  = 0xffffffff;
+		st.m_max  = 0;
+		st.m_mean = 0.0;
+		st.m_hist.assign(st.m_hist.size(), 0);
+		m_subhist[k].assign(m_subhist[k].size(), 0);
+		m_sums[k] = 0.0;
+	}
+}
+// }}}
+
+// TRACESTATS::add_trace
+// {{{
+void	TRACESTATS::add_trace(unsigned nbits, unsigned nshift) {
+	STAT	st;
+
+	st.m_nbits  = nbits;
+	st.m_nshift = nshift;
+	st.m_clocks = st.m_changes = st.m_active = 0;
+	st.m_min  = 0xffffffff;
+	st.m_max  = 0;
+	st.m_mean = 0.0;
+	st.m_binshift = (nbits > 8) ? nbits - 8 : 0;
+	st.m_hist.assign(1u << (nbits - st.m_binshift), 0);
+	m_stats.push_back(st);
+	m_sums.push_back(0.0);
+	m_subhist.push_back(std::vector<uint64_t>(4*st.m_hist.size(), 0));
+}
+// }}}
+
+// TRACESTATS::extend
+// {{{
+void	TRACESTATS::extend(const uint32_t *data, unsigned nwords) {
+	// The value of each word of the block, following that of the word
+	// before it, and the number of clocks each word lasts
+	uint32_t	eff[STAT_BLOCK+1], wt[STAT_BLOCK];
+
+	if (nwords > m_len)
+		nwords = m_len;
+	if (nwords <= m_valid)
+		return;
+
+	for(unsigned base=m_valid; base<nwords; base+=STAT_BLOCK) {
+		unsigned	n = nwords - base;
+		uint64_t	clocks = 0;
+
+		if (n > STAT_BLOCK)
+			n = STAT_BLOCK;
+
+		// As in SCOPE::build_index(), a run-length word represents
+		// the last value repeated for (m_data[i]&0x7fffffff) more
+		// clocks, save at the very beginning--where it repeats a
+		// value we never saw, which reads as zero
+		eff[0] = m_eff;
+		for(unsigned j=0; j<n; j++) {
+			uint32_t	word = data[base+j];
+			bool		run = (m_compressed)&&(word & 0x80000000);
+
+			// Written so as to compile without branches, since
+			// runs come and go at random
+			eff[j+1] = (run) ? eff[j] : word;
+			wt[j] = (run) ? (word & 0x7fffffff) + 1 : 1;
+			clocks += wt[j];
+		}
+
+		if ((base == 0)&&(wt[0] != 1)) {
+			clocks -= wt[0] - 1;
+			wt[0] = 1;
+		}
+
+		// The first word of the capture didn't change from anything
+		if (base == 0)
+			eff[0] = eff[1];
+
+		for(unsigned k=0; k<m_stats.size(); k++) {
+			STAT		&st = m_stats[k];
+			uint32_t	mask = (st.m_nbits >= 32) ? 0xffffffff
+						: ((1u << st.m_nbits)-1);
+			BLOCKSUM	s;
+
+			memset(&s, 0, sizeof(s));
+			s.m_min = 0xffffffff;
+#ifdef	TRACESTAT_X86
+			if (has_avx2())
+				avx2_sum(&eff[1], wt, n, st.m_nshift, mask, s);
+			else
+#endif
+				scalar_sum(&eff[1], wt, n, st.m_nshift, mask, s);
+
+			st.m_clocks  += clocks;
+			st.m_changes += n - s.m_same;
+			st.m_active  += s.m_active;
+			if (s.m_min < st.m_min)
+				st.m_min = s.m_min;
+			if (s.m_max > st.m_max)
+				st.m_max = s.m_max;
+			m_sums[k] += (long double)s.m_lo
+					+ (long double)s.m_hi * 65536.0L;
+			st.m_mean = (double)(m_sums[k] / st.m_clocks);
+
+			// A one bit trace's histogram is just its active and
+			// idle clocks
+			if (st.m_nbits == 1) {
+				st.m_hist[1] = st.m_active;
+				st.m_hist[0] = st.m_clocks - st.m_active;
+				continue;
+			}
+
+			// Otherwise it's a scatter, which doesn't vectorize.
+			// Words take turns between four copies of the
+			// histogram, so that a run of words in the same bin
+			// doesn't wait on each add before the next.
+			uint64_t	*h = &m_subhist[k][0];
+			unsigned	nbins = st.m_hist.size(), j;
+
+			for(j=0; j+4<=n; j+=4) {
+				h[((eff[j+1] >> st.m_nshift) & mask)
+					>> st.m_binshift] += wt[j];
+				h[nbins + (((eff[j+2] >> st.m_nshift) & mask)
+					>> st.m_binshift)] += wt[j+1];
+				h[2*nbins + (((eff[j+3] >> st.m_nshift) & mask)
+					>> st.m_binshift)] += wt[j+2];
+				h[3*nbins + (((eff[j+4] >> st.m_nshift) & mask)
+					>> st.m_binshift)] += wt[j+3];
+			} for(; j<n; j++)
+				h[((eff[j+1] >> st.m_nshift) & mask)
+					>> st.m_binshift] += wt[j];
+
+			// Fold them back together, once at the end
+			if (base + STAT_BLOCK >= nwords) {
+				for(unsigned b=0; b<nbins; b++)
+					st.m_hist[b] = h[b] + h[nbins+b]
+						+ h[2*nbins+b] + h[3*nbins+b];
+			}
+		}
+
+		m_eff = eff[n];
+	}
+
+	m_valid = nwords;
+}
+// }}}
+
+// Write a string to a JSON file, quoting anything that needs it
+static	void	json_string(FILE *fp, const char *str) {
+	fputc('\"', fp);
+	for(; *str; str++) {
+		if ((*str == '\"')||(*str == '\\'))
+			fprintf(fp, "\\%c", *str);
+		else if ((unsigned char)*str < 0x20)
+			fprintf(fp, "\\u%04x", (unsigned char)*str);
+		else
+			fputc(*str, fp);
+	} fputc('\"', fp);
+}
+
+// TRACESTATS::write_json
+// {{{
+void	TRACESTATS::write_json(FILE *fp,
+		const std::vector<const char *> &names) const {
+	fprintf(fp, "{\n\t\"words\": %u,\n\t\"compressed\": %s,\n",
+		m_valid, (m_compressed) ? "true" : "false");
+	fprintf(fp, "\t\"traces\": [");
+	for(unsigned k=0; k<m_stats.size(); k++) {
+		const STAT	&st = m_stats[k];
+
+		fprintf(fp, "%s\n\t\t{ \"name\": ", (k > 0) ? ",":"");
+		json_string(fp, names[k]);
+		fprintf(fp, ", \"bits\": %u, \"shift\": %u,\n",
+			st.m_nbits, st.m_nshift);
+		fprintf(fp, "\t\t  \"clocks\": %lu, \"changes\": %lu,"
+			" \"active\": %lu, \"duty\": %.6f,\n",
+			(unsigned long)st.m_clocks,
+			(unsigned long)st.m_changes,
+			(unsigned long)st.m_active, st.duty());
+		if (st.m_clocks > 0)
+			fprintf(fp, "\t\t  \"min\": %u, \"max\": %u,"
+				" \"mean\": %.6f,\n",
+				st.m_min, st.m_max, st.m_mean);
+		fprintf(fp, "\t\t  \"bin_width\": %u, \"histogram\": [",
+			1u << st.m_binshift);
+		for(unsigned b=0; b<st.m_hist.size(); b++)
+			fprintf(fp, "%s%lu", (b > 0) ? ", " : "",
+				(unsigned long)st.m_hist[b]);
+		fprintf(fp, "] }");
+	} fprintf(fp, "\n\t]\n}\n");
+}
+// }}}
@@ -0,0 +1,138 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	tracestat.h
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Declares TRACESTATS, which gathers statistics for every trace of
+//		a capture in one pass over its words: how often each trace changes,
+//	how much of the time it's active (its duty cycle), its minimum, maximum
+//	and mean, and a histogram of its values--all weighted by clocks.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	TRACESTAT_H
+#define	TRACESTAT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+/*
+ * TRACESTATS
+ * {{{
+ * Statistics of every trace of a capture, gathered together in one pass
+ * over the raw words.  Everything is weighted by clocks: for compressed
+ * (wbscopc) scopes, a run-length word counts for as many clocks as it
+ * stands for, so the statistics are those of the expanded capture without
+ * ever expanding it.
+ *
+ * The words are taken a block at a time.  Each block is first turned into
+ * the value and the number of clocks of every word (a run taking the value
+ * it repeats), after which each trace is summed over the whole block with
+ * an AVX2 kernel where the CPU has one.  Like the PYRAMID and EDGEIDX, the
+ * statistics may be gathered incrementally, as the words arrive.
+ * }}}
+ */
+class	TRACESTATS {
+public:
+	// The statistics of one trace
+	struct	STAT {
+		unsigned	m_nbits, m_nshift;
+		// The number of clocks covered, the number of times the
+		// trace changed value, and the number of clocks it was
+		// non-zero--for a one bit trace, the clocks it was high
+		uint64_t	m_clocks, m_changes, m_active;
+		uint32_t	m_min, m_max;
+		double		m_mean;
+		// The number of clocks spent at each value.  Traces of more
+		// than eight bits share 256 bins, each covering
+		// (1<<m_binshift) values.
+		unsigned	m_binshift;
+		std::vector<uint64_t>	m_hist;
+
+		// The fraction of clocks the trace was active
+		double	duty(void) const {
+			return (m_clocks > 0)
+				? (double)m_active / (double)m_clocks : 0.0;
+		}
+	};
+
+private:
+	std::vector<STAT>	m_stats;
+	// The clock weighted sum of each trace, behind its mean
+	std::vector<long double>	m_sums;
+	// Four histograms of each trace, summed to give STAT::m_hist
+	std::vector<std::vector<uint64_t> >	m_subhist;
+	unsigned	m_len, m_valid;
+	bool		m_compressed;
+	// The last data word seen, which any run-length words repeat
+	uint32_t	m_eff;
+
+public:
+	TRACESTATS(void) : m_len(0), m_valid(0), m_compressed(false),
+		m_eff(0) {}
+
+	// Forget everything, and get ready to gather statistics from len
+	// words
+	void	setup(unsigned len, bool compressed);
+
+	// Add a trace, ((word >> nshift) & ((1<<nbits)-1)).  All traces must
+	// be added before the first extend().
+	void	add_trace(unsigned nbits, unsigned nshift);
+
+	void	clear(void) {
+		setup(0, false);
+		m_stats.clear(); m_sums.clear(); m_subhist.clear();
+	}
+
+	// Gather statistics from data words up to (but not including)
+	// nwords.  Words before valid() have already been counted.
+	void	extend(const uint32_t *data, unsigned nwords);
+
+	// The number of words to be counted, and that have been
+	unsigned	size(void) const { return m_len; }
+	unsigned	valid(void) const { return m_valid; }
+	bool		complete(void) const {
+		return (m_len > 0)&&(m_valid >= m_len);
+	}
+
+	unsigned	ntraces(void) const { return m_stats.size(); }
+
+	// The statistics of a trace, from the words counted so far
+	const STAT	&stat(unsigned trace) const { return m_stats[trace]; }
+
+	// Write the statistics to fp as a JSON object, naming each trace
+	// from names (which must have one name per trace)
+	void	write_json(FILE *fp,
+			const std::vector<const char *> &names) const;
+};
+
+#endif	// TRACESTAT_H
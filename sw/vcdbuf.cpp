@@ -0,0 +1,129 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	vcdbuf.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Implements the VCDBUF, a buffered, table driven formatter for
+//		VCD output.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "vcdbuf.h"
+
+// VCDBUF::bittbl
+// {{{
+// Returns a table of the binary representation of every byte.  Built once,
+// on first use.
+const char	(*VCDBUF::bittbl(void))[8] {
+	static	struct	BITTBL {
+		char	m_bits[256][8];
+
+		BITTBL(void) {
+			for(unsigned v=0; v<256; v++)
+			for(unsigned b=0; b<8; b++)
+				m_bits[v][b] = ((v>>(7-b))&1) ? '1' : '0';
+		}
+	} tbl;
+
+	return tbl.m_bits;
+}
+// }}}
+
+// VCDBUF::timestamp
+// {{{
+void	VCDBUF::timestamp(uint64_t t) {
+	char	tmp[24], *ptr = &tmp[sizeof(tmp)];
+	unsigned	ln;
+
+	// Convert from the least significant digit up
+	do {
+		*--ptr = '0' + (t % 10);
+		t /= 10;
+	} while(t > 0);
+	ln = &tmp[sizeof(tmp)] - ptr;
+
+	reserve(ln+2);
+	m_buf[m_len++] = '#';
+	memcpy(&m_buf[m_len], ptr, ln);
+	m_len += ln;
+	m_buf[m_len++] = '\n';
+}
+// }}}
+
+// VCDBUF::binary
+// {{{
+void	VCDBUF::binary(int nbits, unsigned val, const char *key) {
+	const char	(*bits)[8] = bittbl();
+	unsigned	kln = strlen(key);
+	char		*ptr;
+
+	reserve(nbits + kln + 4);
+	ptr = &m_buf[m_len];
+
+	if (nbits <= 1) {
+		*ptr++ = '0' + (val&1);
+	} else {
+		int	nb = nbits;
+
+		if (nb > 32)
+			nb = 32;
+		*ptr++ = 'b';
+
+		// Any partial byte at the top first
+		if (nb & 7) {
+			unsigned	top = nb & 7;
+
+			memcpy(ptr, &bits[(val >> (nb-top)) & 0x0ff][8-top],
+				top);
+			ptr += top;
+			nb -= top;
+		}
+
+		// Then the rest, eight bits at a time
+		while(nb > 0) {
+			nb -= 8;
+			memcpy(ptr, bits[(val >> nb)&0x0ff], 8);
+			ptr += 8;
+		}
+		*ptr++ = ' ';
+	}
+
+	memcpy(ptr, key, kln);
+	ptr += kln;
+	*ptr++ = '\n';
+	m_len = ptr - m_buf;
+}
+// }}}
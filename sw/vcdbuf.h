@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	vcdbuf.h
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Writing a VCD file one bit at a time through stdio is slow.  This
+//		file defines a VCDBUF, an output buffer which formats VCD values
+//	and timestamps into a large block of memory using lookup tables, and then
+//	hands that block to the file in one large write.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	VCDBUF_H
+#define	VCDBUF_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "outbuf.h"
+
+/*
+ * VCDBUF
+ * {{{
+ * An output buffer for VCD file generation.  Values are formatted directly
+ * into the buffer, which is written to the file once it fills (or on flush()).
+ * Binary values are expanded eight bits at a time from a 256 entry table of
+ * ASCII '0'/'1' strings, rather than one character at a time.
+ * }}}
+ */
+class	VCDBUF : public OUTBUF {
+	// Lookup table: m_bits[v] contains the 8 characters of v in binary,
+	// MSB first
+	static	const char	(*bittbl(void))[8];
+public:
+	VCDBUF(FILE *fp, unsigned sz = DEFAULT_SIZE) : OUTBUF(fp, sz) {}
+
+	// Add a timestamp, "#<t>\n", to the buffer
+	void	timestamp(uint64_t t);
+
+	// Add a value, in binary, followed by its VCD identifier
+	void	binary(int nbits, unsigned val, const char *key);
+};
+
+#endif	// VCDBUF_H
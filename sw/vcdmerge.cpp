@@ -0,0 +1,310 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	vcdmerge.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Writes a single VCD file from the captures of several scopes,
+//		by merging their samples in time order.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <queue>
+#include <vector>
+#include <functional>
+
+#include "devbus.h"
+#include "scopecls.h"
+#include "vcdbuf.h"
+#include "vcdmerge.h"
+
+// VCDMERGE::add
+// {{{
+void	VCDMERGE::add(SCOPE *scope, const char *name) {
+	MERGE_ENTRY	e;
+
+	e.m_scope = scope;
+	e.m_name  = name;
+	e.m_id    = 0;
+	e.m_nwords = 0;
+	e.m_trigger = 0;
+	e.m_start = e.m_clk = 0;
+	e.m_now.m_time = e.m_now.m_frac = 0;
+	e.m_addr = e.m_trigstate = 0;
+	e.m_last  = 0;
+	e.m_first = true;
+
+	m_scopes.push_back(e);
+}
+// }}}
+
+// VCDMERGE::next_clock
+// {{{
+uint64_t	VCDMERGE::next_clock(MERGE_ENTRY &e) {
+	SCOPE		&sc = *e.m_scope;
+	uint64_t	clk = UINT64_MAX;
+
+	if (sc.compressed()) {
+		// Skip over any run words.  They don't change anything.
+		while((e.m_addr < e.m_nwords)&&(sc[e.m_addr] & 0x80000000))
+			e.m_addr++;
+	}
+
+	if (e.m_addr < e.m_nwords)
+		clk = sc.sample_time(e.m_addr);
+
+	if ((e.m_trigger >= 0)&&(e.m_trigstate < 2)) {
+		uint64_t	tclk = e.m_trigger + e.m_trigstate;
+		if (tclk < clk)
+			clk = tclk;
+	}
+
+	return clk;
+}
+// }}}
+
+// VCDMERGE::clock_time
+// {{{
+uint64_t	VCDMERGE::clock_time(unsigned s, uint64_t clk) {
+	MERGE_ENTRY	&e = m_scopes[s];
+	const TIMEBASE	&tb = m_timebase[s];
+
+	if (clk == e.m_clk + 1)
+		tb.step(e.m_now);
+	else if (clk != e.m_clk)
+		tb.step(e.m_now, clk - e.m_clk);
+	e.m_clk = clk;
+
+	return e.m_start + e.m_now.m_time;
+}
+// }}}
+
+// VCDMERGE::write_clock
+// {{{
+void	VCDMERGE::write_clock(VCDBUF &out, MERGE_ENTRY &e, uint64_t clk) {
+	SCOPE	&sc = *e.m_scope;
+
+	if ((e.m_trigger >= 0)&&(e.m_trigstate < 2)
+			&&(clk == (uint64_t)e.m_trigger + e.m_trigstate)) {
+		out.binary(1, (e.m_trigstate == 0) ? 1:0, key(e.m_id));
+		e.m_trigstate++;
+	} else if ((e.m_first)&&(e.m_trigstate == 0))
+		// Start the trigger off low
+		out.binary(1, 0, key(e.m_id));
+
+	if ((e.m_addr >= e.m_nwords)||(sc.sample_time(e.m_addr) != clk))
+		return;
+
+	// Write out whatever has changed since the last word
+	DEVBUS::BUSW	word = sc[e.m_addr], diff;
+	int		nbits = (sc.compressed()) ? 31 : 32;
+
+	if (sc.compressed())
+		word &= 0x7fffffff;
+	diff = word ^ e.m_last;
+	if ((e.m_first)||(diff != 0)) {
+		out.binary(nbits, word, key(e.m_id+1));
+		for(unsigned k=0; k<sc.ntraces(); k++) {
+			const TRACEINFO *info = sc.trace(k);
+
+			if ((e.m_first)||((diff >> info->m_nshift)&info->m_mask))
+				out.binary(info->m_nbits,
+					(word >> info->m_nshift) & info->m_mask,
+					key(e.m_id+2+k));
+		}
+	}
+
+	e.m_last  = word;
+	e.m_first = false;
+	e.m_addr++;
+}
+// }}}
+
+// VCDMERGE::write_header
+// {{{
+void	VCDMERGE::write_header(FILE *fp, uint64_t timezero) {
+	time_t	now;
+
+	time(&now);
+	fprintf(fp, "$version Generated by WBScope $end\n");
+	fprintf(fp, "$date %s\n $end\n", ctime(&now));
+	fprintf(fp, "$timescale %s $end\n\n", m_timebase[0].timescale());
+	if (timezero > 0)
+		fprintf(fp, "$timezero %lld $end\n\n", -(long long)timezero);
+
+	for(unsigned s=0; s<m_scopes.size(); s++) {
+		MERGE_ENTRY	&e = m_scopes[s];
+		SCOPE		&sc = *e.m_scope;
+		int		nbits = (sc.compressed()) ? 31 : 32;
+
+		fprintf(fp, " $scope module %s $end\n", e.m_name);
+		fprintf(fp, "  $var wire %2d %s _trigger $end\n", 1,
+			key(e.m_id));
+		fprintf(fp, "  $var wire %2d %s _raw_data [%d:0] $end\n",
+			nbits, key(e.m_id+1), nbits-1);
+		for(unsigned k=0; k<sc.ntraces(); k++) {
+			const TRACEINFO *info = sc.trace(k);
+
+			fprintf(fp, "  $var wire %2d %s %s", info->m_nbits,
+				key(e.m_id+2+k), info->m_name);
+			if ((info->m_nbits > 1)
+					&&(NULL == strchr(info->m_name, '[')))
+				fprintf(fp, "[%d:0] $end\n", info->m_nbits-1);
+			else
+				fprintf(fp, " $end\n");
+		}
+		fprintf(fp, " $upscope $end\n");
+	}
+	fprintf(fp, "$enddefinitions $end\n");
+}
+// }}}
+
+// VCDMERGE::writevcd (FILE *fp)
+// {{{
+void	VCDMERGE::writevcd(FILE *fp) {
+	typedef	std::pair<uint64_t, unsigned>	EVENT;
+	std::priority_queue<EVENT, std::vector<EVENT>,
+			std::greater<EVENT> >	queue;
+	std::vector<uint64_t>	rates;
+	std::vector<int64_t>	trigger_time;
+	unsigned	nids = 0;
+	uint64_t	units;
+	int64_t		timezero = 0;
+	bool		first = true;
+
+	if (m_scopes.size() == 0)
+		return;
+
+	// Read out each scope, and work out where its trigger falls
+	for(unsigned s=0; s<m_scopes.size(); s++) {
+		MERGE_ENTRY	&e = m_scopes[s];
+		SCOPE		&sc = *e.m_scope;
+
+		e.m_nwords  = sc.load();
+		e.m_trigger = sc.trigger_clock();
+		e.m_addr    = 0;
+		e.m_trigstate = 0;
+		e.m_last    = 0;
+		e.m_first   = true;
+		e.m_id      = nids;
+		nids += 2 + sc.ntraces();
+
+		rates.push_back(sc.get_clkfreq_hz());
+	}
+
+	// Give every scope a timebase, all in the same units--ideally ones in
+	// which every scope's clock period is exact
+	units = TIMEBASE::choose_units(rates.data(), rates.size());
+	m_timebase.clear();
+	for(unsigned s=0; s<m_scopes.size(); s++) {
+		MERGE_ENTRY	&e = m_scopes[s];
+		TIMEBASE	tb(rates[s], units);
+		int64_t		when;
+
+		if (e.m_trigger >= 0)
+			when = tb.time(e.m_trigger);
+		else
+			when = -(int64_t)tb.time(-(int64_t)e.m_trigger);
+		trigger_time.push_back(when);
+		if ((s == 0)||(when > timezero))
+			timezero = when;
+		m_timebase.push_back(tb);
+	}
+
+	// Line the scopes up, so that every trigger falls at timezero
+	for(unsigned s=0; s<m_scopes.size(); s++) {
+		MERGE_ENTRY	&e = m_scopes[s];
+
+		e.m_start = timezero - trigger_time[s];
+		e.m_clk = 0;
+		e.m_now.m_time = e.m_now.m_frac = 0;
+	}
+
+	m_keys.resize(8*nids);
+	for(unsigned id=0; id<nids; id++)
+		SCOPE::vcd_identifier(id, &m_keys[8*id]);
+
+	write_header(fp, (timezero > 0) ? timezero : 0);
+
+	VCDBUF		out(fp);
+	uint64_t	last_ns = 0;
+
+	for(unsigned s=0; s<m_scopes.size(); s++) {
+		uint64_t clk = next_clock(m_scopes[s]);
+		if (clk != UINT64_MAX)
+			queue.push(EVENT(clock_time(s, clk), s));
+	}
+
+	// Repeatedly write out the next scope's next event.  Since events
+	// are taken in time order, we only need to write a timestamp when
+	// the time changes.
+	while(!queue.empty()) {
+		EVENT		ev = queue.top();
+		MERGE_ENTRY	&e = m_scopes[ev.second];
+		uint64_t	clk;
+
+		queue.pop();
+		if ((first)||(ev.first != last_ns)) {
+			out.timestamp(ev.first);
+			last_ns = ev.first;
+			first = false;
+		}
+
+		clk = next_clock(e);
+		write_clock(out, e, clk);
+
+		clk = next_clock(e);
+		if (clk != UINT64_MAX)
+			queue.push(EVENT(clock_time(ev.second, clk),
+				ev.second));
+	}
+}
+// }}}
+
+// VCDMERGE::writevcd (const char *)
+// {{{
+void	VCDMERGE::writevcd(const char *trace_file_name) {
+	FILE	*fp = fopen(trace_file_name, "w");
+
+	if (fp == NULL) {
+		fprintf(stderr, "ERR: Cannot open %s for writing!\n",
+			trace_file_name);
+		fprintf(stderr, "ERR: Trace file not written\n");
+		return;
+	}
+
+	writevcd(fp);
+	fclose(fp);
+}
+// }}}
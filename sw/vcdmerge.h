@@ -0,0 +1,120 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	vcdmerge.h
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Merges the captures of several scopes, possibly running on
+//		different clocks, into a single VCD file, with all of the scopes
+//		lined up on their trigger.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	VCDMERGE_H
+#define	VCDMERGE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include "scopecls.h"
+#include "vcdbuf.h"
+#include "timebase.h"
+
+/*
+ * VCDMERGE
+ * {{{
+ * Writes one VCD file from the captures of several SCOPEs, each within its own
+ * $scope block.  Every scope's trigger is placed at time zero, and each
+ * scope's samples are placed in time according to its own clock frequency.
+ *
+ * The file is written by merging the scopes' samples in time order, one
+ * sample at a time, rather than by expanding every scope out onto a common
+ * timeline first.  Only changes are written, as with
+ * SCOPE::set_vcd_changes_only(), and there's no synthetic clock.
+ * }}}
+ */
+class	VCDMERGE {
+	struct	MERGE_ENTRY {
+		SCOPE		*m_scope;
+		const char	*m_name;
+		// The VCD identifier of this scope's first signal, _trigger.
+		// _raw_data and the scope's traces follow in order.
+		unsigned	m_id;
+		// The number of words read from the scope, and the clock
+		// number of its trigger
+		unsigned	m_nwords;
+		int64_t		m_trigger;
+		// The time of the scope's first clock in the file, and the
+		// time of clock m_clk (the last one asked for), both relative
+		// to the scope's TIMEBASE
+		uint64_t	m_start, m_clk;
+		TIMEBASE::TIME	m_now;
+
+		// Progress through the capture: the next word to be written,
+		// the trigger's state (0: not yet, 1: high, 2: done), and the
+		// last word written
+		unsigned	m_addr, m_trigstate;
+		DEVBUS::BUSW	m_last;
+		bool		m_first;
+	};
+
+	std::vector<MERGE_ENTRY>	m_scopes;
+	// One TIMEBASE per scope, all using the same units
+	std::vector<TIMEBASE>		m_timebase;
+	// The VCD identifiers of every signal, eight characters apiece
+	std::vector<char>		m_keys;
+
+	// The clock number of scope e's next event, or UINT64_MAX if none
+	uint64_t	next_clock(MERGE_ENTRY &e);
+
+	// The time of clock clk of scope s, from the start of the file.
+	// Clocks must be asked for in order.
+	uint64_t	clock_time(unsigned s, uint64_t clk);
+
+	// Write out scope e's events on clock clk
+	void	write_clock(VCDBUF &out, MERGE_ENTRY &e, uint64_t clk);
+
+	const char	*key(unsigned id) const { return &m_keys[8*id]; }
+
+	void	write_header(FILE *fp, uint64_t timezero);
+public:
+	VCDMERGE(void) {}
+
+	// Add a scope to the file, under the given $scope name.  The scope's
+	// data will be read, if it hasn't been already, when the file is
+	// written.  VCDMERGE doesn't take ownership of the scope.
+	void	add(SCOPE *scope, const char *name);
+
+	// Write the merged VCD file
+	void	writevcd(const char *trace_file_name);
+	void	writevcd(FILE *fp);
+};
+
+#endif	// VCDMERGE_H
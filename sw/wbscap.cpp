@@ -0,0 +1,240 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	wbscap.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Reads and writes .wbscap capture files, for the SCOPE class.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "devbus.h"
+#include "scopecls.h"
+#include "wbscap.h"
+
+// page_align
+// {{{
+static	uint64_t	page_align(uint64_t v) {
+	return (v + WBSCAP_PAGE-1) & ~(uint64_t)(WBSCAP_PAGE-1);
+}
+// }}}
+
+// write_pad
+// {{{
+// Pad the file with zeros until it reaches position pos
+static	bool	write_pad(FILE *fp, uint64_t pos) {
+	static	const	char	zeros[WBSCAP_PAGE] = { 0 };
+	long	here = ftell(fp);
+
+	if ((here < 0)||((uint64_t)here > pos))
+		return false;
+	return (fwrite(zeros, 1, pos-here, fp) == pos-here);
+}
+// }}}
+
+// SCOPE::write_capture
+// {{{
+bool	SCOPE::write_capture(const char *fname) {
+	WBSCAP_HEADER	hdr;
+	FILE		*fp;
+	bool		ok;
+
+	if (load() == 0) {
+		fprintf(stderr, "ERR: No data to write to %s\n", fname);
+		return false;
+	} if (m_compressed) {
+		build_index();
+		if (!m_indexed)
+			return false;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.m_magic, WBSCAP_MAGIC, sizeof(hdr.m_magic));
+	hdr.m_version    = WBSCAP_VERSION;
+	hdr.m_flags      = (m_compressed) ? WBSCAP_COMPRESSED : 0;
+	hdr.m_control    = m_ctrl;
+	hdr.m_holdoff    = m_holdoff;
+	hdr.m_clkfreq_hz = m_clkfreq_hz;
+	hdr.m_ntraces    = m_traces.size();
+	hdr.m_scoplen    = m_scoplen;
+	hdr.m_trace_offset = sizeof(hdr);
+	hdr.m_data_offset  = page_align(hdr.m_trace_offset
+			+ hdr.m_ntraces * sizeof(WBSCAP_TRACE));
+	hdr.m_length = hdr.m_data_offset
+			+ (uint64_t)m_scoplen * sizeof(DEVBUS::BUSW);
+	if (m_compressed) {
+		hdr.m_index_offset = page_align(hdr.m_length);
+		hdr.m_length = hdr.m_index_offset
+			+ ((uint64_t)m_scoplen+1) * sizeof(uint64_t);
+	}
+
+	fp = fopen(fname, "wb");
+	if (NULL == fp) {
+		fprintf(stderr, "ERR: Cannot open %s for writing!\n", fname);
+		return false;
+	}
+
+	ok = (fwrite(&hdr, sizeof(hdr), 1, fp) == 1);
+	for(unsigned k=0; (ok)&&(k<m_traces.size()); k++) {
+		WBSCAP_TRACE	tr;
+
+		memset(&tr, 0, sizeof(tr));
+		tr.m_nbits  = m_traces[k].m_nbits;
+		tr.m_nshift = m_traces[k].m_nshift;
+		strncpy(tr.m_name, m_traces[k].m_name, sizeof(tr.m_name)-1);
+		ok = (fwrite(&tr, sizeof(tr), 1, fp) == 1);
+	}
+
+	ok = ok && write_pad(fp, hdr.m_data_offset);
+	ok = ok && (fwrite(m_data, sizeof(DEVBUS::BUSW), m_scoplen, fp)
+				== m_scoplen);
+	if (m_compressed) {
+		ok = ok && write_pad(fp, hdr.m_index_offset);
+		ok = ok && (fwrite(m_tindex, sizeof(uint64_t), m_scoplen+1, fp)
+				== m_scoplen+1);
+	}
+
+	if (fclose(fp) != 0)
+		ok = false;
+	if (!ok)
+		fprintf(stderr, "ERR: Could not write %s\n", fname);
+	return ok;
+}
+// }}}
+
+// SCOPE::open_capture
+// {{{
+bool	SCOPE::open_capture(const char *fname) {
+	const WBSCAP_HEADER	*hdr;
+	const WBSCAP_TRACE	*tr;
+	struct stat	sb;
+	char		*base;
+	void		*map;
+	int		fd;
+
+	fd = open(fname, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "ERR: Cannot open %s\n", fname);
+		return false;
+	} if ((fstat(fd, &sb) != 0)||((size_t)sb.st_size < sizeof(*hdr))) {
+		fprintf(stderr, "ERR: %s is not a capture file\n", fname);
+		close(fd);
+		return false;
+	}
+
+	// Map the file privately, so that the data may still be written to
+	// (as m_data may be), without changing the file
+	map = mmap(NULL, sb.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "ERR: Cannot map %s\n", fname);
+		return false;
+	}
+
+	// Check that the file is what it says it is, and that everything it
+	// points to lies within it
+	base = (char *)map;
+	hdr = (const WBSCAP_HEADER *)base;
+	if ((memcmp(hdr->m_magic, WBSCAP_MAGIC, sizeof(hdr->m_magic)) != 0)
+		||(hdr->m_version != WBSCAP_VERSION)
+		||(hdr->m_length > (uint64_t)sb.st_size)
+		||(hdr->m_scoplen < 1)||(hdr->m_scoplen > 0x80000000ull)
+		||(hdr->m_trace_offset < sizeof(*hdr))
+		||(hdr->m_trace_offset + hdr->m_ntraces * sizeof(*tr)
+			> hdr->m_data_offset)
+		||(hdr->m_data_offset % WBSCAP_PAGE != 0)
+		||(hdr->m_data_offset + hdr->m_scoplen * sizeof(DEVBUS::BUSW)
+			> hdr->m_length)
+		||((hdr->m_flags & WBSCAP_COMPRESSED)
+			&&((hdr->m_index_offset % WBSCAP_PAGE != 0)
+			||(hdr->m_index_offset < hdr->m_data_offset
+				+ hdr->m_scoplen * sizeof(DEVBUS::BUSW))
+			||(hdr->m_index_offset + (hdr->m_scoplen+1)
+				* sizeof(uint64_t) > hdr->m_length)))) {
+		fprintf(stderr, "ERR: %s is not a valid capture file\n",fname);
+		munmap(map, sb.st_size);
+		return false;
+	}
+
+	tr = (const WBSCAP_TRACE *)(base + hdr->m_trace_offset);
+	for(unsigned k=0; k<hdr->m_ntraces; k++) {
+		if (NULL == memchr(tr[k].m_name, '\0', sizeof(tr[k].m_name))) {
+			fprintf(stderr, "ERR: Bad trace name in %s\n", fname);
+			munmap(map, sb.st_size);
+			return false;
+		}
+
+		// Every trace must fit within a 32-bit word
+		if ((tr[k].m_nbits < 1)||(tr[k].m_nbits > 32)
+				||(tr[k].m_nshift > 32 - tr[k].m_nbits)) {
+			fprintf(stderr, "ERR: Trace %s in %s doesn\'t fit in a "
+				"word: %u bits, shifted by %u\n",
+				tr[k].m_name, fname, tr[k].m_nbits,
+				tr[k].m_nshift);
+			munmap(map, sb.st_size);
+			return false;
+		}
+	}
+
+	// Let go of whatever we had before, and take up the file
+	release_data();
+	m_traces.clear();
+
+	m_map     = map;
+	m_maplen  = sb.st_size;
+	m_mapped_traces = true;
+	m_compressed = (hdr->m_flags & WBSCAP_COMPRESSED) != 0;
+	m_ctrl    = hdr->m_control;
+	m_holdoff = hdr->m_holdoff;
+	m_clkfreq_hz = hdr->m_clkfreq_hz;
+	m_scoplen = (unsigned)hdr->m_scoplen;
+	m_data    = (DEVBUS::BUSW *)(base + hdr->m_data_offset);
+	m_nvalid  = m_scoplen;
+	m_readerr = false;
+	if (m_compressed) {
+		m_tindex  = (const uint64_t *)(base + hdr->m_index_offset);
+		m_indexed = true;
+	}
+
+	for(unsigned k=0; k<hdr->m_ntraces; k++)
+		register_trace(tr[k].m_name, tr[k].m_nbits, tr[k].m_nshift);
+
+	return true;
+}
+// }}}
@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	wbscap.h
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Defines the layout of a .wbscap file, a binary capture file which
+//		can be mapped into memory and used as is.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#ifndef	WBSCAP_H
+#define	WBSCAP_H
+
+#include <stdint.h>
+
+/*
+ * The .wbscap file format
+ * {{{
+ * A .wbscap file holds one capture from a scope, laid out so that it can be
+ * mapped into memory and used in place:
+ *
+ *	WBSCAP_HEADER
+ *	WBSCAP_TRACE	m_ntraces entries, right after the header
+ *	(pad to a page boundary)
+ *	uint32_t	m_scoplen data words, just as read from the scope
+ *	(pad to a page boundary)
+ *	uint64_t	m_scoplen+1 entry time index (compressed scopes only)
+ *
+ * The time index is SCOPE's m_tindex: the clock number of each data word,
+ * followed by the total number of clocks.  All values are written in the
+ * byte order of the host writing the file.  A host of the other byte order
+ * will fail to recognize the version number, and so refuse the file.
+ * }}}
+ */
+
+#define	WBSCAP_MAGIC	"WBSCAP\r\n"
+#define	WBSCAP_VERSION	1
+#define	WBSCAP_PAGE	4096
+
+// Header flags
+#define	WBSCAP_COMPRESSED	1
+
+struct	WBSCAP_HEADER {
+	char		m_magic[8];
+	uint32_t	m_version, m_flags;
+	// The scope's control word, holdoff, and clock frequency
+	uint32_t	m_control, m_holdoff, m_clkfreq_hz;
+	uint32_t	m_ntraces;
+	// The number of data words
+	uint64_t	m_scoplen;
+	// Byte offsets, from the start of the file, to the trace table, the
+	// data, and the time index (zero if there is none), and the length
+	// of the file
+	uint64_t	m_trace_offset, m_data_offset, m_index_offset,
+			m_length;
+};
+
+struct	WBSCAP_TRACE {
+	uint32_t	m_nbits, m_nshift;
+	// The trace's name, NUL terminated
+	char		m_name[56];
+};
+
+#endif	// WBSCAP_H
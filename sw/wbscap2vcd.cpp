@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// Filename: 	wbscap2vcd.cpp
+// {{{
+// Project:	WBScope, a wishbone hosted scope
+//
+// Purpose:	Converts a .wbscap capture file, as written by
+//		SCOPE::write_capture(), into a VCD file.
+//
+// Creator:	Dan Gisselquist, Ph.D.
+//		Gisselquist Technology, LLC
+//
+////////////////////////////////////////////////////////////////////////////////
+// }}}
+// Copyright (C) 2024, Gisselquist Technology, LLC
+// {{{
+// This program is free software (firmware): you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTIBILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program.  (It's in the $(ROOT)/doc directory.  Run make with no
+// target there if the PDF file isn't present.)  If not, see
+// <http://www.gnu.org/licenses/> for a copy.
+// }}}
+// License:	GPL, v3, as defined and found on www.gnu.org,
+// {{{
+//		http://www.gnu.org/licenses/gpl.html
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// }}}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "devbus.h"
+#include "scopecls.h"
+
+//
+// CAPSCOPE
+//
+// A scope with no bus behind it, whose data only ever comes from a capture
+// file.  The traces come from the file as well, so there's nothing to define.
+//
+class	CAPSCOPE : public SCOPE {
+public:
+	CAPSCOPE(void) : SCOPE(NULL, 0) {}
+
+	virtual	void	decode(DEVBUS::BUSW v) const {
+		printf("%08x", v);
+	}
+};
+
+void	usage(void) {
+	fprintf(stderr,
+"USAGE: wbscap2vcd [-chkp] <capture.wbscap> [<trace.vcd>]\n"
+"\n"
+"\t-c\tOnly write values when they change\n"
+"\t-h\tShow this usage statement\n"
+"\t-k\tWrite a compact, clockless, VCD file\n"
+"\t-p\tPrint the capture to the standard output as well\n"
+"\n"
+"The VCD file defaults to the capture file's name, with .vcd in place of\n"
+"any .wbscap extension.\n");
+}
+
+int main(int argc, char **argv) {
+	bool	changes_only = false, clockless = false, print = false;
+	const char	*capfile, *vcdfile;
+	char	*defname = NULL;
+	int	opt;
+
+	while((opt = getopt(argc, argv, "chkp")) != -1) {
+		switch(opt) {
+		case 'c': changes_only = true; break;
+		case 'k': clockless = true; break;
+		case 'p': print = true; break;
+		case 'h': usage(); exit(EXIT_SUCCESS);
+		default:
+			usage(); exit(EXIT_FAILURE);
+		}
+	}
+
+	if ((optind >= argc)||(optind+2 < argc)) {
+		usage();
+		exit(EXIT_FAILURE);
+	}
+
+	capfile = argv[optind];
+	if (optind+1 < argc)
+		vcdfile = argv[optind+1];
+	else {
+		const char	*ext = strrchr(capfile, '.');
+		size_t	ln = strlen(capfile);
+
+		if ((ext)&&(strcmp(ext, ".wbscap") == 0))
+			ln = ext - capfile;
+		defname = new char[ln+5];
+		memcpy(defname, capfile, ln);
+		strcpy(&defname[ln], ".vcd");
+		vcdfile = defname;
+	}
+
+	CAPSCOPE *scope = new CAPSCOPE();
+
+	if (!scope->open_capture(capfile))
+		exit(EXIT_FAILURE);
+
+	if (print)
+		scope->print();
+	scope->set_vcd_changes_only(changes_only);
+	scope->writevcd(vcdfile, clockless);
+
+	delete	scope;
+	if (defname)
+		delete[] defname;
+	return EXIT_SUCCESS;
+}